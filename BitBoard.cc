@@ -0,0 +1,170 @@
+#include "BitBoard.h"
+
+namespace {
+	typedef BitBoard::TWord TWord;
+	const int kWordBits = BitBoard::kWordBits;
+
+	/**
+	 * OR the bits shifted towards the higher cell indexes into the result.
+	 */
+	void OrShiftedUp(const TWord* words, const int numWords, const int shift, TWord* result) {
+		const int wordShift = shift / kWordBits;
+		const int bitShift = shift % kWordBits;
+
+		for (int i = numWords - 1; i >= wordShift; --i) {
+			TWord word = words[i - wordShift] << bitShift;
+
+			if (bitShift && i - wordShift > 0) {
+				word |= words[i - wordShift - 1] >> (kWordBits - bitShift);
+			}
+
+			result[i] |= word;
+		}
+	}
+
+	/**
+	 * OR the bits shifted towards the lower cell indexes into the result.
+	 */
+	void OrShiftedDown(const TWord* words, const int numWords, const int shift, TWord* result) {
+		const int wordShift = shift / kWordBits;
+		const int bitShift = shift % kWordBits;
+
+		for (int i = 0; i + wordShift < numWords; ++i) {
+			TWord word = words[i + wordShift] >> bitShift;
+
+			if (bitShift && i + wordShift + 1 < numWords) {
+				word |= words[i + wordShift + 1] << (kWordBits - bitShift);
+			}
+
+			result[i] |= word;
+		}
+	}
+}
+
+BitBoard::BitBoard()
+: iSize_(0), iWidth_(0), numWords_(0), words_() {
+}
+
+void BitBoard::initialize(const TCellIndex iSize, const TCellIndex iWidth) {
+	iSize_ = iSize;
+	iWidth_ = iWidth;
+	numWords_ = (iSize + kWordBits - 1) / kWordBits;
+	words_.assign(numWords_, 0);
+}
+
+void BitBoard::copyCells(const TCell* cCells) {
+	this->clear();
+
+	for (TCellIndex iCell = 0; iCell < iSize_; ++iCell) {
+		if (WALL != cCells[iCell]) {
+			this->addCell(iCell);
+		}
+	}
+}
+
+void BitBoard::clear() {
+	for (int i = 0; i < numWords_; ++i) {
+		words_[i] = 0;
+	}
+}
+
+bool BitBoard::isEmpty() const {
+	for (int i = 0; i < numWords_; ++i) {
+		if (words_[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void BitBoard::unite(const BitBoard& other) {
+	for (int i = 0; i < numWords_; ++i) {
+		words_[i] |= other.words_[i];
+	}
+}
+
+void BitBoard::intersect(const BitBoard& other) {
+	for (int i = 0; i < numWords_; ++i) {
+		words_[i] &= other.words_[i];
+	}
+}
+
+void BitBoard::subtract(const BitBoard& other) {
+	for (int i = 0; i < numWords_; ++i) {
+		words_[i] &= ~other.words_[i];
+	}
+}
+
+bool BitBoard::intersects(const BitBoard& other) const {
+	for (int i = 0; i < numWords_; ++i) {
+		if (words_[i] & other.words_[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void BitBoard::getNeighbours(BitBoard* neighbours) const {
+	TWord* result = &neighbours->words_[0];
+	const TWord* words = &words_[0];
+
+	neighbours->clear();
+	OrShiftedUp(words, numWords_, 1, result);
+	OrShiftedDown(words, numWords_, 1, result);
+	OrShiftedUp(words, numWords_, iWidth_, result);
+	OrShiftedDown(words, numWords_, iWidth_, result);
+
+	//Shifting up can spill past the last cell.
+	const int numLastBits = iSize_ % kWordBits;
+
+	if (numLastBits) {
+		result[numWords_ - 1] &= (static_cast<TWord>(1) << numLastBits) - 1;
+	}
+}
+
+bool BitBoard::expand(const BitBoard& open, BitBoard* scratch) {
+	this->getNeighbours(scratch);
+
+	bool hasGrown = false;
+
+	for (int i = 0; i < numWords_; ++i) {
+		const TWord newCells = scratch->words_[i] & open.words_[i] & ~words_[i];
+
+		if (newCells) {
+			words_[i] |= newCells;
+			hasGrown = true;
+		}
+	}
+
+	return hasGrown;
+}
+
+int BitBoard::count() const {
+	int numCells = 0;
+
+	for (int i = 0; i < numWords_; ++i) {
+		numCells += CountBits(words_[i]);
+	}
+
+	return numCells;
+}
+
+int BitBoard::countReachable(const TCellIndex iStart, BitBoard* area, BitBoard* scratch) const {
+	area->clear();
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		const TCellIndex iNeighbour = GetNeighbour(iStart, direction);
+
+		if (this->isOpen(iNeighbour)) {
+			area->addCell(iNeighbour);
+		}
+	}
+
+	while (area->expand(*this, scratch)) {
+		//Keep growing until there's nowhere left to go.
+	}
+
+	return area->count();
+}
@@ -0,0 +1,127 @@
+/*
+ * The map packed one bit per cell: a bit is set if the cell is open.
+ * The bits are in the same order as the cells in a TCell array
+ * (row by row), packed into 64-bit words, so that a 20x20 map takes
+ * up 7 words.  Copying a board is cheap, and so are the operations
+ * on whole areas: growing an area by a step in every direction is
+ * a few shifts per word, and the area's size is a popcount.
+ *
+ * The neighbour masks don't check for the edges of the map; like
+ * the rest of the code, they rely on the map being surrounded
+ * by walls.
+ */
+#ifndef BIT_BOARD_H_
+#define BIT_BOARD_H_
+
+#include <vector>
+#include "MoveScore.h"
+
+class BitBoard {
+public:
+	typedef unsigned long long TWord;
+	static const int kWordBits = 64;
+
+	BitBoard();
+
+	/**
+	 * Set the board dimensions and close all cells.
+	 */
+	void initialize(TCellIndex iSize, TCellIndex iWidth);
+
+	/**
+	 * Open the cells that are not walls on the TCell map.
+	 */
+	void copyCells(const TCell* cCells);
+
+	bool isOpen(TCellIndex iCell) const {
+		return ((words_[iCell / kWordBits] >> (iCell % kWordBits)) & 1) != 0;
+	}
+
+	//Making and unmaking moves.
+	void removeCell(TCellIndex iCell)	{ words_[iCell / kWordBits] &= ~(static_cast<TWord>(1) << (iCell % kWordBits));}
+	void addCell(TCellIndex iCell)		{ words_[iCell / kWordBits] |= (static_cast<TWord>(1) << (iCell % kWordBits));}
+
+	void setCell(TCellIndex iCell, bool isOpen) {
+		if (isOpen) {
+			this->addCell(iCell);
+		} else {
+			this->removeCell(iCell);
+		}
+	}
+
+	void clear();
+	bool isEmpty() const;
+
+	//Set operations on boards of the same size.
+	void unite(const BitBoard& other);
+	void intersect(const BitBoard& other);
+	void subtract(const BitBoard& other);
+	bool intersects(const BitBoard& other) const;
+
+	/**
+	 * Put the cells next to the cells on this board
+	 * onto the neighbours board.
+	 */
+	void getNeighbours(BitBoard* neighbours) const;
+
+	/**
+	 * Add to this board the open cells next to it.
+	 * @param scratch: board of the same size, overwritten.
+	 * @return whether any cells were added.
+	 */
+	bool expand(const BitBoard& open, BitBoard* scratch);
+
+	/**
+	 * Number of cells on the board.
+	 */
+	int count() const;
+
+	/**
+	 * Number of open cells reachable from the cell, not counting
+	 * the cell itself.
+	 * @param area, scratch: boards of the same size, overwritten;
+	 *	area is left with the reachable cells.
+	 */
+	int countReachable(TCellIndex iStart, BitBoard* area, BitBoard* scratch) const;
+
+	int countOpenNeighbours(TCellIndex iCell) const {
+		return (this->isOpen(iCell - iWidth_) ? 1 : 0) + (this->isOpen(iCell + 1) ? 1 : 0)
+			+ (this->isOpen(iCell + iWidth_) ? 1 : 0) + (this->isOpen(iCell - 1) ? 1 : 0);
+	}
+
+	TCellIndex getSize() const		{ return iSize_;}
+	TCellIndex getWidth() const		{ return iWidth_;}
+
+	//Raw access for the bit-parallel kernels (see Voronoi.h).
+	int getNumWords() const			{ return numWords_;}
+	const TWord* getWords() const	{ return &words_[0];}
+	TWord* getWords()				{ return &words_[0];}
+
+private:
+	TCellIndex iSize_;
+	TCellIndex iWidth_;
+	int numWords_;
+	std::vector<TWord> words_;
+};
+
+/**
+ * Number of bits set in the word.
+ */
+#ifdef TEST_ENVIRONMENT
+	inline int CountBits(BitBoard::TWord word) {
+		int numBits = 0;
+
+		while (word) {
+			word &= word - 1;
+			numBits++;
+		}
+
+		return numBits;
+	}
+#else
+	inline int CountBits(const BitBoard::TWord word) {
+		return __builtin_popcountll(word);
+	}
+#endif
+
+#endif /* BIT_BOARD_H_ */
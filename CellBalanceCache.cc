@@ -0,0 +1,64 @@
+#include "CellBalanceCache.h"
+#include "Threads.h"
+
+/*
+ * Layout of Entry::data: the score in the lowest 16 bits, whether the
+ * bots are separated in bit 16, and the distance to the opponent in
+ * the highest 32 bits.
+ */
+static const THashKey SEPARATED_BIT = 1ULL << 16;
+
+CellBalanceCache::CellBalanceCache()
+: entries_(NULL) {
+	const unsigned int numEntries = 1u << kTableBits;
+	entries_ = new Entry[numEntries];
+
+	//An entry of zeros matches key 0 only, which is never looked up
+	//in practice.
+	for (unsigned int i = 0; i < numEntries; ++i) {
+		entries_[i].check = 0;
+		entries_[i].data = 0;
+	}
+}
+
+CellBalanceCache::~CellBalanceCache() {
+	delete[] entries_;
+}
+
+THashKey CellBalanceCache::GetKey(const THashKey wallHash, 
+								  const TCellIndex iMe, 
+								  const TCellIndex iOpponent,
+								  const TCellIndex iPrevMe, 
+								  const TCellIndex iPrevOpponent) {
+	//The previous positions are walls, so they're in the wall hash 
+	//already; mix them in once more so that they also count as positions.
+	const THashKey prevPositions = (static_cast<THashKey>(iPrevMe) << 32) 
+		| static_cast<unsigned int>(iPrevOpponent);
+
+	return GetPositionKey(wallHash, iMe, iOpponent) ^ (prevPositions * 0x9E3779B97F4A7C15ULL);
+}
+
+bool CellBalanceCache::find(const THashKey key, CellBalance* balance) const {
+	const Entry& entry = entries_[getSlot(key)];
+	const THashKey data = LoadShared(&entry.data);
+	const THashKey check = LoadShared(&entry.check);
+
+	if ((check ^ data) != key) {
+		return false;
+	}
+
+	balance->score = static_cast<TMoveScore>(data & 0xffff);
+	balance->areSeparated = ((data & SEPARATED_BIT) != 0);
+	balance->distanceToOpponent = static_cast<int>(data >> 32);
+	return true;
+}
+
+void CellBalanceCache::store(const THashKey key, const CellBalance& balance) {
+	Entry& entry = entries_[getSlot(key)];
+	const THashKey data = static_cast<unsigned short>(balance.score)
+		| (balance.areSeparated ? SEPARATED_BIT : 0)
+		| (static_cast<THashKey>(static_cast<unsigned int>(balance.distanceToOpponent)) << 32);
+
+	StoreShared(&entry.check, key ^ data);
+	StoreShared(&entry.data, data);
+}
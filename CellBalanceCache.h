@@ -0,0 +1,55 @@
+/*
+ * Cache of the results of GetCellBalance().
+ *
+ * calculatePathScore() calls GetCellBalance() 16 times for every
+ * step of the path it plays out, and the same positions come up
+ * over and over: in sibling steps, whose paths quickly join, and 
+ * again on the next turns.  The cache is keyed on the Zobrist hash
+ * of the walls (see Zobrist.h) and the four positions passed to
+ * GetCellBalance().
+ *
+ * Like the transposition table, the cache is direct-mapped and
+ * lossy.  It is shared by all the evaluation workers without a lock:
+ * every entry stores (key XOR data) next to the data, so an entry
+ * that was half-written by another thread simply doesn't match.
+ */
+#ifndef CELL_BALANCE_CACHE_H_
+#define CELL_BALANCE_CACHE_H_
+
+#include "Zobrist.h"
+
+class CellBalanceCache {
+public:
+	//The cache has 2^kTableBits entries.
+	static const int kTableBits = 20;
+
+	CellBalanceCache();
+	~CellBalanceCache();
+
+	/**
+	 * Key of the cell balance for the given arguments of GetCellBalance().
+	 * @param wallHash: hash of the walls placed by the bots.
+	 */
+	static THashKey GetKey(THashKey wallHash, TCellIndex iMe, TCellIndex iOpponent,
+		TCellIndex iPrevMe, TCellIndex iPrevOpponent);
+
+	/**
+	 * Look up the cell balance.
+	 * @return whether the balance was found.
+	 */
+	bool find(THashKey key, CellBalance* balance) const;
+
+	void store(THashKey key, const CellBalance& balance);
+
+private:
+	struct Entry {
+		THashKey check;		//key ^ data
+		THashKey data;
+	};
+
+	unsigned int getSlot(THashKey key) const	{ return static_cast<unsigned int>(key >> (64 - kTableBits));}
+
+	Entry* entries_;
+};
+
+#endif /* CELL_BALANCE_CACHE_H_ */
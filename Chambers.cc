@@ -0,0 +1,145 @@
+#include "Chambers.h"
+
+ArticulationChambers::ArticulationChambers()
+: iVisitOrder_(), iLowestReachable_(), iParents_(), nextDirections_(), chamberFills_(),
+chamberBlackCells_(), branchFills_(), startsChamber_(), chambers_(), iVisitedCells_(), iStack_(),
+chamberSizes_(), parentChambers_(), iChamberEntrances_() {
+}
+
+void ArticulationChambers::initialize(const TCellIndex iSize) {
+	iVisitOrder_.assign(iSize, static_cast<int>(kNotVisited));
+	iLowestReachable_.assign(iSize, 0);
+	iParents_.assign(iSize, NO_INDEX);
+	nextDirections_.assign(iSize, 0);
+	chamberFills_.assign(iSize, 0);
+	chamberBlackCells_.assign(iSize, 0);
+	branchFills_.assign(iSize, 0);
+	startsChamber_.assign(iSize, false);
+	chambers_.assign(iSize, 0);
+	iVisitedCells_.reserve(iSize);
+	iStack_.reserve(iSize);
+}
+
+int ArticulationChambers::build(const BitBoard& territory, const TCellIndex iStart) {
+	//Forget the previous build.
+	const int numPreviousCells = static_cast<int>(iVisitedCells_.size());
+
+	for (int i = 0; i < numPreviousCells; ++i) {
+		iVisitOrder_[iVisitedCells_[i]] = kNotVisited;
+	}
+
+	iVisitedCells_.clear();
+	iStack_.clear();
+	chamberSizes_.clear();
+	parentChambers_.clear();
+	iChamberEntrances_.clear();
+
+	//Depth-first search, keeping the stack by hand; each cell
+	//remembers which of its neighbours to look at next.
+	iVisitOrder_[iStart] = 0;
+	iLowestReachable_[iStart] = 0;
+	iParents_[iStart] = NO_INDEX;
+	nextDirections_[iStart] = UP;
+	chamberFills_[iStart] = 1;
+	chamberBlackCells_[iStart] = (BLACK_COLOR == GetCellColor(iStart) ? 1 : 0);
+	branchFills_[iStart] = 0;
+	iVisitedCells_.push_back(iStart);
+	iStack_.push_back(iStart);
+
+	while (!iStack_.empty()) {
+		const TCellIndex iCell = iStack_.back();
+
+		if (nextDirections_[iCell] <= LEFT) {
+			const TCellIndex iNeighbour = GetNeighbour(iCell, nextDirections_[iCell]);
+			nextDirections_[iCell]++;
+
+			//The start belongs to the graph even if it's not on the board:
+			//the bot can go out through any of its neighbours.
+			if (!territory.isOpen(iNeighbour) && iNeighbour != iStart) {
+				continue;
+			}
+
+			if (kNotVisited == iVisitOrder_[iNeighbour]) {
+				const int visitOrder = static_cast<int>(iVisitedCells_.size());
+				iVisitOrder_[iNeighbour] = visitOrder;
+				iLowestReachable_[iNeighbour] = visitOrder;
+				iParents_[iNeighbour] = iCell;
+				nextDirections_[iNeighbour] = UP;
+				chamberFills_[iNeighbour] = 1;
+				chamberBlackCells_[iNeighbour] = (BLACK_COLOR == GetCellColor(iNeighbour) ? 1 : 0);
+				branchFills_[iNeighbour] = 0;
+				iVisitedCells_.push_back(iNeighbour);
+				iStack_.push_back(iNeighbour);
+
+			} else if (iNeighbour != iParents_[iCell]
+				&& iVisitOrder_[iNeighbour] < iLowestReachable_[iCell]) {
+
+				iLowestReachable_[iCell] = iVisitOrder_[iNeighbour];
+			}
+
+			continue;
+		}
+
+		//Done with the cell; report to the parent.
+		iStack_.pop_back();
+		const TCellIndex iParent = iParents_[iCell];
+
+		if (NO_INDEX == iParent) {
+			continue;
+		}
+
+		if (iLowestReachable_[iCell] < iLowestReachable_[iParent]) {
+			iLowestReachable_[iParent] = iLowestReachable_[iCell];
+		}
+
+		if (iLowestReachable_[iCell] >= iVisitOrder_[iParent]) {
+			//The parent is an articulation point (or the start), and the
+			//cell's subtree is a chamber that can only be entered from it,
+			//on a cell of the same colour as this one.
+			startsChamber_[iCell] = true;
+			const int fill = GetParityBound(chamberFills_[iCell], chamberBlackCells_[iCell], 
+				GetCellColor(iCell)) + branchFills_[iCell];
+
+			if (fill > branchFills_[iParent]) {
+				branchFills_[iParent] = fill;
+			}
+
+		} else {
+			//Part of the parent's chamber.
+			startsChamber_[iCell] = false;
+			chamberFills_[iParent] += chamberFills_[iCell];
+			chamberBlackCells_[iParent] += chamberBlackCells_[iCell];
+
+			if (branchFills_[iCell] > branchFills_[iParent]) {
+				branchFills_[iParent] = branchFills_[iCell];
+			}
+		}
+	}
+
+	//Label the chambers; parents are always visited before children.
+	const int numCells = static_cast<int>(iVisitedCells_.size());
+	chambers_[iStart] = 0;
+	chamberSizes_.push_back(1);
+	parentChambers_.push_back(-1);
+	iChamberEntrances_.push_back(NO_INDEX);
+
+	for (int i = 1; i < numCells; ++i) {
+		const TCellIndex iCell = iVisitedCells_[i];
+		const TCellIndex iParent = iParents_[iCell];
+
+		if (startsChamber_[iCell]) {
+			const int chamber = static_cast<int>(chamberSizes_.size());
+			chamberSizes_.push_back(0);
+			parentChambers_.push_back(chambers_[iParent]);
+			iChamberEntrances_.push_back(iParent);
+			chambers_[iCell] = chamber;
+
+		} else {
+			chambers_[iCell] = chambers_[iParent];
+		}
+
+		chamberSizes_[chambers_[iCell]]++;
+	}
+
+	return chamberFills_[iStart] + branchFills_[iStart];
+}
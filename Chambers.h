@@ -0,0 +1,71 @@
+/*
+ * Tree of chambers built from articulation points, as an alternative
+ * to the bottleneck test in GetCellBalance() (see README.txt,
+ * section [3]).
+ *
+ * A single depth-first search from the bot's position over the bot's
+ * territory finds the articulation points (Tarjan): a cell whose DFS
+ * subtree can't reach above the cell without going through it.  Such
+ * a subtree is a chamber of its own: once the bot goes in, it can't
+ * come back.  The rest of the subtree belongs to the chamber of the
+ * cell.  The best fill size is worked out during the same search:
+ * the size of the chamber, less what the colours of its cells don't
+ * allow (see GetParityBound()), plus the best fill size of one of the
+ * chambers that can be entered from it.  Every cell is visited once,
+ * and nothing has to be merged afterwards.
+ */
+#ifndef CHAMBERS_H_
+#define CHAMBERS_H_
+
+#include <vector>
+#include "BitBoard.h"
+
+class ArticulationChambers {
+public:
+	ArticulationChambers();
+
+	void initialize(TCellIndex iSize);
+
+	/**
+	 * Split the territory into chambers.
+	 * @param territory: the cells the bot can use; may or may not
+	 *	include iStart.
+	 * @return the most cells the bot can fill: its own position,
+	 *	its chamber, and the best path down the tree of chambers.
+	 */
+	int build(const BitBoard& territory, TCellIndex iStart);
+
+	//The tree of chambers from the last build().  Chamber 0 is the
+	//bot's own; the other chambers are entered from their entrance
+	//cell, which is in the parent chamber.
+	int getNumChambers() const							{ return static_cast<int>(chamberSizes_.size());}
+	int getChamber(TCellIndex iCell) const				{ return (iVisitOrder_[iCell] == kNotVisited ? -1 : chambers_[iCell]);}
+	int getChamberSize(int chamber) const				{ return chamberSizes_[chamber];}
+	int getParentChamber(int chamber) const				{ return parentChambers_[chamber];}
+	TCellIndex getChamberEntrance(int chamber) const	{ return iChamberEntrances_[chamber];}
+
+private:
+	static const int kNotVisited = -1;
+
+	//Per cell; valid for the cells visited by the last build().
+	std::vector<int> iVisitOrder_;
+	std::vector<int> iLowestReachable_;	//Lowest visit order reachable from the DFS subtree.
+	std::vector<TCellIndex> iParents_;
+	std::vector<char> nextDirections_;
+	std::vector<int> chamberFills_;		//Cells in the chamber from the DFS subtree.
+	std::vector<int> chamberBlackCells_;	//Black cells among chamberFills_.
+	std::vector<int> branchFills_;		//Best fill of a chamber entered from the DFS subtree.
+	std::vector<bool> startsChamber_;
+	std::vector<int> chambers_;
+
+	//Cells in the order of visiting, and the DFS stack.
+	std::vector<TCellIndex> iVisitedCells_;
+	std::vector<TCellIndex> iStack_;
+
+	//Per chamber.
+	std::vector<int> chamberSizes_;
+	std::vector<int> parentChambers_;
+	std::vector<TCellIndex> iChamberEntrances_;
+};
+
+#endif /* CHAMBERS_H_ */
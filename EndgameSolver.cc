@@ -0,0 +1,208 @@
+#include "EndgameSolver.h"
+
+EndgameSolver::EndgameSolver()
+: isActive_(false), isSolved_(false), isStopped_(false), stopFunction_(NULL), open_(),
+visitedHash_(0), iMe_(0), chambers_(), area_(), scratch_(), path_(), bestPath_(), table_(), numNodes_(0) {
+}
+
+void EndgameSolver::initialize(const TCellIndex iSize, const TCellIndex iWidth) {
+	open_.initialize(iSize, iWidth);
+	chambers_.initialize(iSize);
+	area_.initialize(iSize, iWidth);
+	scratch_.initialize(iSize, iWidth);
+	path_.assign(iSize, 0);
+}
+
+void EndgameSolver::start(const TCell* cCells, const TCellIndex iMe) {
+	//The keys only tell apart the cells visited since the start.
+	TableEntry emptyEntry;
+	emptyEntry.key = 0;
+	emptyEntry.length = 0;
+	emptyEntry.isExact = false;
+	table_.assign(1 << kTableBits, emptyEntry);
+
+	//Only the cells I can reach matter.
+	open_.copyCells(cCells);
+	open_.countReachable(iMe, &area_, &scratch_);
+	open_.clear();
+	open_.unite(area_);
+
+	visitedHash_ = 0;
+	iMe_ = iMe;
+	bestPath_.clear();
+	numNodes_ = 0;
+	isSolved_ = false;
+	isActive_ = true;
+}
+
+void EndgameSolver::advance(const TCellIndex iNewMe) {
+	if (iNewMe == iMe_) {
+		return;
+	}
+
+	//The best path is still the best one if I followed it.
+	if (!bestPath_.empty() && GetNeighbour(iMe_, bestPath_[0]) == iNewMe) {
+		bestPath_.erase(bestPath_.begin());
+	} else {
+		bestPath_.clear();
+		isSolved_ = false;
+	}
+
+	open_.removeCell(iNewMe);
+	visitedHash_ ^= GetWallKey(iNewMe);
+	iMe_ = iNewMe;
+}
+
+bool EndgameSolver::solve(const TStopFunction stopFunction) {
+	if (!isActive_ || isSolved_) {
+		return isSolved_;
+	}
+
+	stopFunction_ = stopFunction;
+	isStopped_ = false;
+
+	bool isExact = false;
+	search(iMe_, 0, getUpperBound(iMe_), true, &isExact);
+
+	//Every branch that was cut off couldn't beat the best path.
+	isSolved_ = !isStopped_;
+	stopFunction_ = NULL;
+	return isSolved_;
+}
+
+int EndgameSolver::search(const TCellIndex iCell, 
+						  const int depth, 
+						  int upperBound, 
+						  const bool isOnBestPath, 
+						  bool* isExact) {
+	numNodes_++;
+
+	if (0 == numNodes_ % kNodesPerStopCheck && shouldStop()) {
+		isStopped_ = true;
+	}
+
+	if (isStopped_) {
+		*isExact = false;
+		return 0;
+	}
+
+	const int bestLength = static_cast<int>(bestPath_.size());
+
+	//The bound can be tightened by what was found the last time around.
+	bool isUpperBoundExact = false;
+
+	const THashKey key = visitedHash_ ^ GetMyKey(iCell);
+	TableEntry& entry = table_[static_cast<int>(key & ((1 << kTableBits) - 1))];
+
+	if (entry.key == key && entry.length <= upperBound) {
+		upperBound = entry.length;
+		isUpperBoundExact = entry.isExact;
+	}
+
+	if (depth + upperBound <= bestLength) {
+		*isExact = isUpperBoundExact;
+		return upperBound;
+	}
+
+	//Nowhere to go from here, but it's the best path yet.
+	if (0 == upperBound) {
+		bestPath_.assign(path_.begin(), path_.begin() + depth);
+		*isExact = true;
+		return 0;
+	}
+
+	char moves[4];
+	int upperBounds[4];
+	const int bestPathMove = (isOnBestPath && depth < bestLength ? bestPath_[depth] : 0);
+	const int numMoves = getMoveOrder(iCell, bestPathMove, moves, upperBounds);
+
+	int longestPath = 0;
+	bool isLongestPathExact = true;
+
+	for (int i = 0; i < numMoves; ++i) {
+		const TCellIndex iNext = GetNeighbour(iCell, moves[i]);
+
+		open_.removeCell(iNext);
+		visitedHash_ ^= GetWallKey(iNext);
+		path_[depth] = moves[i];
+
+		bool isChildExact = false;
+		const int pathLength = 1 + search(iNext, depth + 1, upperBounds[i], 
+			(moves[i] == bestPathMove), &isChildExact);
+
+		open_.addCell(iNext);
+		visitedHash_ ^= GetWallKey(iNext);
+
+		if (isStopped_) {
+			*isExact = false;
+			return 0;
+		}
+
+		if (pathLength > longestPath) {
+			longestPath = pathLength;
+		}
+
+		isLongestPathExact = isLongestPathExact && isChildExact;
+
+		//Can't do any better than filling everything.
+		if (isChildExact && pathLength >= upperBound) {
+			isLongestPathExact = true;
+			break;
+		}
+	}
+
+	entry.key = key;
+	entry.length = static_cast<short>(longestPath);
+	entry.isExact = isLongestPathExact;
+
+	*isExact = isLongestPathExact;
+	return longestPath;
+}
+
+int EndgameSolver::getUpperBound(const TCellIndex iCell) {
+	return chambers_.build(open_, iCell) - 1;
+}
+
+int EndgameSolver::getMoveOrder(const TCellIndex iCell, 
+								const int bestPathMove, 
+								char* moves, 
+								int* upperBounds) {
+	int priorities[4];
+	int numMoves = 0;
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		const TCellIndex iNeighbour = GetNeighbour(iCell, direction);
+
+		if (!open_.isOpen(iNeighbour)) {
+			continue;
+		}
+
+		open_.removeCell(iNeighbour);
+		const int upperBound = this->getUpperBound(iNeighbour);
+		open_.addCell(iNeighbour);
+
+		//The best path first, then the highest upper bound, 
+		//then the fewest open neighbours.
+		const int priority = (direction == bestPathMove ? -1 
+			: kMaxNeighbours * (open_.getSize() - upperBound) + open_.countOpenNeighbours(iNeighbour));
+		int iInsert = numMoves;
+
+		while (iInsert > 0 && priorities[iInsert - 1] > priority) {
+			moves[iInsert] = moves[iInsert - 1];
+			upperBounds[iInsert] = upperBounds[iInsert - 1];
+			priorities[iInsert] = priorities[iInsert - 1];
+			iInsert--;
+		}
+
+		moves[iInsert] = static_cast<char>(direction);
+		upperBounds[iInsert] = upperBound;
+		priorities[iInsert] = priority;
+		numMoves++;
+	}
+
+	return numMoves;
+}
+
+bool EndgameSolver::shouldStop() {
+	return (HasTimedOut() || (NULL != stopFunction_ && stopFunction_()));
+}
@@ -0,0 +1,140 @@
+/*
+ * Exact solver for the end of the game, when the bots are separated
+ * from each other.  The opponent can no longer affect my area, so the
+ * game is down to filling the area with the longest path I can find;
+ * the step tree's 16-way minimax and the tree-of-chambers estimates
+ * are not needed any more.
+ *
+ * The solver searches for the longest path depth-first on a BitBoard
+ * of the cells I haven't visited yet.  A branch is cut off when the
+ * cells it can still reach can't make it longer than the best path so
+ * far.  The results of finished branches are kept in a lossy table
+ * keyed by the position and the Zobrist hash of the cells visited on
+ * the way there, so that the same position reached by different
+ * paths (or on a later move) isn't searched twice.
+ *
+ * The upper bound on the length of a path is the best path through
+ * the tree of chambers (see Chambers.h): a path can enter only one
+ * dead end.  The search can be stopped at any time; the best path so
+ * far is kept, and the next search picks up from where it left off
+ * using the table.  The moves are tried in the order of the best path
+ * so far, then the highest upper bound, then the fewest open
+ * neighbours, which tends to hug the walls and finds good paths early.
+ */
+#ifndef ENDGAME_SOLVER_H_
+#define ENDGAME_SOLVER_H_
+
+#include <vector>
+#include "MoveScore.h"
+#include "BitBoard.h"
+#include "Chambers.h"
+#include "Zobrist.h"
+#include "Timer.h"
+
+class EndgameSolver {
+public:
+	//Number of table entries, as a power of two.
+	static const int kTableBits = 18;
+
+	//Number of positions searched between checks for the time out
+	//(HasTimedOut() reads the clock on every few checks).
+	static const int kNodesPerStopCheck = 32;
+
+	//Most open neighbours a cell can have.
+	static const int kMaxNeighbours = 4;
+
+	EndgameSolver();
+
+	void initialize(TCellIndex iSize, TCellIndex iWidth);
+
+	/**
+	 * Start solving the area that can be reached from my position.
+	 * The position itself must already be a wall on the map.
+	 */
+	void start(const TCell* cCells, TCellIndex iMe);
+
+	/**
+	 * I moved to a neighbouring cell; keep the part of the best path
+	 * that follows from it.  Does nothing if I'm already there.
+	 */
+	void advance(TCellIndex iNewMe);
+
+	//Whether start() has been called.
+	bool isActive() const					{ return isActive_;}
+
+	/**
+	 * Search for a longer path until the longest one is found,
+	 * the time runs out, or stopFunction (if any) returns true.
+	 * @return whether the best path is the longest one.
+	 */
+	bool solve(TStopFunction stopFunction);
+
+	bool isSolved() const					{ return isSolved_;}
+
+	//The best path found so far: directions (UP, RIGHT, etc.) from
+	//my position.  Empty if there's nowhere to go.
+	const std::vector<char>& getBestPath() const	{ return bestPath_;}
+	int getBestMove() const					{ return (bestPath_.empty() ? 0 : bestPath_[0]);}
+
+	//Positions searched since the last start().
+	int getNumNodes() const					{ return numNodes_;}
+
+private:
+	struct TableEntry {
+		THashKey key;
+
+		//Longest path from the position, or an upper bound on it.
+		short length;
+		bool isExact;
+	};
+
+	/**
+	 * Find the longest path from the cell over the open cells.
+	 * @param depth: number of moves made from my position.
+	 * @param upperBound: getUpperBound() for the cell.
+	 * @param isOnBestPath: whether the moves so far follow the best path.
+	 * @param isExact: set if the result is exact, and not just an upper
+	 *	bound for a branch that can't beat the best path.
+	 * @return the number of moves in the path.
+	 */
+	int search(TCellIndex iCell, int depth, int upperBound, bool isOnBestPath, bool* isExact);
+
+	/**
+	 * Most moves that can be made from the cell over the open cells.
+	 */
+	int getUpperBound(TCellIndex iCell);
+
+	/**
+	 * Fill moves with the directions to open cells in the order
+	 * they should be tried, and upperBounds with their getUpperBound().
+	 * @return number of moves.
+	 */
+	int getMoveOrder(TCellIndex iCell, int bestPathMove, char* moves, int* upperBounds);
+
+	bool shouldStop();
+
+	bool isActive_;
+	bool isSolved_;
+	bool isStopped_;
+	TStopFunction stopFunction_;
+
+	//Cells not yet visited on the current path, and the hash of
+	//the cells visited since start().
+	BitBoard open_;
+	THashKey visitedHash_;
+	TCellIndex iMe_;
+
+	//Upper bounds on the path length.
+	ArticulationChambers chambers_;
+
+	//Scratch space for finding the reachable cells.
+	BitBoard area_;
+	BitBoard scratch_;
+
+	std::vector<char> path_;
+	std::vector<char> bestPath_;
+	std::vector<TableEntry> table_;
+	int numNodes_;
+};
+
+#endif /* ENDGAME_SOLVER_H_ */
@@ -0,0 +1,58 @@
+#include "EvaluationQue.h"
+
+EvaluationQue::EvaluationQue()
+: topBucket_(kNumBuckets), size_(0) {
+}
+
+void EvaluationQue::push(Step* step, int priority) {
+	if (priority < 0) {
+		priority = 0;
+	
+	} else if (priority >= kNumBuckets) {
+		priority = kNumBuckets - 1;
+	}
+
+	buckets_[priority].push_back(step);
+	size_++;
+
+	if (priority < topBucket_) {
+		topBucket_ = priority;
+	}
+}
+
+Step* EvaluationQue::pop(int* priority) {
+	std::deque<Step*>& bucket = buckets_[topBucket_];
+	Step* step = bucket.front();
+	bucket.pop_front();
+	size_--;
+
+	*priority = topBucket_;
+
+	//Find the next non-empty bucket.
+	while (topBucket_ < kNumBuckets && buckets_[topBucket_].empty()) {
+		topBucket_++;
+	}
+
+	return step;
+}
+
+void EvaluationQue::moveTo(EvaluationQue& other) {
+	for (int priority = topBucket_; priority < kNumBuckets; ++priority) {
+		std::deque<Step*>& bucket = buckets_[priority];
+
+		if (bucket.empty()) {
+			continue;
+		}
+
+		other.buckets_[priority].insert(other.buckets_[priority].end(), bucket.begin(), bucket.end());
+		bucket.clear();
+
+		if (priority < other.topBucket_) {
+			other.topBucket_ = priority;
+		}
+	}
+
+	other.size_ += size_;
+	size_ = 0;
+	topBucket_ = kNumBuckets;
+}
@@ -0,0 +1,57 @@
+/*
+ * Que of steps waiting to be evaluated.
+ *
+ * Steps are kept in buckets by priority (lower is more urgent); 
+ * steps with the same priority come out in the order they were added.
+ * StepEvaluator::getPriority() decides the priorities, so that the
+ * lines that the root minimax is likely to choose get deeper first,
+ * instead of the whole tree being searched breadth-first.
+ *
+ * The priority of a step is only calculated when it's added.  Since
+ * the scores keep changing, StepEvaluator::takeStep() recalculates the
+ * priority when the step comes out, and puts it back if it got worse.
+ */
+#ifndef EVALUATION_QUE_H_
+#define EVALUATION_QUE_H_
+
+#include <deque>
+
+class Step;
+
+class EvaluationQue {
+public:
+	//Priorities go from 0 to kNumBuckets - 1.
+	static const int kNumBuckets = 64;
+
+	EvaluationQue();
+
+	bool empty() const				{ return (0 == size_);}
+	int size() const				{ return size_;}
+
+	/**
+	 * Priority of the next step to come out; kNumBuckets if empty.
+	 */
+	int getTopPriority() const		{ return topBucket_;}
+
+	/**
+	 * Add a step.  Priorities outside of the valid range are clamped.
+	 */
+	void push(Step* step, int priority);
+
+	/**
+	 * Take out the most urgent step.  Must not be empty.
+	 */
+	Step* pop(int* priority);
+
+	/**
+	 * Move all steps into the other que, keeping their priorities.
+	 */
+	void moveTo(EvaluationQue& other);
+
+private:
+	std::deque<Step*> buckets_[kNumBuckets];
+	int topBucket_;
+	int size_;
+};
+
+#endif /* EVALUATION_QUE_H_ */
@@ -1,13 +1,37 @@
 // Map.cc
 
 #include "Map.h"
+#include "Timer.h"
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#ifndef TEST_ENVIRONMENT
+#include <poll.h>
+#endif
+
+std::vector<char> Map::frame;
+int Map::row_length = 0;
+std::vector<unsigned long long> Map::walls;
+int Map::walls_width = 0;
+int Map::walls_height = 0;
+int Map::last_one_index = -1;
+int Map::last_two_index = -1;
+
 Map::Map() {
   ReadFromFile(stdin);
+  if (!is_valid && feof(stdin)) {
+    exit(0); // End of stream means end of game. Just exit.
+  }
+}
+
+Map::Map(FILE* file_handle) {
+  // A map from a file never follows the last one, even if the walls
+  // happen to be where the players were.
+  last_one_index = -1;
+  ReadFromFile(file_handle);
 }
 
 int Map::Width() const {
@@ -22,7 +46,7 @@ bool Map::IsWall(int x, int y) const {
   if (x < 0 || y < 0 || x >= map_width || y >= map_height) {
     return true;
   } else {
-    return is_wall[x][y];
+    return IsWallAt(y * map_width + x);
   }
 }
 
@@ -79,68 +103,153 @@ void Map::MakeMove(int move) {
   fflush(stdout);
 }
 
+bool Map::IsInputPending() {
+#ifdef TEST_ENVIRONMENT
+  return true;
+#else
+  // The engine only sends the next map after it has our move, so
+  // nothing is left in stdin's buffer by the time we get here.
+  pollfd input;
+  input.fd = fileno(stdin);
+  input.events = POLLIN;
+  input.revents = 0;
+
+  return (poll(&input, 1, 0) != 0);
+#endif
+}
+
 void Map::ReadFromFile(FILE *file_handle) {
-  int x, y, c;
-  int num_items = fscanf(file_handle, "%d %d\n", &map_width, &map_height);
-  if (feof(file_handle) || num_items < 2) {
-    exit(0); // End of stream means end of game. Just exit.
+  // Until the whole frame checks out, the map has no players and no
+  // walls, and the next map is parsed in full.
+  const int previous_one_index = last_one_index;
+  const int previous_two_index = last_two_index;
+  is_valid = false;
+  player_one_x = player_one_y = 0;
+  player_two_x = player_two_y = 0;
+  last_one_index = last_two_index = -1;
+
+  char header[64];
+  if (fgets(header, sizeof(header), file_handle) == NULL) {
+    map_width = map_height = 0;
+    ClearWalls();
+    return;
   }
-  is_wall =
-    std::vector<std::vector<bool> >(map_width,
-				    std::vector<bool>(map_height, false));
-  x = 0;
-  y = 0;
-  while (y < map_height && (c = fgetc(file_handle)) != EOF) {
-    switch (c) {
-    case '\r':
-      break;
-    case '\n':
-      if (x != map_width) {
-	fprintf(stderr, "x != width in Board_ReadFromStream\n");
-	return;
-      }
-      ++y;
-      x = 0;
-      break;
-    case '#':
-      if (x >= map_width) {
-	fprintf(stderr, "x >= width in Board_ReadFromStream\n");
-	return;
-      }
-      is_wall[x][y] = true;
-      ++x;
-      break;
-    case ' ':
-      if (x >= map_width) {
-	fprintf(stderr, "x >= width in Board_ReadFromStream\n");
-	return;
-      }
-      is_wall[x][y] = false;
-      ++x;
-      break;
-    case '1':
-      if (x >= map_width) {
-	fprintf(stderr, "x >= width in Board_ReadFromStream\n");
-	return;
-      }
-      is_wall[x][y] = false;
-      player_one_x = x;
-      player_one_y = y;
-      ++x;
-      break;
-    case '2':
-      if (x >= map_width) {
-	fprintf(stderr, "x >= width in Board_ReadFromStream\n");
-	return;
-      }
-      is_wall[x][y] = false;
-      player_two_x = x;
-      player_two_y = y;
-      ++x;
-      break;
-    default:
-      fprintf(stderr, "unexpected character %d in Board_ReadFromStream", c);
+  if (sscanf(header, "%d %d", &map_width, &map_height) < 2
+      || map_width <= 0 || map_height <= 0) {
+    fprintf(stderr, "bad dimensions in Board_ReadFromStream\n");
+    map_width = map_height = 0;
+    ClearWalls();
+    return;
+  }
+
+  // The first row tells how the lines end, "\n" or "\r\n"; every row
+  // must end the same way right after map_width characters.
+  frame.resize(map_height * (map_width + 2) + 1);
+  if (fgets(&frame[0], map_width + 3, file_handle) == NULL) {
+    ClearWalls();
+    return;
+  }
+  const int first_length = static_cast<int>(strlen(&frame[0]));
+  const bool has_line_end = first_length > 0 && frame[first_length - 1] == '\n';
+  row_length = (first_length == map_width + 2 && frame[map_width] == '\r')
+    ? map_width + 2 : map_width + 1;
+  bool are_rows_valid = has_line_end ? first_length == row_length
+    : first_length == map_width && map_height == 1 && feof(file_handle);
+  if (!has_line_end && !feof(file_handle)) {
+    SkipLine(file_handle);
+  }
+
+  // The rest are read a line at a time, even after a bad one, so that
+  // the next map starts where it should.
+  for (int y = 1; y < map_height; ++y) {
+    char* row = &frame[y * row_length];
+    if (fgets(row, row_length + 1, file_handle) == NULL) {
+      fprintf(stderr, "unexpected end of map in Board_ReadFromStream\n");
+      ClearWalls();
       return;
     }
+    const int length = static_cast<int>(strlen(row));
+    if (length == row_length
+        && memcmp(row + map_width, &frame[map_width], row_length - map_width) == 0) {
+      continue;
+    }
+    // The last row may have no line end at the end of a file.
+    if (y == map_height - 1 && length == map_width && feof(file_handle)) {
+      continue;
+    }
+    are_rows_valid = false;
+    if (row[length - 1] != '\n' && !feof(file_handle)) {
+      SkipLine(file_handle);
+    }
+  }
+  if (!are_rows_valid) {
+    fprintf(stderr, "x != width in Board_ReadFromStream\n");
+    ClearWalls();
+    return;
+  }
+
+  const char* rows = &frame[0];
+  const size_t frame_length = static_cast<size_t>(map_height - 1) * row_length + map_width;
+  const char* one = static_cast<const char*>(memchr(rows, '1', frame_length));
+  const char* two = static_cast<const char*>(memchr(rows, '2', frame_length));
+  if (one == NULL || two == NULL) {
+    fprintf(stderr, "missing player in Board_ReadFromStream\n");
+    ClearWalls();
+    return;
+  }
+  player_one_x = static_cast<int>(one - rows) % row_length;
+  player_one_y = static_cast<int>(one - rows) / row_length;
+  player_two_x = static_cast<int>(two - rows) % row_length;
+  player_two_y = static_cast<int>(two - rows) / row_length;
+
+  // Where the players were last time should now be walls; if not, this
+  // map doesn't follow from the last one.
+  const bool follows_last_map = walls_width == map_width
+    && walls_height == map_height
+    && previous_one_index >= 0
+    && rows[(previous_one_index / map_width) * row_length + previous_one_index % map_width] == '#'
+    && rows[(previous_two_index / map_width) * row_length + previous_two_index % map_width] == '#';
+
+  if (follows_last_map) {
+    walls[previous_one_index >> 6] |= 1ULL << (previous_one_index & 63);
+    walls[previous_two_index >> 6] |= 1ULL << (previous_two_index & 63);
+  } else if (!ReadWalls()) {
+    fprintf(stderr, "unexpected character in Board_ReadFromStream\n");
+    ClearWalls();
+    return;
+  }
+
+  last_one_index = player_one_y * map_width + player_one_x;
+  last_two_index = player_two_y * map_width + player_two_x;
+  is_valid = true;
+}
+
+void Map::ClearWalls() {
+  walls.assign((map_width * map_height + 63) / 64, 0);
+  walls_width = map_width;
+  walls_height = map_height;
+}
+
+bool Map::ReadWalls() {
+  ClearWalls();
+
+  for (int y = 0; y < map_height; ++y) {
+    const char* row = &frame[y * row_length];
+    for (int x = 0; x < map_width; ++x) {
+      if (row[x] == '#') {
+        const int index = y * map_width + x;
+        walls[index >> 6] |= 1ULL << (index & 63);
+      } else if (row[x] != ' ' && row[x] != '1' && row[x] != '2') {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Map::SkipLine(FILE *file_handle) {
+  int c = getc(file_handle);
+  while (c != '\n' && c != EOF) {
+    c = getc(file_handle);
   }
 }
@@ -1,4 +1,6 @@
-//I've left Map.h largely as it was, just added include guards.
+//I've left Map.h largely as it was, just added include guards and
+//replaced the parser with one that only looks up the positions after
+//the first map.
 //I use Map.h/cpp only to get initial map and to update my and opponent's
 //positions; a copy of the map is maintained internally in StepEvaluator.
 
@@ -10,15 +12,25 @@
 #ifndef MAP_H_
 #define MAP_H_
 
+#include <cstdio>
 #include <string>
 #include <vector>
 
 class Map {
  public:
   // Constructs a Map by reading an ASCII representation from the console
-  // (stdin).
+  // (stdin). Exits the program at the end of the input.
   Map();
 
+  // Constructs a Map by reading the same representation from an open
+  // file, e.g. a map from a corpus (see tools/Bench.cc). Never exits;
+  // check IsValid().
+  explicit Map(FILE* file_handle);
+
+  // Returns whether the map was read in full. An invalid map has no
+  // walls and both players at (0, 0), and must not be played on.
+  bool IsValid() const { return is_valid; }
+
   // Returns the width of the Tron map.
   int Width() const;
 
@@ -30,6 +42,12 @@ class Map {
   // not on the board are deemed to be walls.
   bool IsWall(int x, int y) const;
 
+  // Same as IsWall(index % Width(), index / Width()), without the bounds
+  // checks. The index must be on the board.
+  bool IsWallAt(int index) const {
+    return ((walls[index >> 6] >> (index & 63)) & 1) != 0;
+  }
+
   // Get my X and Y position. These are zero-based.
   int MyX() const;
   int MyY() const;
@@ -56,6 +74,11 @@ class Map {
   //   * 4 -- West. Negative X direction.
   static void MakeMove(int move);
 
+  // Indicates whether the next map can be read from stdin without
+  // blocking. Used to stop thinking during the opponent's turn.
+  // Always true in TEST_ENVIRONMENT, where there's no poll().
+  static bool IsInputPending();
+
  private:
   // Load a board from an open file handle. To read from the console, pass
   // stdin, which is actually a (FILE*).
@@ -75,11 +98,40 @@ class Map {
   // #1# 2#
   // #   ##
   // ######
+  //
+  // The rows are read into a buffer that's kept from map to map, one
+  // line each, and every row must end right after map_width characters.
+  // The walls are parsed from the first map only; after that, the only
+  // new walls are where the players were, and only the players' positions
+  // are looked up (with memchr()). A map that doesn't follow from the
+  // previous one is parsed in full, and may only hold '#', ' ', '1' and
+  // '2'.
+  //
+  // If the frame can't be read, the map is left invalid (see IsValid()),
+  // with the walls cleared, and the next map is parsed in full.
   void ReadFromFile(FILE *file_handle);
 
+  // Size the walls for the map and clear them.
+  void ClearWalls();
+
+  // Parse every cell of the frame into the walls. Returns false on an
+  // unexpected character.
+  bool ReadWalls();
+
+  // Read up to the end of the line, after a row that's too long.
+  static void SkipLine(FILE *file_handle);
+
  private:
-  // Indicates whether or not each cell in the board is passable.
-  std::vector<std::vector<bool> > is_wall;
+  // The rows of the last map read, as they came in, and the number of
+  // characters per row including the line end.
+  static std::vector<char> frame;
+  static int row_length;
+
+  // One bit per cell, row by row; set for the walls.  Shared by all the
+  // maps, and kept up to date with the last one read.
+  static std::vector<unsigned long long> walls;
+  static int walls_width, walls_height;
+  static int last_one_index, last_two_index;
 
   // The locations of both players.
   int player_one_x, player_one_y;
@@ -87,6 +139,9 @@ class Map {
 
   // Map dimensions.
   int map_width, map_height;
+
+  // Whether the last ReadFromFile() succeeded.
+  bool is_valid;
 };
 
 #endif /* MAP_H_ */
\ No newline at end of file
@@ -0,0 +1,471 @@
+/*
+ * See MonteCarloSearch.h for explanations.
+ */
+
+#include <vector>
+#include <cmath>
+#include "Map.h"
+#include "MonteCarloSearch.h"
+
+/**
+ * xorshift64* generator, as in Zobrist.cc.
+ */
+static unsigned long long NextRandomState(unsigned long long& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+MonteCarloSearch::MonteCarloSearch()
+: cCells_(NULL), board_(), iWidth_(0), iSize_(0), iMe_(0), iOpponent_(0), voronoi_(),
+chambers_(), endgameSolver_(), stopFunction_(NULL), area_(), scratch_(), nodes_(),
+iFreeNodes_(), iNodeStack_(), root_(kNoNode), maxNodes_(0x7fffffff), restrictedMove_(-1), path_(),
+iWalledCells_(), randomState_(88172645463325252ULL), numIterations_(0), publishedMove_(UP) {
+}
+
+MonteCarloSearch::~MonteCarloSearch() {
+	delete[] cCells_;
+}
+
+void MonteCarloSearch::initialize(const Map& map) {
+	iWidth_ = static_cast<TCellIndex>(map.Width());
+	const TCellIndex iHeight = static_cast<TCellIndex>(map.Height());
+	iSize_ = iWidth_ * iHeight;
+
+	//Only the cell colours and the neighbours are needed, not the context.
+	delete InitMoveScoreCalculator(iSize_, iWidth_);
+	InitZobristKeys(iSize_);
+	endgameSolver_.initialize(iSize_, iWidth_);
+	voronoi_.initialize(iSize_, iWidth_);
+	chambers_.initialize(iSize_);
+	board_.initialize(iSize_, iWidth_);
+	area_.initialize(iSize_, iWidth_);
+	scratch_.initialize(iSize_, iWidth_);
+
+	//Only the walls matter for placing and removing cells.
+	cCells_ = new TCell[iSize_];
+
+	for (TCellIndex iCell = 0; iCell < iSize_; ++iCell) {
+		cCells_[iCell] = (map.IsWallAt(iCell) ? 0 : NOT_WALL);
+	}
+
+	iMe_ = static_cast<TCellIndex>(map.MyY() * iWidth_ + map.MyX());
+	iOpponent_ = static_cast<TCellIndex>(map.OpponentY() * iWidth_ + map.OpponentX());
+	cCells_[iMe_] = 0;
+	cCells_[iOpponent_] = 0;
+	board_.copyCells(cCells_);
+
+	root_ = newNode();
+	numIterations_ = 0;
+	this->updateEndgameSolver();
+	this->publishBestMove();
+}
+
+void MonteCarloSearch::updateMoves(const Map& map) {
+	const TCellIndex iNewMe = static_cast<TCellIndex>(map.MyY() * iWidth_ + map.MyX());
+	const TCellIndex iNewOpponent = static_cast<TCellIndex>(map.OpponentY() * iWidth_ + map.OpponentX());
+
+	//Find out which direction me and opponent went.
+	int myMove = 0;
+	int opponentMove = 0;
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		if (GetNeighbour(iMe_, direction) == iNewMe) {
+			myMove = direction - 1;
+		}
+
+		if (GetNeighbour(iOpponent_, direction) == iNewOpponent) {
+			opponentMove = direction - 1;
+		}
+	}
+
+	//Keep the subtree under the moves made.
+	TNode newRoot = kNoNode;
+
+	if (kNoNode != root_) {
+		const int iChild = myMove + 4 * opponentMove;
+		newRoot = nodes_[root_].children[iChild];
+		nodes_[root_].children[iChild] = kNoNode;
+		freeSubtree(root_);
+	}
+
+	root_ = (kNoNode != newRoot ? newRoot : newNode());
+	restrictedMove_ = -1;
+
+	cCells_[iNewMe] = 0;
+	cCells_[iNewOpponent] = 0;
+	board_.removeCell(iNewMe);
+	board_.removeCell(iNewOpponent);
+	iMe_ = iNewMe;
+	iOpponent_ = iNewOpponent;
+
+	numIterations_ = 0;
+	this->updateEndgameSolver();
+	this->publishBestMove();
+}
+
+bool MonteCarloSearch::performIterations() {
+	if (endgameSolver_.isActive()) {
+		const bool isSolved = endgameSolver_.solve(stopFunction_);
+		this->publishBestMove();
+		return !isSolved;
+	}
+
+	if (kNoNode == root_) {
+		return false;
+	}
+
+	for (int i = 0; i < kIterationsPerCall && !HasTimedOut(); ++i) {
+		this->iterate();
+	}
+
+	this->publishBestMove();
+	return true;
+}
+
+void MonteCarloSearch::restrictMyMove(const int move) {
+	restrictedMove_ = move - 1;
+
+	if (endgameSolver_.isActive()) {
+		endgameSolver_.advance(GetNeighbour(iMe_, move));
+	}
+}
+
+int MonteCarloSearch::getBestMove() const {
+	if (endgameSolver_.isActive() && 0 != endgameSolver_.getBestMove()) {
+		return endgameSolver_.getBestMove();
+	}
+
+	int bestMove = UP;
+	int bestVisits = -1;
+
+	for (int move = 0; move < 4; ++move) {
+		if (!board_.isOpen(GetNeighbour(iMe_, move + 1))) {
+			continue;
+		}
+
+		const int numVisits = (kNoNode != root_ ? nodes_[root_].myVisits[move] : 0);
+
+		if (numVisits > bestVisits) {
+			bestMove = move + 1;
+			bestVisits = numVisits;
+		}
+	}
+
+	return bestMove;
+}
+
+void MonteCarloSearch::setMemoryLimit(const int megabytes) {
+	const double maxNodes = static_cast<double>(megabytes) * 1024 * 1024 / sizeof(Node);
+	maxNodes_ = (maxNodes < 0x7fffffff ? static_cast<int>(maxNodes) : 0x7fffffff);
+}
+
+void MonteCarloSearch::iterate() {
+	numIterations_++;
+	path_.clear();
+
+	TCellIndex iMe = iMe_;
+	TCellIndex iOpponent = iOpponent_;
+	TNode node = root_;
+	TNode leaf = kNoNode;
+	double result = 0.5;
+	bool isOver = false;
+
+	//Down the tree, until the game ends or a node is added.
+	while (true) {
+		PathEntry entry;
+		entry.node = node;
+		entry.myMove = this->selectMove(node, true, iMe);
+		entry.opponentMove = this->selectMove(node, false, iOpponent);
+		path_.push_back(entry);
+
+		const TCellIndex iNewMe = GetNeighbour(iMe, entry.myMove + 1);
+		const TCellIndex iNewOpponent = GetNeighbour(iOpponent, entry.opponentMove + 1);
+
+		if (this->isGameOver(iNewMe, iNewOpponent, &result)) {
+			isOver = true;
+			break;
+		}
+
+		placeWall(iNewMe);
+		placeWall(iNewOpponent);
+		iMe = iNewMe;
+		iOpponent = iNewOpponent;
+
+		const int iChild = entry.myMove + 4 * entry.opponentMove;
+		const TNode child = nodes_[node].children[iChild];
+
+		if (kNoNode == child) {
+			leaf = newNode();
+
+			if (kNoNode != leaf) {
+				nodes_[node].children[iChild] = leaf;
+			}
+
+			break;
+		}
+
+		node = child;
+	}
+
+	if (!isOver) {
+		result = this->playOut(iMe, iOpponent);
+	}
+
+	//Record the result; the opponent's results are the other way around.
+	const float myResult = static_cast<float>(result);
+	const float opponentResult = static_cast<float>(1.0 - result);
+
+	for (size_t i = 0; i < path_.size(); ++i) {
+		Node& pathNode = nodes_[path_[i].node];
+		pathNode.numVisits++;
+		pathNode.myVisits[path_[i].myMove]++;
+		pathNode.myResults[path_[i].myMove] += myResult;
+		pathNode.opponentVisits[path_[i].opponentMove]++;
+		pathNode.opponentResults[path_[i].opponentMove] += opponentResult;
+	}
+
+	if (kNoNode != leaf) {
+		nodes_[leaf].numVisits++;
+	}
+
+	//Put the board back.
+	for (size_t i = 0; i < iWalledCells_.size(); ++i) {
+		board_.addCell(iWalledCells_[i]);
+	}
+
+	iWalledCells_.clear();
+}
+
+int MonteCarloSearch::selectMove(const TNode node, const bool isMine, const TCellIndex iPosition) {
+	if (isMine && node == root_ && restrictedMove_ >= 0) {
+		return restrictedMove_;
+	}
+
+	const Node& current = nodes_[node];
+	const int* visits = (isMine ? current.myVisits : current.opponentVisits);
+	const float* results = (isMine ? current.myResults : current.opponentResults);
+
+	//Moves that haven't been tried go first, in a random order.
+	const int firstMove = static_cast<int>(nextRandom() % 4);
+	const double logVisits = std::log(static_cast<double>(current.numVisits + 1));
+	const double exploration = static_cast<double>(kExplorationPercent) / 100;
+	int bestMove = -1;
+	double bestValue = 0;
+
+	for (int i = 0; i < 4; ++i) {
+		const int move = (firstMove + i) % 4;
+
+		if (!board_.isOpen(GetNeighbour(iPosition, move + 1))) {
+			continue;
+		}
+
+		if (0 == visits[move]) {
+			return move;
+		}
+
+		const double value = results[move] / visits[move]
+			+ exploration * std::sqrt(logVisits / visits[move]);
+
+		if (bestMove < 0 || value > bestValue) {
+			bestMove = move;
+			bestValue = value;
+		}
+	}
+
+	//Nowhere to go; any move will do.
+	return (bestMove >= 0 ? bestMove : 0);
+}
+
+double MonteCarloSearch::playOut(TCellIndex iMe, TCellIndex iOpponent) {
+	for (int length = 0; ; ++length) {
+		if (0 == length % kSeparationCheckInterval && this->areSeparated(iMe, iOpponent)) {
+			return this->scoreSeparated(iMe, iOpponent);
+		}
+
+		if (length >= kMaxPlayoutLength) {
+			return this->scoreTerritories(iMe, iOpponent);
+		}
+
+		const TCellIndex iNewMe = GetNeighbour(iMe, this->pickPlayoutMove(iMe) + 1);
+		const TCellIndex iNewOpponent = GetNeighbour(iOpponent, this->pickPlayoutMove(iOpponent) + 1);
+		double result = 0.5;
+
+		if (this->isGameOver(iNewMe, iNewOpponent, &result)) {
+			return result;
+		}
+
+		placeWall(iNewMe);
+		placeWall(iNewOpponent);
+		iMe = iNewMe;
+		iOpponent = iNewOpponent;
+	}
+}
+
+int MonteCarloSearch::pickPlayoutMove(const TCellIndex iPosition) {
+	int moves[4];
+	int numMoves = 0;
+	int bestMove = -1;
+	int bestNeighbours = 0;
+
+	for (int move = 0; move < 4; ++move) {
+		const TCellIndex iNeighbour = GetNeighbour(iPosition, move + 1);
+
+		if (!board_.isOpen(iNeighbour)) {
+			continue;
+		}
+
+		moves[numMoves++] = move;
+
+		//Hug the walls, but stay out of dead ends while there's a choice.
+		int numNeighbours = board_.countOpenNeighbours(iNeighbour);
+
+		if (0 == numNeighbours) {
+			numNeighbours = 4;
+		}
+
+		if (bestMove < 0 || numNeighbours < bestNeighbours) {
+			bestMove = move;
+			bestNeighbours = numNeighbours;
+		}
+	}
+
+	if (0 == numMoves) {
+		return 0;
+	}
+
+	const unsigned int random = nextRandom();
+
+	if (static_cast<int>(random % 100) < kWallHuggingPercent) {
+		return bestMove;
+	}
+
+	return moves[(random / 100) % numMoves];
+}
+
+bool MonteCarloSearch::isGameOver(const TCellIndex iNewMe,
+								  const TCellIndex iNewOpponent,
+								  double* result) const {
+	const bool amIDead = (iNewMe == iNewOpponent || !board_.isOpen(iNewMe));
+	const bool isOpponentDead = (iNewMe == iNewOpponent || !board_.isOpen(iNewOpponent));
+
+	if (!amIDead && !isOpponentDead) {
+		return false;
+	}
+
+	if (amIDead && isOpponentDead) {
+		*result = 0.5;
+	} else {
+		*result = (amIDead ? 0.0 : 1.0);
+	}
+
+	return true;
+}
+
+bool MonteCarloSearch::areSeparated(const TCellIndex iMe, const TCellIndex iOpponent) {
+	board_.countReachable(iMe, &area_, &scratch_);
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		if (area_.isOpen(GetNeighbour(iOpponent, direction))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+double MonteCarloSearch::scoreSeparated(const TCellIndex iMe, const TCellIndex iOpponent) {
+	const int myFill = chambers_.build(board_, iMe);
+	const int opponentFill = chambers_.build(board_, iOpponent);
+
+	if (myFill == opponentFill) {
+		return 0.5;
+	}
+
+	return (myFill > opponentFill ? 1.0 : 0.0);
+}
+
+double MonteCarloSearch::scoreTerritories(const TCellIndex iMe, const TCellIndex iOpponent) {
+	board_.addCell(iMe);
+	board_.addCell(iOpponent);
+	const CellBalance balance = voronoi_.compute(board_, iMe, iOpponent);
+	board_.removeCell(iMe);
+	board_.removeCell(iOpponent);
+
+	if (0 == balance.score) {
+		return 0.5;
+	}
+
+	return (balance.score > 0 ? 1.0 : 0.0);
+}
+
+void MonteCarloSearch::placeWall(const TCellIndex iCell) {
+	board_.removeCell(iCell);
+	iWalledCells_.push_back(iCell);
+}
+
+MonteCarloSearch::TNode MonteCarloSearch::newNode() {
+	TNode node = kNoNode;
+
+	if (!iFreeNodes_.empty()) {
+		node = iFreeNodes_.back();
+		iFreeNodes_.pop_back();
+
+	} else if (static_cast<int>(nodes_.size()) < maxNodes_) {
+		node = static_cast<TNode>(nodes_.size());
+		nodes_.push_back(Node());
+
+	} else {
+		return kNoNode;
+	}
+
+	Node& result = nodes_[node];
+	result.numVisits = 0;
+
+	for (int move = 0; move < 4; ++move) {
+		result.myVisits[move] = 0;
+		result.opponentVisits[move] = 0;
+		result.myResults[move] = 0;
+		result.opponentResults[move] = 0;
+	}
+
+	for (int i = 0; i < 16; ++i) {
+		result.children[i] = kNoNode;
+	}
+
+	return node;
+}
+
+void MonteCarloSearch::freeSubtree(const TNode node) {
+	iNodeStack_.clear();
+	iNodeStack_.push_back(node);
+
+	while (!iNodeStack_.empty()) {
+		const TNode current = iNodeStack_.back();
+		iNodeStack_.pop_back();
+		iFreeNodes_.push_back(current);
+
+		for (int i = 0; i < 16; ++i) {
+			if (kNoNode != nodes_[current].children[i]) {
+				iNodeStack_.push_back(nodes_[current].children[i]);
+			}
+		}
+	}
+}
+
+unsigned int MonteCarloSearch::nextRandom() {
+	return static_cast<unsigned int>(NextRandomState(randomState_) >> 32);
+}
+
+void MonteCarloSearch::updateEndgameSolver() {
+	if (endgameSolver_.isActive()) {
+		endgameSolver_.advance(iMe_);
+		return;
+	}
+
+	//Once separated, the bots stay separated.
+	if (this->areSeparated(iMe_, iOpponent_)) {
+		endgameSolver_.start(cCells_, iMe_);
+	}
+}
@@ -0,0 +1,224 @@
+/*
+ * Monte Carlo tree search, as an alternative to the step tree (see
+ * StepEvaluator.h).  Selected with USE_MONTE_CARLO_SEARCH in
+ * MyTronBot.cc.
+ *
+ * Every iteration plays one game out from the current position.  In
+ * the tree, both bots pick their moves at the same time, and each one
+ * picks on its own statistics (decoupled UCT): a node keeps the visits
+ * and the results of each of my moves and of each of the opponent's
+ * moves, and each bot takes the move with the best UCB1 value without
+ * knowing what the other one takes.  The pair of moves leads to one of
+ * the node's 16 children, numbered the same way as the child steps.
+ * Every iteration adds one node to the tree.
+ *
+ * Past the tree, the game is played out with a cheap random policy
+ * that mostly hugs the walls.  Every few moves the playout checks
+ * whether the bots have been separated; once they are, the tree of
+ * chambers (see Chambers.h) decides who fills more, and the game isn't
+ * played any further.  A playout that goes on for too long is decided
+ * by the split of the territories (see Voronoi.h).  A win counts 1, a
+ * draw 1/2, and a loss 0.
+ *
+ * The tree is kept between moves: updateMoves() keeps the subtree
+ * under the moves that were made and frees the rest of the nodes for
+ * reuse.  The search can be stopped after any iteration, so it fits
+ * the deadline loop in MakeMove().  Once the bots are separated, the
+ * endgame solver takes over, as in the step tree.  Runs on the calling
+ * thread only.
+ */
+#ifndef MONTE_CARLO_SEARCH_H_
+#define MONTE_CARLO_SEARCH_H_
+
+#include <vector>
+#include "MoveScore.h"
+#include "BitBoard.h"
+#include "Voronoi.h"
+#include "Chambers.h"
+#include "EndgameSolver.h"
+#include "Zobrist.h"
+#include "Timer.h"
+#include "Threads.h"
+
+class Map;
+
+class MonteCarloSearch {
+public:
+	//Iterations per performIterations().
+	static const int kIterationsPerCall = 32;
+
+	//Weight of the exploration term in UCB1, in percent.
+	static const int kExplorationPercent = 50;
+
+	//Percentage of the playout moves that go to the neighbour with
+	//the fewest open neighbours, rather than to a random one.
+	static const int kWallHuggingPercent = 75;
+
+	//Playout moves between the checks for separation.
+	static const int kSeparationCheckInterval = 4;
+
+	//Past this many moves, the playout is decided by the territories.
+	static const int kMaxPlayoutLength = 150;
+
+	MonteCarloSearch();
+	~MonteCarloSearch();
+
+	void initialize(const Map& map);
+
+	/**
+	 * Update my and opponent's positions after moves have been made.
+	 * The subtree under the moves made becomes the new tree.
+	 */
+	void updateMoves(const Map& map);
+
+	/**
+	 * Run a batch of iterations, or the endgame solver once
+	 * the bots are separated.
+	 * @return indicator whether there's any more work to be done.
+	 */
+	bool performIterations();
+
+	/**
+	 * Make the endgame solver also stop whenever the function returns
+	 * true, and not only when the time runs out.  NULL to clear.
+	 */
+	void setStopFunction(TStopFunction stopFunction)	{ stopFunction_ = stopFunction;}
+
+	/**
+	 * My move has been sent; only play out the games that follow
+	 * from it while waiting for the opponent's move.
+	 * @param move: the move made (UP, RIGHT, etc.).
+	 */
+	void restrictMyMove(int move);
+
+	/**
+	 * The most visited of my moves that doesn't lead into a wall.
+	 */
+	int getBestMove() const;
+
+	/**
+	 * getBestMove() as of the end of the last batch of iterations.
+	 * Takes no locks; see Watchdog.h.
+	 */
+	int getPublishedMove() const	{ return static_cast<int>(LoadShared(&publishedMove_));}
+
+	/**
+	 * Limit the memory taken up by the tree.  Once the nodes run
+	 * out, the iterations stop adding them.
+	 */
+	void setMemoryLimit(int megabytes);
+
+	int getNumIterations() const	{ return numIterations_;}
+	int getNumNodes() const			{ return static_cast<int>(nodes_.size() - iFreeNodes_.size());}
+
+private:
+	typedef int TNode;
+	static const TNode kNoNode = -1;
+
+	struct Node {
+		int numVisits;
+
+		//Per move (UP - 1, RIGHT - 1, etc.), for each bot; the results
+		//are from the bot's own point of view.
+		int myVisits[4];
+		int opponentVisits[4];
+		float myResults[4];
+		float opponentResults[4];
+
+		//Per pair of moves: my move + 4 * opponent's move.
+		TNode children[16];
+	};
+
+	//One node passed by the current iteration, and the moves taken there.
+	struct PathEntry {
+		TNode node;
+		int myMove;
+		int opponentMove;
+	};
+
+	/**
+	 * Play one game out from the current position and
+	 * record the result in the tree.
+	 */
+	void iterate();
+
+	/**
+	 * Pick a move at the node using UCB1 on the bot's own statistics.
+	 * @return the move (UP - 1, RIGHT - 1, etc.).
+	 */
+	int selectMove(TNode node, bool isMine, TCellIndex iPosition);
+
+	/**
+	 * Play the game out from the positions, which must be walls on
+	 * the board, with the random policy.  The moves are undone by
+	 * iterate().
+	 * @return the result for me.
+	 */
+	double playOut(TCellIndex iMe, TCellIndex iOpponent);
+
+	/**
+	 * Random move for the playout.
+	 * @return the move (UP - 1, RIGHT - 1, etc.).
+	 */
+	int pickPlayoutMove(TCellIndex iPosition);
+
+	/**
+	 * Check whether the bots have moved into walls or into each other.
+	 * @param result: set to the result for me if the game is over.
+	 */
+	bool isGameOver(TCellIndex iNewMe, TCellIndex iNewOpponent, double* result) const;
+
+	bool areSeparated(TCellIndex iMe, TCellIndex iOpponent);
+
+	//Result for me, once the game can't be played out any further.
+	double scoreSeparated(TCellIndex iMe, TCellIndex iOpponent);
+	double scoreTerritories(TCellIndex iMe, TCellIndex iOpponent);
+
+	//Wall off a cell on the board until the end of the iteration.
+	void placeWall(TCellIndex iCell);
+
+	TNode newNode();
+	void freeSubtree(TNode node);
+
+	unsigned int nextRandom();
+
+	void updateEndgameSolver();
+
+	void publishBestMove()			{ StoreShared(&publishedMove_, static_cast<unsigned long long>(getBestMove()));}
+
+	//The map after the moves made so far, with both positions walled.
+	TCell* cCells_;
+	BitBoard board_;
+	TCellIndex iWidth_;
+	TCellIndex iSize_;
+	TCellIndex iMe_;
+	TCellIndex iOpponent_;
+
+	Voronoi voronoi_;
+	ArticulationChambers chambers_;
+	EndgameSolver endgameSolver_;
+	TStopFunction stopFunction_;
+
+	//Scratch space for finding the reachable cells.
+	BitBoard area_;
+	BitBoard scratch_;
+
+	std::vector<Node> nodes_;
+	std::vector<TNode> iFreeNodes_;
+	std::vector<TNode> iNodeStack_;
+	TNode root_;
+	int maxNodes_;
+
+	//My move at the root while pondering (UP - 1, etc.), or -1.
+	int restrictedMove_;
+
+	//The current iteration.
+	std::vector<PathEntry> path_;
+	std::vector<TCellIndex> iWalledCells_;
+
+	unsigned long long randomState_;
+	int numIterations_;
+	unsigned long long publishedMove_;
+};
+
+#endif /* MONTE_CARLO_SEARCH_H_ */
@@ -0,0 +1,96 @@
+#include "MoveOrdering.h"
+
+MoveOrdering::MoveOrdering()
+: myHistory_(), opponentHistory_() {
+	for (int depth = 0; depth < kNumKillerDepths; ++depth) {
+		killers_[depth][0] = -1;
+		killers_[depth][1] = -1;
+	}
+}
+
+void MoveOrdering::initialize(const TCellIndex iSize) {
+	myHistory_.assign(iSize * 4, 0);
+	opponentHistory_.assign(iSize * 4, 0);
+}
+
+void MoveOrdering::getChildOrder(const int depth, 
+								 const TCellIndex iMe, 
+								 const TCellIndex iOpponent, 
+								 char* childOrder) const {
+	const char* killers = killers_[depth % kNumKillerDepths];
+	int childScores[16];
+
+	for (int childId = 0; childId < 16; ++childId) {
+		const int myDirection = childId % 4;
+		const int opponentDirection = childId / 4;
+
+		int childScore = myHistory_[iMe * 4 + myDirection] 
+			+ opponentHistory_[iOpponent * 4 + opponentDirection];
+
+		if (killers[0] == childId) {
+			childScore += 2 * kKillerBonus;
+
+		} else if (killers[1] == childId) {
+			childScore += kKillerBonus;
+		}
+
+		//Insertion sort; ties keep the usual direction order.
+		int i = childId;
+
+		while (i > 0 && childScores[i - 1] < childScore) {
+			childScores[i] = childScores[i - 1];
+			childOrder[i] = childOrder[i - 1];
+			--i;
+		}
+
+		childScores[i] = childScore;
+		childOrder[i] = static_cast<char>(childId);
+	}
+}
+
+void MoveOrdering::rewardRefutation(const int depth, 
+									const int relativeDepth, 
+									const TCellIndex iOpponent, 
+									const int childId) {
+	addHistory(opponentHistory_[iOpponent * 4 + childId / 4], relativeDepth);
+	addKiller(depth, childId);
+}
+
+void MoveOrdering::rewardBestMove(const int depth, 
+								  const int relativeDepth, 
+								  const TCellIndex iMe, 
+								  const int childId) {
+	addHistory(myHistory_[iMe * 4 + childId % 4], relativeDepth);
+	addKiller(depth, childId);
+}
+
+void MoveOrdering::age() {
+	const int size = static_cast<int>(myHistory_.size());
+
+	for (int i = 0; i < size; ++i) {
+		myHistory_[i] /= 2;
+		opponentHistory_[i] /= 2;
+	}
+}
+
+void MoveOrdering::addKiller(const int depth, const int childId) {
+	char* killers = killers_[depth % kNumKillerDepths];
+
+	if (killers[0] != childId) {
+		killers[1] = killers[0];
+		killers[0] = static_cast<char>(childId);
+	}
+}
+
+/**
+ * Moves that work close to the root are worth more; they are
+ * based on deeper searches.
+ */
+void MoveOrdering::addHistory(int& history, const int relativeDepth) {
+	const int shift = (relativeDepth < 0 ? 0 : (relativeDepth < 10 ? relativeDepth : 10));
+	history += (1 << 10) >> shift;
+
+	if (history > kMaxHistory) {
+		history = kMaxHistory;
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ * Move ordering for the step tree.
+ *
+ * Step::branch() puts the children into the evaluation que in the
+ * order given by MoveOrdering, so that the children most likely to
+ * refute their siblings are evaluated first and the alpha-beta cutoffs
+ * in Step::updateCutoffs() happen as early as possible.
+ *
+ * Two heuristics are combined:
+ * (1) Killer moves: for every depth, the last two pairs of moves
+ *		(child ids) that refuted a move or turned out best.  The same
+ *		pair of moves tends to work in sibling positions.
+ * (2) History: for every cell and direction, how often going in that
+ *		direction from that cell turned out good, separately for me
+ *		and for the opponent.  Aged every turn.
+ *
+ * MoveOrdering is only used while holding the tree lock.
+ */
+#ifndef MOVE_ORDERING_H_
+#define MOVE_ORDERING_H_
+
+#include <vector>
+#include "MoveScore.h"
+
+class MoveOrdering {
+public:
+	//Number of depths that have their own killer moves; deeper
+	//steps share them.
+	static const int kNumKillerDepths = 256;
+
+	//Upper limit on a history entry.
+	static const int kMaxHistory = 1 << 24;
+
+	//Killers are tried before any move without one, regardless
+	//of the history.
+	static const int kKillerBonus = 1 << 26;
+
+	MoveOrdering();
+
+	/**
+	 * Allocate the history tables.
+	 */
+	void initialize(TCellIndex iSize);
+
+	/**
+	 * Fill childOrder with the 16 child ids, from the most promising 
+	 * to the least promising.
+	 */
+	void getChildOrder(int depth, TCellIndex iMe, TCellIndex iOpponent, char* childOrder) const;
+
+	/**
+	 * The opponent's move in the child refuted my move.
+	 * @param depth: depth of the parent step.
+	 * @param relativeDepth: depth of the parent step from the root.
+	 */
+	void rewardRefutation(int depth, int relativeDepth, TCellIndex iOpponent, int childId);
+
+	/**
+	 * My move in the child is the best one from the parent step.
+	 */
+	void rewardBestMove(int depth, int relativeDepth, TCellIndex iMe, int childId);
+
+	/**
+	 * Make the history fade; called once per turn.
+	 */
+	void age();
+
+private:
+	void addKiller(int depth, int childId);
+	static void addHistory(int& history, int relativeDepth);
+
+	char killers_[kNumKillerDepths][2];
+	std::vector<int> myHistory_;			//Indexed by cell * 4 + direction.
+	std::vector<int> opponentHistory_;
+};
+
+#endif /* MOVE_ORDERING_H_ */
@@ -8,8 +8,10 @@
  */
 
 #include <vector>
-#include <deque>
 #include "MoveScore.h"
+#include "BitBoard.h"
+#include "Voronoi.h"
+#include "Chambers.h"
 
 //NO LONGER USED.
 //Replaced with StepEvaluator::kMaxPathCalculationDepth.
@@ -89,56 +91,94 @@ void CellIndexQue_::pop_back() {
 //================== End of CellIndexQue_ =========================//
 
 typedef CellIndexQue_ CellIndexQue;
-typedef std::vector<TCell> CellStack;
-typedef std::vector<TCellIndex> CellIndexStack;
-
-//Matrixes used in temp calculations.
-bool* gTempGrid = NULL;
-TColor* gTempColorMatrix = NULL;
-short* gTempIntMatrix1 = NULL;
-short* gTempIntMatrix2 = NULL;
-
-CellIndexQue* g_TempCellIndexQue = NULL;
-CellIndexStack* g_TempCellIndexStack = NULL;
-CellStack* g_TempCellStack = NULL;
 
+//Map dimensions.  Set once in InitMoveScoreCalculator() and only
+//read afterwards, so they are safe to share between threads.
 TCellIndex g_iSize_ = 0;
 TCellIndex g_iWidth_ = 0;
+TColor* g_cellColors_ = NULL;
+
+/*****************************
+    Class ScoringContext
+*****************************/
+ScoringContext::ScoringContext(const TCellIndex size)
+: iSize_(size), tempGrid_(NULL), tempColorMatrix_(NULL), tempIntMatrix1_(NULL), 
+tempIntMatrix2_(NULL), cellIndexQue_(NULL), iBranchRoots_(NULL), bsBranchSizes_(NULL), 
+bsBranchBlackCells_(NULL), bCellBranches_(NULL), leafBranches_(NULL), myBranches_(NULL), visitedBranches_(NULL), 
+bFirstBranch_(0), bMergePath1_(NULL), bMergePath2_(NULL), bBranchesToMerge_(NULL), 
+mergeQue_(NULL), stepFlags_(NULL), openCells_(NULL), voronoi_(NULL), chamberMethod_(BOTTLENECK_CHAMBERS),
+articulationChambers_(NULL), territoryMethod_(FRONTIER_TERRITORIES) {
+	tempGrid_ = new bool[size];
+	tempIntMatrix1_ = new short[size];
+	tempIntMatrix2_ = new short[size];
+	tempColorMatrix_ = new TColor[size];
+
+	iBranchRoots_ = new TCellIndex[MAX_BRANCHES];
+	bsBranchSizes_ = new TBranchSize[MAX_BRANCHES];
+	bsBranchBlackCells_ = new TBranchSize[MAX_BRANCHES];
+	bCellBranches_ = new TBranch[MAX_BRANCHES];
+	leafBranches_ = new bool[MAX_BRANCHES];
+	myBranches_ = new bool[MAX_BRANCHES];
+	visitedBranches_ = new bool[MAX_BRANCHES];
+	bMergePath1_ = new TBranch[MAX_BRANCHES];
+	bMergePath2_ = new TBranch[MAX_BRANCHES];
+	bBranchesToMerge_ = new TBranch[MAX_BRANCHES];
+	stepFlags_ = new unsigned char[size];
+
+	cellIndexQue_ = new CellIndexQue();
+	mergeQue_ = new CellIndexQue();
+
+	openCells_ = new BitBoard();
+	openCells_->initialize(size, g_iWidth_);
+	voronoi_ = new Voronoi();
+	voronoi_->initialize(size, g_iWidth_);
+	articulationChambers_ = new ArticulationChambers();
+	articulationChambers_->initialize(size);
+}
 
-//TBranchCount g_bcBranchCount = 0;
-TCellIndex* g_iBranchRoots = NULL;
-TBranchSize* g_bsBranchSizes = NULL;
-TBranch* g_bCellBranches = NULL;
-bool* g_leafBranches = NULL;
-bool* g_myBranches = NULL;
-bool g_areBotsSeparated = false;
-int g_distanceFromOpponent = 40;
-
-TBranch g_bFirstBranch = 0;
+ScoringContext::~ScoringContext() {
+	delete[] tempGrid_;
+	delete[] tempIntMatrix1_;
+	delete[] tempIntMatrix2_;
+	delete[] tempColorMatrix_;
+
+	delete[] iBranchRoots_;
+	delete[] bsBranchSizes_;
+	delete[] bsBranchBlackCells_;
+	delete[] bCellBranches_;
+	delete[] leafBranches_;
+	delete[] myBranches_;
+	delete[] visitedBranches_;
+	delete[] bMergePath1_;
+	delete[] bMergePath2_;
+	delete[] bBranchesToMerge_;
+	delete[] stepFlags_;
+
+	delete cellIndexQue_;
+	delete mergeQue_;
+	delete openCells_;
+	delete voronoi_;
+	delete articulationChambers_;
+}
 
 /**
- * Initialize the global variables above.
+ * Set the map dimensions and create the scoring context 
+ * for the calling thread.
  */
-void InitMoveScoreCalculator(const TCellIndex size, const TCellIndex width) {
+ScoringContext* InitMoveScoreCalculator(const TCellIndex size, const TCellIndex width) {
 	g_iSize_ = size;
 	g_iWidth_ = width;
 
-	gTempGrid = new bool[size];
-	gTempIntMatrix1 = new short[size];
-	gTempIntMatrix2 = new short[size];
-	gTempColorMatrix = new TColor[size];
-
-	g_iBranchRoots = new TCellIndex[MAX_BRANCHES];
-	g_bsBranchSizes = new TBranchSize[MAX_BRANCHES];
-	g_bCellBranches = new TBranch[MAX_BRANCHES];
-	g_leafBranches = new bool[MAX_BRANCHES];
-	g_myBranches = new bool[MAX_BRANCHES];
+	delete[] g_cellColors_;
+	g_cellColors_ = new TColor[size];
 
-	g_TempCellIndexQue = new CellIndexQue();
-	g_TempCellIndexStack = new CellIndexStack();
-	g_TempCellStack = new CellStack();
+	for (TCellIndex iCell = 0; iCell < size; ++iCell) {
+		const TCellIndex x = iCell % width;
+		const TCellIndex y = iCell / width;
+		g_cellColors_[iCell] = ((x + y) % 2 == 0 ? BLACK_COLOR : RED_COLOR);
+	}
 
-	g_distanceFromOpponent = 40;
+	return new ScoringContext(size);
 }
 
 /**
@@ -167,6 +207,10 @@ TCellIndex GetNeighbour(const TCellIndex iPosition, const int direction) {
 	}
 }
 
+TColor GetCellColor(const TCellIndex iCell) {
+	return g_cellColors_[iCell];
+}
+
 /**
  * Replace a cell on a map with a wall.  Return the removed cell.
  * @param edges: the matrix of cells on the field.
@@ -256,15 +300,18 @@ void AddCell(TCell* cells, const TCell cCell, const TCellIndex iPosition, const
 /**
  * Merge two branches; return lowest common parent.
  */
-TBranch MergeBranches(TCellIndex* iBranchRoots,
-				   TBranch* bCellBranches,
-				   TBranchSize* bsBranchSizes,
+TBranch MergeBranches(ScoringContext* context,
 				   TCell* cCells,
-				   bool* leafBranches,
 				   TBranch bNumBranches,
 				   const TCellIndex iBranchEnd1,
 				   const TCellIndex iBranchEnd2,
 				   const TBranch bNeutralBranch) {
+	TCellIndex* iBranchRoots = context->iBranchRoots_;
+	TBranch* bCellBranches = context->bCellBranches_;
+	TBranchSize* bsBranchSizes = context->bsBranchSizes_;
+	TBranchSize* bsBranchBlackCells = context->bsBranchBlackCells_;
+	bool* leafBranches = context->leafBranches_;
+
 	TBranch bBranch1 = bCellBranches[iBranchEnd1];
 	TBranch bBranch2 = bCellBranches[iBranchEnd2];
 
@@ -275,12 +322,11 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 	
 	//Find the lowest common parent of the two branches.
 	//While doing that, build a list of branches to merge.
-	bool* hasVisited = new bool[bNumBranches];
-	std::vector<TBranch> bPath1;
-	std::vector<TBranch> bPath2;
-
-	bPath1.reserve(bNumBranches);
-	bPath2.reserve(bNumBranches);
+	bool* hasVisited = context->visitedBranches_;
+	TBranch* bPath1 = context->bMergePath1_;
+	TBranch* bPath2 = context->bMergePath2_;
+	int path1Size = 0;
+	int path2Size = 0;
 
 	for (TBranch bBranch = bNeutralBranch + 1; bBranch < bNumBranches; ++bBranch) {
 		hasVisited[bBranch] = false;
@@ -293,8 +339,8 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 
 	hasVisited[bBranch1] = true;
 	hasVisited[bBranch2] = true;
-	bPath1.push_back(bBranch1);
-	bPath2.push_back(bBranch2);
+	bPath1[path1Size++] = bBranch1;
+	bPath2[path2Size++] = bBranch2;
 
 	while(NO_BRANCH == bCommonParent) {
 		if (continuePath1) {
@@ -308,7 +354,7 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 				break;
 			} else {
 				hasVisited[bParent1] = true;
-				bPath1.push_back(bParent1);
+				bPath1[path1Size++] = bParent1;
 				bBranch1 = bParent1;
 			}
 		}
@@ -324,21 +370,19 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 				break;
 			} else {
 				hasVisited[bParent2] = true;
-				bPath2.push_back(bParent2);
+				bPath2[path2Size++] = bParent2;
 				bBranch2 = bParent2;
 			}
 		}
 	}
 
 	//Found the common parent.  Compile a list of branches to relabel as common parent.
-	std::vector<TBranch> bBranchesToMerge;
-	bBranchesToMerge.reserve(bNumBranches);
-	const int path1Size = static_cast<int>(bPath1.size());
-	const int path2Size = static_cast<int>(bPath2.size());
+	TBranch* bBranchesToMerge = context->bBranchesToMerge_;
+	int numBranchesToMerge = 0;
 	
 	for (int i = 0; i < path1Size; ++i) {
 		if (bPath1[i] != bCommonParent) {
-			bBranchesToMerge.push_back(bPath1[i]);
+			bBranchesToMerge[numBranchesToMerge++] = bPath1[i];
 
 		} else {
 			break;
@@ -347,7 +391,7 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 
 	for (int i = 0; i < path2Size; ++i) {
 		if (bPath2[i] != bCommonParent) {
-			bBranchesToMerge.push_back(bPath2[i]);
+			bBranchesToMerge[numBranchesToMerge++] = bPath2[i];
 
 		} else {
 			break;
@@ -358,23 +402,25 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 	//First, merge the branch sizes and make sure the target branches are
 	//no longer leaf branches.
 
-	const int numBranchesToMerge = static_cast<int>(bBranchesToMerge.size());
 	TBranchSize bsAddToParentSize = 0;
+	TBranchSize bsAddToParentBlackCells = 0;
 	
 	for (int i = 0; i < numBranchesToMerge; ++i) {
 		const TBranch bBranchToMerge = bBranchesToMerge[i];
 		bsAddToParentSize += bsBranchSizes[bBranchToMerge];
+		bsAddToParentBlackCells += bsBranchBlackCells[bBranchToMerge];
 		leafBranches[bBranchToMerge] = false;
 	}
 
 	const TBranch bLowestCommonParent = bCommonParent;
 	bsBranchSizes[bLowestCommonParent] += bsAddToParentSize;
+	bsBranchBlackCells[bLowestCommonParent] += bsAddToParentBlackCells;
 	leafBranches[bLowestCommonParent] = true;
 
 	
 	//Relabel the cells belonging to the branches that need 
 	//to be merged as bLowestCommonParent.
-	std::deque<TCellIndex> iCellsToCheck;
+	CellIndexQue& iCellsToCheck = *context->mergeQue_;
 
 	if (bLowestCommonParent != bCellBranches[iBranchEnd1]) {
 		bCellBranches[iBranchEnd1] = bLowestCommonParent;
@@ -412,8 +458,6 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 			if (bLowestCommonParent != bNeighbourBranch 
 				&& bNeighbourBranch != NO_BRANCH) {
 				//Check whether this branch should be merged.
-				const int numBranchesToMerge = static_cast<int>(bBranchesToMerge.size());
-
 				for (int i = 0; i < numBranchesToMerge; ++i) {
 					if (bNeighbourBranchId == bBranchesToMerge[i]) {
 						bCellBranches[iNeighbour] = (bLowestCommonParent | bNeighbourClaim);
@@ -425,8 +469,6 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 		}
 	}
 	
-	delete[] hasVisited;
-
 	return bLowestCommonParent;
 }
 
@@ -434,11 +476,11 @@ TBranch MergeBranches(TCellIndex* iBranchRoots,
 /**
  * Calculate distance to the opponent.
  */
-short GetOpponentDistance(TCell* cCells, const TCellIndex iMe, const TCellIndex iOpponent) {
-	TColor* cellColors = gTempColorMatrix;
+short GetOpponentDistance(ScoringContext* context, TCell* cCells, const TCellIndex iMe, const TCellIndex iOpponent) {
+	TColor* cellColors = context->tempColorMatrix_;
 	
 	//Reset the colors;
-	for (int i = 0; i < g_iSize_; ++i) {
+	for (int i = 0; i < context->iSize_; ++i) {
 		cellColors[i] = NO_COLOR;
 	}
 
@@ -447,7 +489,7 @@ short GetOpponentDistance(TCell* cCells, const TCellIndex iMe, const TCellIndex
 	TColor nextColor = RED_COLOR;
 
 	//Search the cells breadth-first.
-	CellIndexQue* cellsToCheck = g_TempCellIndexQue;
+	CellIndexQue* cellsToCheck = context->cellIndexQue_;
 	
 	cellsToCheck->push_back(iMe);
 	short distance = 0;
@@ -492,42 +534,272 @@ short GetOpponentDistance(TCell* cCells, const TCellIndex iMe, const TCellIndex
 
 const short NOT_VISITED = -3000;  //Indicates that the cell yet has not been visited.
 
+/**
+ * Split the open cells on context->openCells_ between the bots
+ * the way the context asks for (see TTerritoryMethod).
+ */
+static CellBalance SplitTerritories(ScoringContext* context,
+				   const TCellIndex iMe,
+				   const TCellIndex iOpponent) {
+	if (DISTANCE_TERRITORIES == context->territoryMethod_) {
+		return context->voronoi_->computeByDistance(*context->openCells_, iMe, iOpponent);
+	}
+
+	return context->voronoi_->compute(*context->openCells_, iMe, iOpponent);
+}
+
+/**
+ * GetCellBalance() with the chambers split by articulation points:
+ * each bot fills the best path through the chambers of its own
+ * territory.  The neutral cells count for nobody.
+ */
+static CellBalance GetArticulationCellBalance(ScoringContext* context,
+				   const TCell* cCells,
+				   const TCellIndex iMe,
+				   const TCellIndex iOpponent) {
+	Voronoi* voronoi = context->voronoi_;
+	ArticulationChambers* chambers = context->articulationChambers_;
+
+	context->openCells_->copyCells(cCells);
+	CellBalance balance = SplitTerritories(context, iMe, iOpponent);
+
+	const int myFill = chambers->build(voronoi->getMyTerritory(), iMe);
+	const int opponentFill = chambers->build(voronoi->getOpponentTerritory(), iOpponent);
+	balance.score = static_cast<TMoveScore>(myFill - opponentFill);
+	return balance;
+}
+
+/**
+ * Flags for a step from a cell into its neighbour, used in the
+ * bottleneck test of GetCellBalance().  They only depend on the walls
+ * around the two cells, so GetCellBalances() works them out once
+ * for all pairs of moves.
+ */
+const unsigned char BOTTLENECK_STEP = 1;	//The neighbour is past a bottleneck.
+const unsigned char CORRIDOR_STEP = 2;		//...which is in a corridor.
+const unsigned char STEP_FLAGS = 3;
+const unsigned char UNKNOWN_STEP_FLAGS = 255;	//Not worked out yet.
+
+static unsigned char GetStepFlags(const TCell* cCells, const TCellIndex iCell, const int direction) {
+	const TCellIndex iNeighbour = GetNeighbour(iCell, direction);
+	const TCellIndex left = GetNeighbour(0, (direction + 2)%4 + 1);
+	const TCellIndex right = -left;
+	
+	const TCell cLeftOfThis = cCells[iCell + left];
+	const TCell cLeftOfNeighbour = cCells[iNeighbour + left];
+	const TCell cRightOfThis = cCells[iCell + right];
+	const TCell cRightOfNeighbour = cCells[iNeighbour + right];
+	const bool isABottleNeck = !((cLeftOfThis && cLeftOfNeighbour) || (cRightOfThis && cRightOfNeighbour));
+
+	if (!isABottleNeck) {
+		return 0;
+	}
+
+	//Check whether we're inside a corridor.
+	//Count the number of neighbour's neighbours.
+	int numNeighbourNeighbours = 1;
+	if (cLeftOfNeighbour) numNeighbourNeighbours++;
+	if (cRightOfNeighbour) numNeighbourNeighbours++;
+	const TCellIndex iFrontOfNeighbour = GetNeighbour(iNeighbour, direction);
+	if (cCells[iFrontOfNeighbour]) numNeighbourNeighbours++;
+
+	//Count the number of current cell's neighbours
+	int numThisNeighbours = 1;
+	if (cLeftOfThis) numThisNeighbours++;
+	if (cRightOfThis) numThisNeighbours++;
+	const TCellIndex iBackOfThis = iCell - (iFrontOfNeighbour - iNeighbour);
+	if (cCells[iBackOfThis]) numThisNeighbours++;
+
+	if (numThisNeighbours == 2 && numNeighbourNeighbours <= 2) {
+		return (BOTTLENECK_STEP | CORRIDOR_STEP);
+	}
+
+	return BOTTLENECK_STEP;
+}
+
+static CellBalance GetBottleneckCellBalance(ScoringContext* context,
+				   TCell* cCells, 
+				   TCellIndex iMe, 
+				   TCellIndex iOpponent, 
+				   TCellIndex iPrevMe,
+				   TCellIndex iPrevOpponent,
+				   unsigned char* stepFlags);
+
 /**
  * Calculate the score for a move.
  * 
  * The score for the move is
  * (#cells fillable by me) - (# cells fillable by opponent).
  */
-TMoveScore GetCellBalance(TCell* cCells, 
+CellBalance GetCellBalance(ScoringContext* context,
+				   TCell* cCells, 
 				   const TCellIndex iMe, 
 				   const TCellIndex iOpponent, 
 				   const TCellIndex iPrevMe,
 				   const TCellIndex iPrevOpponent,
 				   const bool useTreeBalance) {
-	TBranch* bCellBranches = g_bCellBranches;
+	if (!useTreeBalance) {
+		context->openCells_->copyCells(cCells);
+		return SplitTerritories(context, iMe, iOpponent);
+	}
+
+	if (ARTICULATION_CHAMBERS == context->chamberMethod_) {
+		return GetArticulationCellBalance(context, cCells, iMe, iOpponent);
+	}
+
+	return GetBottleneckCellBalance(context, cCells, iMe, iOpponent, iPrevMe, iPrevOpponent, NULL);
+}
+
+void GetCellBalances(ScoringContext* context,
+				   TCell* cCells,
+				   const TCellIndex iMe,
+				   const TCellIndex iOpponent,
+				   const bool* isPairNeeded,
+				   CellBalance* balances) {
+	TCellIndex iMyMoves[4];
+	TCellIndex iOpponentMoves[4];
+
+	for (int direction = 0; direction < 4; ++direction) {
+		iMyMoves[direction] = GetNeighbour(iMe, direction + 1);
+		iOpponentMoves[direction] = GetNeighbour(iOpponent, direction + 1);
+	}
+
+	//Settle the simple cases; the rest need the full calculation.
+	bool isFullPairNeeded[16];
+	bool isAnyFullPairNeeded = false;
+
+	for (int moveIndex = 0; moveIndex < 16; ++moveIndex) {
+		isFullPairNeeded[moveIndex] = false;
+
+		if (!isPairNeeded[moveIndex]) {
+			continue;
+		}
+
+		const TCellIndex iNewMe = iMyMoves[moveIndex % 4];
+		const TCellIndex iNewOpponent = iOpponentMoves[moveIndex / 4];
+		const bool myOpenSpace = (WALL != cCells[iNewMe]);
+		const bool opponentOpenSpace = (WALL != cCells[iNewOpponent]);
+		CellBalance& balance = balances[moveIndex];
+		balance.areSeparated = true;
+		balance.distanceToOpponent = 0;
+
+		if (!opponentOpenSpace && !myOpenSpace) {
+			balance.score = 0;
+
+		} else if (!opponentOpenSpace) {
+			balance.score = VERY_GOOD;
+
+		} else if (!myOpenSpace) {
+			balance.score = VERY_BAD;
+
+		} else if (iNewMe == iNewOpponent) {
+			//The batch calculations need the positions to differ.
+			balance = GetCellBalance(context, cCells, iNewMe, iNewOpponent, iMe, iOpponent, true);
+		
+		} else {
+			isFullPairNeeded[moveIndex] = true;
+			isAnyFullPairNeeded = true;
+		}
+	}
+
+	if (!isAnyFullPairNeeded) {
+		return;
+	}
+
+	if (ARTICULATION_CHAMBERS == context->chamberMethod_) {
+		Voronoi* voronoi = context->voronoi_;
+		ArticulationChambers* chambers = context->articulationChambers_;
+		context->openCells_->copyCells(cCells);
+
+		//All my moves are of the same colour, and so are the opponent's;
+		//if the colours differ, the frontiers split the cells by distance.
+		const bool canSplitAllPairs = (DISTANCE_TERRITORIES == context->territoryMethod_
+			|| GetCellColor(iMe) != GetCellColor(iOpponent));
+
+		if (canSplitAllPairs) {
+			voronoi->computePairs(*context->openCells_, iMyMoves, iOpponentMoves, isFullPairNeeded, balances);
+		}
+
+		for (int moveIndex = 0; moveIndex < 16; ++moveIndex) {
+			if (!isFullPairNeeded[moveIndex]) {
+				continue;
+			}
+
+			const TCellIndex iNewMe = iMyMoves[moveIndex % 4];
+			const TCellIndex iNewOpponent = iOpponentMoves[moveIndex / 4];
+			int myFill = 0;
+			int opponentFill = 0;
+
+			if (canSplitAllPairs) {
+				myFill = chambers->build(voronoi->getMyPairTerritory(moveIndex), iNewMe);
+				opponentFill = chambers->build(voronoi->getOpponentPairTerritory(moveIndex), iNewOpponent);
+
+			} else {
+				balances[moveIndex] = SplitTerritories(context, iNewMe, iNewOpponent);
+				myFill = chambers->build(voronoi->getMyTerritory(), iNewMe);
+				opponentFill = chambers->build(voronoi->getOpponentTerritory(), iNewOpponent);
+			}
+
+			balances[moveIndex].score = static_cast<TMoveScore>(myFill - opponentFill);
+		}
+
+		return;
+	}
+
+	//Every pair crosses the same bottlenecks; they are worked
+	//out as the pairs get to them.
+	unsigned char* stepFlags = context->stepFlags_;
+
+	for (TCellIndex iCell = 0; iCell < context->iSize_; ++iCell) {
+		stepFlags[iCell] = UNKNOWN_STEP_FLAGS;
+	}
+
+	for (int moveIndex = 0; moveIndex < 16; ++moveIndex) {
+		if (isFullPairNeeded[moveIndex]) {
+			balances[moveIndex] = GetBottleneckCellBalance(context, cCells, iMyMoves[moveIndex % 4], 
+				iOpponentMoves[moveIndex / 4], iMe, iOpponent, stepFlags);
+		}
+	}
+}
+
+/**
+ * GetCellBalance() with the bottleneck test.
+ * @param stepFlags: GetStepFlags() for every cell and direction, two 
+ *	bits per direction, or UNKNOWN_STEP_FLAGS until they are needed;
+ *	NULL to work them out every time.
+ */
+static CellBalance GetBottleneckCellBalance(ScoringContext* context,
+				   TCell* cCells, 
+				   const TCellIndex iMe, 
+				   const TCellIndex iOpponent, 
+				   const TCellIndex iPrevMe,
+				   const TCellIndex iPrevOpponent,
+				   unsigned char* stepFlags) {
+	TBranch* bCellBranches = context->bCellBranches_;
 	
-	//if (g_bFirstBranch + g_iSize_ >= MAX_BRANCHES) {
-	//	g_bFirstBranch = 0;
+	//if (context->bFirstBranch_ + context->iSize_ >= MAX_BRANCHES) {
+	//	context->bFirstBranch_ = 0;
 		//Reset the connected squares grid, and the branch tracking grid.
-		for (int iCell = 0; iCell < g_iSize_; ++iCell) {
+		for (int iCell = 0; iCell < context->iSize_; ++iCell) {
 			bCellBranches[iCell] = NO_BRANCH;
 		}
 	//}
 
-	g_areBotsSeparated = true;
-	g_distanceFromOpponent = 0;
+	bool areBotsSeparated = true;
+	int distanceFromOpponent = 0;
 
 	//Find a better estimate of the areas under conrtol by each bot
 	//by examining the dead-end branches.
-	CellIndexQue* cellsToCheck = g_TempCellIndexQue;
-	TBranchSize* bsBranchSizes = g_bsBranchSizes;
-	TCellIndex* iBranchRoots = g_iBranchRoots;
-	bool* leafBranches = g_leafBranches;
-	bool* myBranches = g_myBranches;
+	CellIndexQue* cellsToCheck = context->cellIndexQue_;
+	TBranchSize* bsBranchSizes = context->bsBranchSizes_;
+	TBranchSize* bsBranchBlackCells = context->bsBranchBlackCells_;
+	TCellIndex* iBranchRoots = context->iBranchRoots_;
+	bool* leafBranches = context->leafBranches_;
+	bool* myBranches = context->myBranches_;
 
 	//Start out by crating base branches for my bot and the opponent's bot.
-	TBranch bNextNewBranch = g_bFirstBranch + 3;
-	const TBranch bNeutralBranch = g_bFirstBranch;
+	TBranch bNextNewBranch = context->bFirstBranch_ + 3;
+	const TBranch bNeutralBranch = context->bFirstBranch_;
 	const TBranch myBaseBranch = bNeutralBranch + 1;
 	const TBranch opponentBaseBranch = bNeutralBranch + 2;
 	leafBranches[bNeutralBranch] = false;
@@ -539,6 +811,8 @@ TMoveScore GetCellBalance(TCell* cCells,
 	iBranchRoots[opponentBaseBranch] = iPrevOpponent;
 	bsBranchSizes[myBaseBranch] = 0;
 	bsBranchSizes[opponentBaseBranch] = 0;
+	bsBranchBlackCells[myBaseBranch] = 0;
+	bsBranchBlackCells[opponentBaseBranch] = 0;
 	bCellBranches[iMe] = myBaseBranch | ODD_CLAIM | MY_CLAIM;
 	bCellBranches[iOpponent] = opponentBaseBranch | ODD_CLAIM | OPPONENT_CLAIM;
 
@@ -575,8 +849,12 @@ TMoveScore GetCellBalance(TCell* cCells,
 			bCellBranches[iCurrentCell] = bCurrentBranch;
 			bsBranchSizes[bCurrentBranch]++;
 
-			if ((wasOddClaim ^ isOddClaim) && g_areBotsSeparated) {
-				g_distanceFromOpponent += 2;
+			if (BLACK_COLOR == GetCellColor(iCurrentCell)) {
+				bsBranchBlackCells[bCurrentBranch]++;
+			}
+
+			if ((wasOddClaim ^ isOddClaim) && areBotsSeparated) {
+				distanceFromOpponent += 2;
 			}
 		}
 		
@@ -604,38 +882,29 @@ TMoveScore GetCellBalance(TCell* cCells,
 				//Noone claimed it yet.  Do so.  
 				//Check whether a new branch will need to be created.
 				//Check whether a bottleneck was encountered.
-				const TCellIndex left = GetNeighbour(0, (direction + 2)%4 + 1);
-				const TCellIndex right = -left;
+				unsigned char flags = 0;
+
+				if (NULL == stepFlags) {
+					flags = GetStepFlags(cCells, iCurrentCell, direction);
 				
-				const TCell cLeftOfThis = cCells[iCurrentCell + left];
-				const TCell cLeftOfNeighbour = cCells[iNeighbour + left];
-				const TCell cRightOfThis = cCells[iCurrentCell + right];
-				const TCell cRightOfNeighbour = cCells[iNeighbour + right];
-				const bool isABottleNeck = !((cLeftOfThis && cLeftOfNeighbour) || (cRightOfThis && cRightOfNeighbour));
-				bool isACorridor = false;
-
-				if (isABottleNeck) {
-					//Check whether we're inside a corridor.
-					//Count the number of neighbour's neighbours.
-					int numNeighbourNeighbours = 1;
-					if (cLeftOfNeighbour) numNeighbourNeighbours++;
-					if (cRightOfNeighbour) numNeighbourNeighbours++;
-					const TCellIndex iFrontOfNeighbour = GetNeighbour(iNeighbour, direction);
-					if (cCells[iFrontOfNeighbour]) numNeighbourNeighbours++;
-	
-					//Count the number of current cell's neighbours
-					int numThisNeighbours = 1;
-					if (cLeftOfThis) numThisNeighbours++;
-					if (cRightOfThis) numThisNeighbours++;
-					const TCellIndex iBackOfThis = iCurrentCell - (iFrontOfNeighbour - iNeighbour);
-					if (cCells[iBackOfThis]) numThisNeighbours++;
-
-					if (numThisNeighbours == 2 && numNeighbourNeighbours <= 2) {
-						isACorridor = true;
+				} else {
+					if (UNKNOWN_STEP_FLAGS == stepFlags[iCurrentCell]) {
+						stepFlags[iCurrentCell] = 0;
+
+						for (int flagsDirection = 1; flagsDirection <= 4; ++flagsDirection) {
+							if (cCells[GetNeighbour(iCurrentCell, flagsDirection)]) {
+								stepFlags[iCurrentCell] |= GetStepFlags(cCells, iCurrentCell, flagsDirection) 
+									<< (2 * (flagsDirection - 1));
+							}
+						}
 					}
 
+					flags = (stepFlags[iCurrentCell] >> (2 * (direction - 1))) & STEP_FLAGS;
 				}
 
+				const bool isABottleNeck = ((flags & BOTTLENECK_STEP) != 0);
+				const bool isACorridor = ((flags & CORRIDOR_STEP) != 0);
+
 				if (isABottleNeck && (!isACorridor || (iCurrentCell == (myBranch ? iMe : iOpponent)))) {
 					const TBranch bNewBranch = bNextNewBranch;
 					bNextNewBranch++;
@@ -644,6 +913,7 @@ TMoveScore GetCellBalance(TCell* cCells,
 					myBranches[bNewBranch] = myBranch;
 					iBranchRoots[bNewBranch] = iCurrentCell;
 					bsBranchSizes[bNewBranch] = 0;
+					bsBranchBlackCells[bNewBranch] = 0;
 					bCellBranches[iNeighbour] = (bNewBranch | bCurrentBotClaim | bNextClaimFlavour);
 				
 				} else {
@@ -659,7 +929,7 @@ TMoveScore GetCellBalance(TCell* cCells,
 			
 			} else if (bNeighbourBranch & bOtherBotClaim) {
 				//Other bot has claimed this cell.  
-				g_areBotsSeparated = false;
+				areBotsSeparated = false;
 
 				//Check whether the other bot's claim is odd or even.  
 				//Odd cells cannot neutralize even claims, and vice versa.
@@ -703,8 +973,8 @@ TMoveScore GetCellBalance(TCell* cCells,
 					//current branch, then the branches need to be
 					//merged.
 					if (iNeighbour != iBranchRoots[bCurrentBranch]) {
-						bCurrentBranch = MergeBranches(iBranchRoots, bCellBranches, 
-							bsBranchSizes, cCells, leafBranches, bNextNewBranch, iCurrentCell, iNeighbour, bNeutralBranch);
+						bCurrentBranch = MergeBranches(context, cCells, bNextNewBranch, 
+							iCurrentCell, iNeighbour, bNeutralBranch);
 					}
 				}
 			}
@@ -714,9 +984,12 @@ TMoveScore GetCellBalance(TCell* cCells,
 	//Calculate max fillable space by each of the bots.
 	//Calculate fillable area for each branch by starting with the leaf
 	//branches and going up to the base branch, adding up the branch
-	//sizes.
+	//sizes.  A path can't fill more of a branch, or of all the branches
+	//on the way to the leaf, than the colours of their cells allow.
 	TBranchSize myMaxPath = 0;
 	TBranchSize opponentMaxPath = 0;
+	const TColor myColor = GetCellColor(iMe);
+	const TColor opponentColor = GetCellColor(iOpponent);
 
 	for (TBranch bLeafBranch = (bNeutralBranch + 1); bLeafBranch < bNextNewBranch; ++bLeafBranch) {
 		if (!leafBranches[bLeafBranch]) {
@@ -724,13 +997,33 @@ TMoveScore GetCellBalance(TCell* cCells,
 		}
 		
 		TBranchSize bsPathSize = 0;
+		int numPathCells = 0;
+		int numPathBlackCells = 0;
 		TBranch bBranch = bLeafBranch;
 
 		while(NO_BRANCH != bBranch) {
-			bsPathSize += bsBranchSizes[bBranch];
+			//Other than the base branches, a branch is entered from 
+			//its root, which is in the parent branch.
+			TColor startColor = (myBranches[bBranch] ? myColor : opponentColor);
+			
+			if (bBranch != myBaseBranch && bBranch != opponentBaseBranch) {
+				startColor = (BLACK_COLOR == GetCellColor(iBranchRoots[bBranch]) ? RED_COLOR : BLACK_COLOR);
+			}
+
+			bsPathSize += static_cast<TBranchSize>(GetParityBound(bsBranchSizes[bBranch], 
+				bsBranchBlackCells[bBranch], startColor));
+			numPathCells += bsBranchSizes[bBranch];
+			numPathBlackCells += bsBranchBlackCells[bBranch];
 			bBranch = GetParentBranch(bBranch, bCellBranches, iBranchRoots);
 		}
 
+		const int pathBound = GetParityBound(numPathCells, numPathBlackCells, 
+			(myBranches[bLeafBranch] ? myColor : opponentColor));
+
+		if (bsPathSize > pathBound) {
+			bsPathSize = static_cast<TBranchSize>(pathBound);
+		}
+
 		if (myBranches[bLeafBranch]) {
 			if (myMaxPath < bsPathSize) {
 				myMaxPath = bsPathSize;
@@ -743,25 +1036,15 @@ TMoveScore GetCellBalance(TCell* cCells,
 		}
 	}
 
-	//g_bFirstBranch = bNextNewBranch;
+	//context->bFirstBranch_ = bNextNewBranch;
 
-	const TMoveScore cellBalance = static_cast<TMoveScore>(myMaxPath - opponentMaxPath);
+	CellBalance cellBalance;
+	cellBalance.score = static_cast<TMoveScore>(myMaxPath - opponentMaxPath);
+	cellBalance.areSeparated = areBotsSeparated;
+	cellBalance.distanceToOpponent = distanceFromOpponent;
 	return cellBalance;
 }
 
-/**
- * Check whether the bots were separated during the previous 
- * evaluation, i.e. whether one bot could not possibly have entered
- * territory of another bot.
- */
-bool WereBotsSeparated() {
-	return g_areBotsSeparated;
-}
-
-int LastDistanceToOpponent() {
-	return g_distanceFromOpponent;
-}
-
 void ForceBreak() {
 	int* bad;
 	bad = (int*) 10;
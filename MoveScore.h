@@ -120,43 +120,160 @@ const TColor MY_COLOR_CLAIM = 4;
 const TColor OP_COLOR_CLAIM = 8;
 const TColor NEUTRAL_COLOR = 16;
 
+/**
+ * Colour of the cell if the map were a checkerboard: BLACK_COLOR
+ * or RED_COLOR.  A path alternates between the two.
+ */
+TColor GetCellColor(TCellIndex iCell);
+
+/**
+ * Most cells a path can visit in an area, counting the first one:
+ * it can't have more than one extra cell of the colour it starts on
+ * (see README.txt, section [4]).
+ * @param numBlackCells: number of the area's cells that are black.
+ * @param startColor: colour of the first cell on the path.
+ */
+inline int GetParityBound(const int numCells, const int numBlackCells, const TColor startColor) {
+	const int numStartColorCells = (BLACK_COLOR == startColor ? numBlackCells : numCells - numBlackCells);
+	const int numOtherColorCells = numCells - numStartColorCells;
+
+	return (numStartColorCells > numOtherColorCells 
+		? 2 * numOtherColorCells + 1 : 2 * numStartColorCells);
+}
+
 inline TBranch GetParentBranch(const TBranch bBranch, TBranch* bCellBranches, TCellIndex* iBranchRoots) {
 	//Should return NO_BRANCH for the top branch, because the root
 	//of the top branch should be at an already occupied location.
 	return bCellBranches[iBranchRoots[bBranch]];
 }
 
+/* Calculating the move scores. */
+
+class CellIndexQue_;
+class BitBoard;
+class Voronoi;
+class ArticulationChambers;
+
+/**
+ * How GetCellBalance() splits the territories into chambers.
+ */
+enum TChamberMethod {
+	BOTTLENECK_CHAMBERS,	//Local bottleneck test, then merging (README.txt, section [3]).
+	ARTICULATION_CHAMBERS	//Articulation points (see Chambers.h).
+};
+
+/**
+ * How GetCellBalance() splits the cells between the bots without
+ * the tree balance, and with ARTICULATION_CHAMBERS.
+ */
+enum TTerritoryMethod {
+	FRONTIER_TERRITORIES,	//Frontiers grown from both bots, stopped by the neutral cells.
+	DISTANCE_TERRITORIES	//Whichever bot is closer, from each bot's own distances (see Voronoi.h).
+};
+
+/**
+ * Scratch space for calculating the move scores.  The scoring 
+ * functions keep no state of their own, so any number of them can
+ * run at the same time as long as each one has its own context
+ * (e.g. one context per thread).
+ */
+class ScoringContext {
+public:
+	ScoringContext(TCellIndex size);
+	~ScoringContext();
+
+	TCellIndex iSize_;
+
+	//Matrixes used in temp calculations.
+	bool* tempGrid_;
+	TColor* tempColorMatrix_;
+	short* tempIntMatrix1_;
+	short* tempIntMatrix2_;
+	CellIndexQue_* cellIndexQue_;
+
+	//Tree-of-chambers data.
+	TCellIndex* iBranchRoots_;
+	TBranchSize* bsBranchSizes_;
+	TBranchSize* bsBranchBlackCells_;	//Black cells among bsBranchSizes_.
+	TBranch* bCellBranches_;
+	bool* leafBranches_;
+	bool* myBranches_;
+	bool* visitedBranches_;		//Used in MergeBranches().
+	TBranch bFirstBranch_;
+
+	//Used in MergeBranches(), which runs many times per GetCellBalance().
+	TBranch* bMergePath1_;
+	TBranch* bMergePath2_;
+	TBranch* bBranchesToMerge_;
+	CellIndexQue_* mergeQue_;
+
+	unsigned char* stepFlags_;	//Bottleneck tests shared by GetCellBalances().
+
+	//Used when the tree balance is not needed.
+	BitBoard* openCells_;
+	Voronoi* voronoi_;
+
+	TChamberMethod chamberMethod_;
+	ArticulationChambers* articulationChambers_;
+	TTerritoryMethod territoryMethod_;
+
+private:
+	//Not copyable.
+	ScoringContext(const ScoringContext&);
+	ScoringContext& operator=(const ScoringContext&);
+};
+
+/**
+ * The result of GetCellBalance().
+ */
+struct CellBalance {
+	//(#cells fillable by me) - (# cells fillable by opponent).
+	TMoveScore score;
+
+	//Whether one bot could not possibly enter the territory 
+	//of the other bot.
+	bool areSeparated;
+
+	//Approximate distance (+/- 2 steps) to the opponent.  Is valid
+	//only if the bots aren't separated.
+	int distanceToOpponent;
+};
+
 /**
  * Merge two branches; return lowest common parent.
  */
-TBranch MergeBranches(TCellIndex* iBranchRoots,
-				   TBranch* bCellBranches,
-				   TBranchSize* bsBranchSizes,
+TBranch MergeBranches(ScoringContext* context,
 				   TCell* cCells,
-				   bool* leafBranches,
 				   TBranch bNumBranches,
 				   TCellIndex iBranchEnd1,
-				   TCellIndex iBranchEnd2);
-
-/* Calculating the move scores. */
+				   TCellIndex iBranchEnd2,
+				   TBranch bNeutralBranch);
 
 /**
- * Initialize the environment for calculating the move score.
+ * Initialize the environment for calculating the move score:
+ * remember the map dimensions, and create a scoring context.
+ * Additional contexts (e.g. for other threads) can be created
+ * with new ScoringContext(size) afterwards.
  */
-void InitMoveScoreCalculator(TCellIndex size, TCellIndex width);
+ScoringContext* InitMoveScoreCalculator(TCellIndex size, TCellIndex width);
 
 /**
  * Calculate distance to the opponent.
  */
-//short GetOpponentDistance(TCell* cCells, TCellIndex iMe, TCellIndex iOpponent);
+//short GetOpponentDistance(ScoringContext* context, TCell* cCells, TCellIndex iMe, TCellIndex iOpponent);
 
 /**
  * Calculate the score for a move using the tree-of-chambers method.
  * 
  * The score for the move is
  * (#cells fillable by me) - (# cells fillable by opponent).
+ *
+ * Without the tree balance, only counts the cells that each bot 
+ * reaches first (see Voronoi.h); both positions must be open.
+ * With ARTICULATION_CHAMBERS, the same must hold for the tree balance.
  */
-TMoveScore GetCellBalance(TCell* cCells, 
+CellBalance GetCellBalance(ScoringContext* context,
+				   TCell* cCells, 
 				   TCellIndex iMe, 
 				   TCellIndex iOpponent, 
 				   TCellIndex iPrevMe,
@@ -164,18 +281,21 @@ TMoveScore GetCellBalance(TCell* cCells,
 				   bool useTreeBalance);
 
 /**
- * Check whether the bots were separated during the previous 
- * evaluation of GetCellBalance, i.e. whether one bot could 
- * not possibly have entered territory of another bot.
+ * GetCellBalance() with the tree balance for the 16 pairs of moves
+ * from the positions, which must already be walls on the map.  The
+ * pairs are numbered (my direction - 1) + (opponent's direction - 1) * 4.
+ * Only the needed pairs are scored, in one go: the work that doesn't
+ * depend on the pair (the bottleneck tests, or the distances from each
+ * bot's moves with ARTICULATION_CHAMBERS) is done once for all of them.
+ * A pair where a bot runs into a wall scores VERY_BAD for that bot
+ * (0 if both do), and counts as separated.
  */
-bool WereBotsSeparated();
-
-/**
- * Get the approximate distance (+/- 2 steps) to the opponent
- * during the last invocation of GetCellBalance().  Is valid
- * only if the bots aren't separated.
- */
-int LastDistanceToOpponent();
+void GetCellBalances(ScoringContext* context,
+				   TCell* cCells,
+				   TCellIndex iMe,
+				   TCellIndex iOpponent,
+				   const bool* isPairNeeded,
+				   CellBalance* balances);
 
 /**
  * Attempt to calculate the longest possible path each of the 
@@ -4,13 +4,15 @@
  * The main entry point to the program.  No actual logic is kept here.
  * 
  * On every move, MakeMove sets timer, updates my/opponent's positions,
- * and then proceeds to run calculations until out of time.
+ * and then proceeds to run calculations until out of time.  After the
+ * move is sent, Ponder() keeps calculating until the next map arrives.
  *
  * Note TEST_ENVIRONMENT macro (defined in Timer.h) and ForceBreak()
  * (defined in MoveScore.h).
  */
 
 #include "Map.h"
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <deque>
@@ -18,7 +20,11 @@
 
 #include "MoveScore.h"
 #include "StepEvaluator.h"
+#include "MonteCarloSearch.h"
 #include "Timer.h"
+#include "TimeManager.h"
+#include "Watchdog.h"
+#include "Threads.h"
 
 #ifdef TEST_ENVIRONMENT
 #include <iostream>
@@ -27,6 +33,83 @@
 /* Global variables. */
 int gMoveNumber = 0;
 StepEvaluator* gStepEvaluator = NULL;
+MonteCarloSearch* gMonteCarloSearch = NULL;
+TimeManager gTimeManager;
+Watchdog gWatchdog;
+
+//Set when a map didn't parse and got a fallback move; the search's
+//copy of the map is out of date, and is set up anew from the next map.
+bool gHasMissedMap = false;
+
+//Pick the moves with Monte Carlo tree search (MonteCarloSearch.h)
+//instead of the step tree.
+const bool USE_MONTE_CARLO_SEARCH = false;
+
+//How the step tree's cell balances split the map into chambers and
+//territories (see MoveScore.h); tools/Bench.cc -c and -m compare them.
+const TChamberMethod CHAMBER_METHOD = BOTTLENECK_CHAMBERS;
+const TTerritoryMethod TERRITORY_METHOD = FRONTIER_TERRITORIES;
+
+//Seconds allowed for the first move and for the rest of the moves.
+const double FIRST_MOVE_TIME_LIMIT = 3.0;
+const double MOVE_TIME_LIMIT = 1.0;
+
+//Pondering stops when the next map arrives, not on time.
+const double PONDER_TIME_OUT = 3600;
+
+//Memory the step tree may take up, in megabytes.
+const int MEMORY_LIMIT = 256;
+
+//Change in x and y for each move, indexed by UP..LEFT.
+const int MOVE_DX[5] = { 0, 0, 1, 0, -1 };
+const int MOVE_DY[5] = { 0, -1, 0, 1, 0 };
+
+/**
+ * Search threads for the step tree: one per core, or as many as the
+ * TRONBOT_THREADS environment variable says, e.g. to play several games
+ * at a time in tools/Referee.cc.
+ */
+int GetNumSearchThreads() {
+	const char* numThreads = getenv("TRONBOT_THREADS");
+
+	if (NULL != numThreads && atoi(numThreads) > 0) {
+		return atoi(numThreads);
+	}
+
+	return GetNumProcessors();
+}
+
+/**
+ * The move the watchdog sends if the search runs out of time.
+ */
+int GetPublishedMove() {
+	return (USE_MONTE_CARLO_SEARCH ? gMonteCarloSearch->getPublishedMove()
+		: gStepEvaluator->getPublishedMove());
+}
+
+/**
+ * Any move from (x, y) that doesn't run into a wall on the map.
+ * Sent by the watchdog if the time runs out before the search is
+ * set up for the move, and instead of a move on a map that didn't parse.
+ * @param backMove: the move back to where I came from, which is a
+ *	wall by now but not on the map; 0 if there's none.
+ */
+int GetOpenMove(const Map& map, const int x, const int y, const int backMove) {
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		if (direction != backMove && !map.IsWall(x + MOVE_DX[direction], y + MOVE_DY[direction])) {
+			return direction;
+		}
+	}
+
+	return UP;
+}
+
+/**
+ * Lets the time manager check on the search every few milliseconds.
+ */
+bool IsTimeCheckDue() {
+	return gTimeManager.isCheckDue();
+}
 
 /**
  * The main movement logic function.
@@ -35,51 +118,177 @@ int MakeMove(const Map& map) {
 	//ForceBreak();
 	gMoveNumber++;
 
-	if (1 == gMoveNumber) {
-		SetTimeOut(2.8);
-		gStepEvaluator = new StepEvaluator();
-		gStepEvaluator->initialize(map);
+	//Setting up the search can take a while (e.g. freeing the discarded
+	//parts of the tree), so the watchdog guards it too.
+	gTimeManager.startMove(1 == gMoveNumber ? FIRST_MOVE_TIME_LIMIT : MOVE_TIME_LIMIT);
+	gWatchdog.arm(gTimeManager.getHardDeadline(), GetOpenMove(map, map.MyX(), map.MyY(), 0));
+
+	if (gHasMissedMap) {
+		delete gMonteCarloSearch;
+		delete gStepEvaluator;
+		gMonteCarloSearch = NULL;
+		gStepEvaluator = NULL;
+		gHasMissedMap = false;
+	}
+
+	if (NULL == gMonteCarloSearch && NULL == gStepEvaluator) {
+		if (USE_MONTE_CARLO_SEARCH) {
+			gMonteCarloSearch = new MonteCarloSearch();
+			gMonteCarloSearch->initialize(map);
+			gMonteCarloSearch->setMemoryLimit(MEMORY_LIMIT);
+
+		} else {
+			gStepEvaluator = new StepEvaluator();
+			gStepEvaluator->initialize(map);
+			gStepEvaluator->setChamberMethod(CHAMBER_METHOD);
+			gStepEvaluator->setTerritoryMethod(TERRITORY_METHOD);
+			gStepEvaluator->setMemoryLimit(MEMORY_LIMIT);
+			gStepEvaluator->setNumThreads(GetNumSearchThreads());
+		}
 	
 	} else {
-		SetTimeOut(0.8);
-		gStepEvaluator->updateMoves(map);
+		if (USE_MONTE_CARLO_SEARCH) {
+			gMonteCarloSearch->updateMoves(map);
+		} else {
+			gStepEvaluator->updateMoves(map);
+		}
 	}
 	
 #ifdef TEST_ENVIRONMENT
-	SetTimeOut(0.7);
+	gTimeManager.startMove(0.9);
 //	SetTimeOut(3600);
 #endif
+
+	gWatchdog.setSearchReady();
 	
 	//ForceBreak();
 
-	//Perform as many calculations as possible in the available time.
+	//Perform calculations until the time runs out, or the time
+	//manager decides the rest of the time isn't worth spending.
+	if (!USE_MONTE_CARLO_SEARCH) {
+		gStepEvaluator->setStopFunction(&IsTimeCheckDue);
+	}
+
 	while (!HasTimedOut()) {
-		const bool hasMoreWork = gStepEvaluator->performEvaluations();
+		const bool hasMoreWork = (USE_MONTE_CARLO_SEARCH ? gMonteCarloSearch->performIterations()
+			: gStepEvaluator->performParallelEvaluations());
 		
 		if (!hasMoreWork) {
 			break;
 		}
+
+		if (!USE_MONTE_CARLO_SEARCH && gTimeManager.isCheckDue()
+			&& gTimeManager.shouldStop(gStepEvaluator->getSearchProgress())) {
+			break;
+		}
+	}
+
+	if (USE_MONTE_CARLO_SEARCH) {
+#ifdef TEST_ENVIRONMENT
+		std::cerr << gMonteCarloSearch->getNumIterations() << " " << gMonteCarloSearch->getNumNodes();
+#endif
+		return gMonteCarloSearch->getBestMove();
 	}
 
+	gStepEvaluator->setStopFunction(NULL);
 	const int bestMove = gStepEvaluator->getBestMove();
 	
 	//if (gMoveNumber == 2) {
 	//	ForceBreak();
 	//}
 #ifdef TEST_ENVIRONMENT
-	std::cerr << gStepEvaluator->getMaxDepth() << " " << gStepEvaluator->getNumEvaluations();
+	std::cerr << gStepEvaluator->getMaxDepth() << " " << gStepEvaluator->getNumEvaluations()
+		<< " " << gStepEvaluator->getNumCacheHits() << "/" << gStepEvaluator->getNumCacheMisses()
+		<< " " << gStepEvaluator->getNumEvictedSteps();
 #endif
  
 
 	return bestMove;
 }
 
+/**
+ * Keep refining the tree of steps under my move while the opponent
+ * is thinking about its move.
+ */
+void Ponder(const int myMove) {
+	if (NULL != gMonteCarloSearch) {
+		gMonteCarloSearch->restrictMyMove(myMove);
+
+		SetTimeOut(PONDER_TIME_OUT);
+		gMonteCarloSearch->setStopFunction(&Map::IsInputPending);
+		gWatchdog.watchInput();
+
+		while (!Map::IsInputPending() && gMonteCarloSearch->performIterations()) {
+			//Keep playing games out until the map arrives.
+		}
+
+		gWatchdog.disarm();
+		gMonteCarloSearch->setStopFunction(NULL);
+		return;
+	}
+
+	if (NULL == gStepEvaluator) {
+		return;
+	}
+
+	gStepEvaluator->restrictMyMove(myMove);
+
+	SetTimeOut(PONDER_TIME_OUT);
+	gStepEvaluator->setStopFunction(&Map::IsInputPending);
+
+	//The stop function is only checked between evaluations; the
+	//watchdog also stops the playouts under way when the map arrives.
+	gWatchdog.watchInput();
+
+	while (!Map::IsInputPending()) {
+		const bool hasMoreWork = gStepEvaluator->performParallelEvaluations();
+		
+		if (!hasMoreWork) {
+			//Nothing to do but wait for the map.
+			break;
+		}
+	}
+
+	gWatchdog.disarm();
+	gStepEvaluator->setStopFunction(NULL);
+}
+
 // Ignore this function. It is just handling boring stuff for you, like
 // communicating with the Tron tournament engine.
 int main() {
+  gWatchdog.start(&GetPublishedMove);
+
+  //Sent if the next map doesn't parse: an open move from where my
+  //last move took me, on the last map that did.
+  int fallbackMove = UP;
+
   while (true) {
     Map map;
-    Map::MakeMove(MakeMove(map));
+
+    //Nothing sensible can be searched on a map that didn't parse, but
+    //a turn without a move loses the game.
+    if (!map.IsValid()) {
+      Map::MakeMove(fallbackMove);
+      gMoveNumber++;
+      gHasMissedMap = true;
+      continue;
+    }
+
+    int move = MakeMove(map);
+
+    //The watchdog may have sent a move already.
+    const int sentMove = gWatchdog.disarm();
+
+    if (0 != sentMove) {
+      move = sentMove;
+    } else {
+      Map::MakeMove(move);
+    }
+
+    fallbackMove = GetOpenMove(map, map.MyX() + MOVE_DX[move], map.MyY() + MOVE_DY[move],
+      (move + 1) % 4 + 1);
+
+    Ponder(move);
   }
   return 0;
 }
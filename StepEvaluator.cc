@@ -5,7 +5,8 @@
 #include <vector>
 #include <deque>
 #include <list>
-#include <bitset>
+#include <new>
+#include <algorithm>
 #include "Map.h"
 #include "StepEvaluator.h"
 #include "Timer.h"
@@ -15,13 +16,28 @@
 *****************************/
 StepEvaluator::StepEvaluator()
 : cCells_(NULL), iWidth_(0), iSize_(0), iMe_(0), iOpponent_(0), numCellsRemaining_(0), 
-rootStep_(NULL), evaluationQue_(), removedCellIndexes_(), removedCells_(), 
-branchingQue_(), maxDepth_(), currentDepth_(0), removedPathCells_(NULL), 
-removedPathCellIndexes_(NULL) {
+wallHash_(0), rootStep_(NULL), evaluationQue_(), stepPool_(this), transpositionTable_(), balanceCache_(), moveOrdering_(), endgameSolver_(), workers_(), workerThreads_(), treeLock_(),
+workAvailable_(), sessionChanged_(), activeQue_(NULL), stopFunction_(NULL), publishedMove_(UP), sessionNumber_(0), 
+numActiveWorkers_(0), numBusyWorkers_(0), isSessionStopped_(false), 
+hasRunOutOfWork_(false), isShuttingDown_(false), branchingQue_(), 
+numEvaluations_(0), numTranspositions_(0), numEvictedSteps_(0), maxDepth_(), 
+maxSteps_(0), evictionThreshold_(0), chamberMethod_(BOTTLENECK_CHAMBERS), territoryMethod_(FRONTIER_TERRITORIES), currentDepth_(0) {
 }
 
 StepEvaluator::~StepEvaluator() {
-	//No need to clean up, the program's done.
+	//No need to clean up the steps, the program's done.
+	//Do stop the worker threads though.
+	treeLock_.lock();
+	isShuttingDown_ = true;
+	sessionChanged_.broadcast();
+	treeLock_.unlock();
+
+	const int numThreads = static_cast<int>(workerThreads_.size());
+
+	for (int i = 0; i < numThreads; ++i) {
+		workerThreads_[i]->join();
+		delete workerThreads_[i];
+	}
 }
 
 void StepEvaluator::initialize(const Map& map) {
@@ -30,10 +46,15 @@ void StepEvaluator::initialize(const Map& map) {
 	iSize_ = iWidth_ * iHeight;
 
 	//Initialize the move score calculator.
-	InitMoveScoreCalculator(iSize_, iWidth_);
+	ScoringContext* scoringContext = InitMoveScoreCalculator(iSize_, iWidth_);
+	InitZobristKeys(iSize_);
+	moveOrdering_.initialize(iSize_);
+	endgameSolver_.initialize(iSize_, iWidth_);
 	
-	removedPathCells_ = new TCell[iSize_];
-	removedPathCellIndexes_ = new TCellIndex[iSize_];
+	//The main thread's worker.
+	EvaluationWorker* mainWorker = new EvaluationWorker(this, 0);
+	mainWorker->initialize(iSize_, iWidth_, scoringContext);
+	workers_.push_back(mainWorker);
 
 	//Initialize the edges per cell matrix.  Specifically,
 	//for every non-wall cell, count the number of non-wall neighbours.
@@ -44,7 +65,7 @@ void StepEvaluator::initialize(const Map& map) {
 		offset = y * iWidth_;
 
 		for (int x = 0; x < iWidth_; ++x) {
-			isWall[offset + x] = map.IsWall(x, y);
+			isWall[offset + x] = map.IsWallAt(offset + x);
 			
 			if(!isWall[offset + x]) {
 				numCellsRemaining_++;
@@ -82,6 +103,7 @@ void StepEvaluator::initialize(const Map& map) {
 	RemoveCell(cCells_, iMe_, iWidth_);
 	RemoveCell(cCells_, iOpponent_, iWidth_);
 	numCellsRemaining_ -= 2;
+	syncWorkerCells();
 	
 	//Initialize the first step.
 	rootStep_ = getStep();
@@ -92,6 +114,8 @@ void StepEvaluator::initialize(const Map& map) {
 	rootStep_->branch();
 
 	numEvaluations_ = 0;
+	this->updateEndgameSolver();
+	this->publishBestMove();
 }
 
 void StepEvaluator::updateMoves(const Map& map) {
@@ -135,15 +159,34 @@ void StepEvaluator::updateMoves(const Map& map) {
 	RemoveCell(cCells_, iNewMe, iWidth_);
 	RemoveCell(cCells_, iNewOpponent, iWidth_);
 	numCellsRemaining_ -= 2;
+	syncWorkerCells();
+
+	//The old positions are now walls.
+	wallHash_ ^= GetWallKey(iMe_) ^ GetWallKey(iOpponent_);
+	moveOrdering_.age();
 
 	iMe_ = iNewMe;
 	iOpponent_ = iNewOpponent;
 
 	numEvaluations_ = 0;
+	numTranspositions_ = 0;
+	numEvictedSteps_ = 0;
 	maxDepth_ = 0;
 
-	//Update the root step.
-	rootStep_ = rootStep_->advance(myDirection, opponentDirection);
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		workers_[i]->numCacheHits_ = 0;
+		workers_[i]->numCacheMisses_ = 0;
+	}
+
+	currentDepth_++;
+
+	//Update the root step.  The old root step is gone once 
+	//advance() is done with it.
+	Step* oldRootStep = rootStep_;
+	rootStep_ = NULL;
+	rootStep_ = oldRootStep->advance(myDirection, opponentDirection);
+	this->updateEndgameSolver();
+	this->publishBestMove();
 	
 	//Remove steps no longer under consideration from
 	//the evaluation que.
@@ -159,55 +202,326 @@ void StepEvaluator::updateMoves(const Map& map) {
 	//		evaluationQue_.erase(currentElement);
 	//	}
 	//}
-	
-	currentDepth_++;
 }
 
 bool StepEvaluator::performEvaluations() {
+	if (endgameSolver_.isActive()) {
+		const bool isSolved = endgameSolver_.solve(stopFunction_);
+		this->publishBestMove();
+		return !isSolved;
+	}
+
+	EvaluationWorker* worker = workers_[0];
+
 	//Get the next step from the que.
-	Step* step = NULL;
+	Step* step = takeStep(worker);
+
+	if (NULL == step) {
+		return false;
+	}
 	
+	prepareEvaluation(step, worker);
+
+	bool isDeadEnd = false;
+	const TMoveScore moveScore = evaluateStep(step, worker, &isDeadEnd);
+
+	finishEvaluation(step, worker, moveScore, isDeadEnd);
+
+	return true;
+}
+
+bool StepEvaluator::performParallelEvaluations() {
+	const int numWorkers = static_cast<int>(workers_.size());
+
+	if (numWorkers <= 1 || endgameSolver_.isActive()) {
+		return performEvaluations();
+	}
+
+	//Start a new session; this wakes up the worker threads.
+	treeLock_.lock();
+	isSessionStopped_ = shouldStop();
+	hasRunOutOfWork_ = false;
+	numBusyWorkers_ = 0;
+	numActiveWorkers_ = numWorkers - 1;
+	sessionNumber_++;
+	sessionChanged_.broadcast();
+	treeLock_.unlock();
+
+	//The main thread works too.
+	runWorker(workers_[0]);
+
+	//Wait for the other workers to finish their last evaluations.
+	MutexLock lock(treeLock_);
+
+	while (numActiveWorkers_ > 0) {
+		sessionChanged_.wait(treeLock_);
+	}
+
+	//Return the steps that were not evaluated to the shared que.
+	for (int i = 0; i < numWorkers; ++i) {
+		workers_[i]->getQue().moveTo(evaluationQue_);
+	}
+
+	return !hasRunOutOfWork_;
+}
+
+void StepEvaluator::restrictMyMove(const int move) {
+	MutexLock lock(treeLock_);
+
+	if (NULL != rootStep_) {
+		rootStep_->restrictToMyMove(move - 1);
+	}
+
+	if (endgameSolver_.isActive()) {
+		endgameSolver_.advance(GetNeighbour(iMe_, move));
+	}
+}
+
+void StepEvaluator::setNumThreads(int numThreads) {
+	if (numThreads > kMaxThreads) {
+		numThreads = kMaxThreads;
+	}
+
+	while (static_cast<int>(workers_.size()) < numThreads) {
+		EvaluationWorker* worker = new EvaluationWorker(this, static_cast<int>(workers_.size()));
+		worker->initialize(iSize_, iWidth_, new ScoringContext(iSize_));
+		worker->getScoringContext()->chamberMethod_ = chamberMethod_;
+		worker->getScoringContext()->territoryMethod_ = territoryMethod_;
+		worker->copyCells(cCells_);
+		
+		treeLock_.lock();
+		worker->lastSessionNumber_ = sessionNumber_;
+		treeLock_.unlock();
+
+		Thread* thread = new Thread();
+
+		if (!thread->start(&StepEvaluator::workerThreadMain, worker)) {
+			//Could not start any more threads; make do with what we have.
+			delete thread;
+			delete worker;
+			break;
+		}
+
+		workers_.push_back(worker);
+		workerThreads_.push_back(thread);
+	}
+}
+
+void* StepEvaluator::workerThreadMain(void* argument) {
+	EvaluationWorker* worker = static_cast<EvaluationWorker*>(argument);
+	StepEvaluator* stepEvaluator = worker->getStepEvaluator();
+
+	stepEvaluator->treeLock_.lock();
+
 	while (true) {
-		if (evaluationQue_.empty()) {
-			return false;
+		//Sleep until the next session starts.
+		while (worker->lastSessionNumber_ == stepEvaluator->sessionNumber_ 
+			&& !stepEvaluator->isShuttingDown_) {
+			stepEvaluator->sessionChanged_.wait(stepEvaluator->treeLock_);
 		}
 
-		step = evaluationQue_.front();
-		evaluationQue_.pop_front();
-		
-		//Check whether the step is no longer under consideration.
-		if (step->isInStepTree()) {
-			//Don't evaluate steps past certain depth.
-			if (step->getDepth() > this->currentDepth_ + kDepthLimit) {
-				//reappend the step back to the back of the que.
-				this->addStepToQue(step);
-				return true;
+		if (stepEvaluator->isShuttingDown_) {
+			break;
+		}
+
+		worker->lastSessionNumber_ = stepEvaluator->sessionNumber_;
+		stepEvaluator->treeLock_.unlock();
+
+		stepEvaluator->runWorker(worker);
+
+		stepEvaluator->treeLock_.lock();
+		stepEvaluator->numActiveWorkers_--;
+		stepEvaluator->sessionChanged_.broadcast();
+	}
+
+	stepEvaluator->treeLock_.unlock();
+	return NULL;
+}
+
+void StepEvaluator::runWorker(EvaluationWorker* worker) {
+	MutexLock lock(treeLock_);
+
+	while (!isSessionStopped_) {
+		Step* step = takeStep(worker);
+
+		if (NULL == step) {
+			if (0 == numBusyWorkers_) {
+				//Nobody is left who could create more work.
+				hasRunOutOfWork_ = true;
+				isSessionStopped_ = true;
+				workAvailable_.broadcast();
+			
 			} else {
-				//Evaluate this step.
-				break;
+				workAvailable_.wait(treeLock_);
 			}
+
+			continue;
+		}
+
+		prepareEvaluation(step, worker);
+		numBusyWorkers_++;
+
+		//The expensive part is done without holding the lock.
+		treeLock_.unlock();
+
+		bool isDeadEnd = false;
+		const TMoveScore moveScore = evaluateStep(step, worker, &isDeadEnd);
+
+		treeLock_.lock();
+		numBusyWorkers_--;
+
+		//Children created by this evaluation go into this worker's que.
+		activeQue_ = &worker->getQue();
+		finishEvaluation(step, worker, moveScore, isDeadEnd);
+		activeQue_ = NULL;
+
+		if (shouldStop()) {
+			isSessionStopped_ = true;
+		}
+
+		workAvailable_.broadcast();
+	}
+}
+
+Step* StepEvaluator::takeStep(EvaluationWorker* worker) {
+	const int numWorkers = static_cast<int>(workers_.size());
+
+	while (true) {
+		EvaluationQue* que = NULL;
+		EvaluationQue& ownQue = worker->getQue();
+
+		//Take from whichever of the own que and the shared que has
+		//the more urgent step.
+		if (!ownQue.empty() && ownQue.getTopPriority() <= evaluationQue_.getTopPriority()) {
+			que = &ownQue;
+		
+		} else if (!evaluationQue_.empty()) {
+			que = &evaluationQue_;
 		
 		} else {
+			//Steal the most urgent steps from the worker that has 
+			//the most work left.
+			int largestQueSize = 0;
+
+			for (int i = 0; i < numWorkers; ++i) {
+				EvaluationQue& otherQue = workers_[i]->getQue();
+
+				if (otherQue.size() > largestQueSize) {
+					largestQueSize = otherQue.size();
+					que = &otherQue;
+				}
+			}
+		}
+
+		if (NULL == que) {
+			return NULL;
+		}
+
+		int priority = 0;
+		Step* step = que->pop(&priority);
+			
+		//Check whether the step is no longer under consideration.
+		//A step that became the root step doesn't need a score.
+		//Steps that were cut off stay in the tree, and are placed
+		//back in the que if they are needed again.
+		if (!step->isInStepTree() || step->isRootStep() || step->isCutOff()) {
 			step->removeFromEvaluationQue();
-			step = NULL;
-			//Return because we don't want to spend too long working on this.
-			return true;
+			continue;
+		}
+
+		//The scores may have changed since the step was added; if the
+		//step is less urgent now, put it back.
+		const int currentPriority = getPriority(step);
+
+		if (currentPriority > priority) {
+			que->push(step, currentPriority);
+			continue;
 		}
+
+		//Don't evaluate steps past certain depth.
+		if (step->getDepth() > this->currentDepth_ + kDepthLimit) {
+			//reappend the step back to the back of the que.
+			que->push(step, priority);
+			return NULL;
+		}
+
+		return step;
 	}
+}
+
+void StepEvaluator::prepareEvaluation(Step* step, EvaluationWorker* worker) {
+	worker->iPrevMe_ = step->getPrevMyPosition();
+	worker->iPrevOpponent_ = step->getPrevOpponentPosition();
+	worker->wallHash_ = step->getWallHash();
+	worker->isFarFromOpponent_ = step->isFarFromOpponent();
+	worker->isSeparatedFromOpponent_ = step->isSeparatedFromOpponent();
+
+	//Walk up only until reaching an ancestor that's still applied
+	//to the worker's map.  A transposition reached through another
+	//parent has the same walls, so it's as good as the same ancestor.
+	std::vector<EvaluationWorker::AppliedStep>& appliedSteps = worker->appliedSteps_;
+	std::vector<EvaluationWorker::AppliedStep>& stepsToApply = worker->stepsToApply_;
+	const int numAppliedSteps = static_cast<int>(appliedSteps.size());
 	
+	stepsToApply.clear();
+	worker->numStepsToKeep_ = 0;
+
 	Step* parentStep = step->getParent();
 
 	while(NULL != parentStep) {
-		removedCellIndexes_.push_back(parentStep->getMyPosition());
-		removedCellIndexes_.push_back(parentStep->getOpponentPosition());
+		const int iLevel = parentStep->getDepth() - currentDepth_;
+
+		if (iLevel >= 0 && iLevel < numAppliedSteps
+			&& appliedSteps[iLevel].step == parentStep->getHandle()
+			&& appliedSteps[iLevel].serial == parentStep->getSerial()) {
+			
+			worker->numStepsToKeep_ = iLevel + 1;
+			break;
+		}
+
+		EvaluationWorker::AppliedStep appliedStep;
+		appliedStep.step = parentStep->getHandle();
+		appliedStep.serial = parentStep->getSerial();
+		appliedStep.iMe = parentStep->getMyPosition();
+		appliedStep.iOpponent = parentStep->getOpponentPosition();
+		appliedStep.cMe = WALL;
+		appliedStep.cOpponent = WALL;
+		stepsToApply.push_back(appliedStep);
 
 		parentStep = parentStep->getParent();
 	}
-	
-	const int numCellsRemoved = static_cast<int>(removedCellIndexes_.size());
 
-	for (int i = 0; i < numCellsRemoved; ++i) {
-		removedCells_.push_back(RemoveCell(cCells_, removedCellIndexes_[i], iWidth_));
+	//Apply from the top down.
+	std::reverse(stepsToApply.begin(), stepsToApply.end());
+}
+
+TMoveScore StepEvaluator::evaluateStep(Step* step, EvaluationWorker* worker, bool* isDeadEnd) {
+	TCell* cCells = worker->getCells();
+	BitBoard& board = worker->getBoard();
+	std::vector<EvaluationWorker::AppliedStep>& appliedSteps = worker->appliedSteps_;
+	std::vector<EvaluationWorker::AppliedStep>& stepsToApply = worker->stepsToApply_;
+
+	//Place back the cells of the ancestors that are not shared
+	//with the previous step, in the reverse order of removing them.
+	while (static_cast<int>(appliedSteps.size()) > worker->numStepsToKeep_) {
+		const EvaluationWorker::AppliedStep& appliedStep = appliedSteps.back();
+		AddCell(cCells, appliedStep.cOpponent, appliedStep.iOpponent, iWidth_);
+		board.setCell(appliedStep.iOpponent, WALL != appliedStep.cOpponent);
+		AddCell(cCells, appliedStep.cMe, appliedStep.iMe, iWidth_);
+		board.setCell(appliedStep.iMe, WALL != appliedStep.cMe);
+		appliedSteps.pop_back();
+	}
+
+	//Remove the cells of the new ancestors.
+	const int numStepsToApply = static_cast<int>(stepsToApply.size());
+
+	for (int i = 0; i < numStepsToApply; ++i) {
+		EvaluationWorker::AppliedStep appliedStep = stepsToApply[i];
+		appliedStep.cMe = RemoveCell(cCells, appliedStep.iMe, iWidth_);
+		appliedStep.cOpponent = RemoveCell(cCells, appliedStep.iOpponent, iWidth_);
+		board.removeCell(appliedStep.iMe);
+		board.removeCell(appliedStep.iOpponent);
+		appliedSteps.push_back(appliedStep);
 	}
 
 	//Evaluate the score for this move.
@@ -215,69 +529,320 @@ bool StepEvaluator::performEvaluations() {
 	const TCellIndex iOpponent = step->getOpponentPosition();
 
 	int moveScore = 0;
+	*isDeadEnd = false;
 
-	if (iMe == iOpponent || (!cCells_[iMe] && !cCells_[iOpponent])) {
+	const bool isMyCellOpen = board.isOpen(iMe);
+	const bool isOpponentCellOpen = board.isOpen(iOpponent);
+
+	if (iMe == iOpponent || (!isMyCellOpen && !isOpponentCellOpen)) {
 		moveScore = 0;
-		step->setDeadEnd(true);
+		*isDeadEnd = true;
 	
-	} else if (!cCells_[iMe]) {
+	} else if (!isMyCellOpen) {
 		moveScore = VERY_BAD;
-		step->setDeadEnd(true);
+		*isDeadEnd = true;
 
-	} else if (!cCells_[iOpponent]) {
+	} else if (!isOpponentCellOpen) {
 		moveScore = VERY_GOOD;
-		step->setDeadEnd(true);
+		*isDeadEnd = true;
 	
 	} else {
-		numEvaluations_++;
-		
-		//Step* parent = step->getParent();
-		//Step* parentParent = parent->getParent();
-
-		//if (parentParent 
-		//	&& iMe == 100 && iOpponent == 122
-		//	&& parent->getMyPosition() == 116 && parent->getOpponentPosition() == 123
-		//	&& parentParent->getMyPosition() == 132 && parentParent->getOpponentPosition() == 139) {
-		//		int x = 2;
-		//}
-
-		//Perform full evaluation.
-//		moveScore = GetCellBalance(cCells_, iMe, iOpponent, step->getPrevMyPosition(), step->getPrevOpponentPosition());
-//		moveScore = GetPathScore(cCells_, iMe, iOpponent, step->getPrevMyPosition(), step->getPrevOpponentPosition());
-		
-		//Check whether we should switch to a 'near' strategy.
-		//ForceBreak();
-		
-		//if (!step->isSeparatedFromOpponent() && step->isFarFromOpponent()) {
-		//	const short distanceToOpponent = 
-		//		GetOpponentDistance(cCells_, step->getMyPosition(), step->getOpponentPosition());
+		moveScore = this->calculatePathScore(step, worker);
+	}
 
-		//	if (distanceToOpponent < kMinFarDistance) {
-		//		step->setFarFromOpponent(false);
-		//	}
-		//}
+	//The ancestors' cells stay removed for the next evaluation.
+	return moveScore;
+}
 
-		moveScore = this->calculatePathScore(step);
+void StepEvaluator::finishEvaluation(Step* step, 
+									 EvaluationWorker* worker, 
+									 const TMoveScore moveScore, 
+									 const bool isDeadEnd) {
+	if (isDeadEnd) {
+		step->setDeadEnd(true);
+	
+	} else {
+		step->setSeparatedFromOpponent(worker->isSeparatedFromOpponent_);
+		step->setFarFromOpponent(worker->isFarFromOpponent_);
+		numEvaluations_++;
 	}
 
-	//Place the removed cells back in the reverse order of removing them.
-	for (int i = numCellsRemoved - 1; i >= 0; --i) {
-		AddCell(cCells_, removedCells_[i], removedCellIndexes_[i], iWidth_);
+	//Update the step state.
+	if (step->isInStepTree()) {
+		step->setScore(moveScore);
 	}
 
-	removedCells_.clear();
-	removedCellIndexes_.clear();
-
-	//Update the step state.
-	step->setScore(moveScore);
 	step->removeFromEvaluationQue();
 	
-	const int depth = numCellsRemoved / 2;
+	const int depth = step->getDepth() - currentDepth_;
 	if (depth > maxDepth_) {
 		maxDepth_ = depth - 1;
 	}
 
-	return true;
+	this->enforceMemoryLimit();
+}
+
+void StepEvaluator::setMemoryLimit(const int megabytes) {
+	MutexLock lock(treeLock_);
+
+	const double maxSteps = static_cast<double>(megabytes) * 1024 * 1024 / sizeof(Step);
+	maxSteps_ = (maxSteps < 0x7fffffff ? static_cast<int>(maxSteps) : 0x7fffffff);
+	evictionThreshold_ = maxSteps_;
+}
+
+void StepEvaluator::updateEndgameSolver() {
+	if (endgameSolver_.isActive()) {
+		endgameSolver_.advance(iMe_);
+		return;
+	}
+
+	//Once separated, the bots stay separated.  They are separated when
+	//no cell next to the opponent can be reached from my position;
+	//both positions are already walls on cCells_.
+	BitBoard open;
+	BitBoard area;
+	BitBoard scratch;
+	open.initialize(iSize_, iWidth_);
+	area.initialize(iSize_, iWidth_);
+	scratch.initialize(iSize_, iWidth_);
+	open.copyCells(cCells_);
+	open.countReachable(iMe_, &area, &scratch);
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		if (area.isOpen(GetNeighbour(iOpponent_, direction))) {
+			return;
+		}
+	}
+
+	endgameSolver_.start(cCells_, iMe_);
+}
+
+void StepEvaluator::setChamberMethod(const TChamberMethod chamberMethod) {
+	MutexLock lock(treeLock_);
+	chamberMethod_ = chamberMethod;
+
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		workers_[i]->getScoringContext()->chamberMethod_ = chamberMethod;
+	}
+}
+
+void StepEvaluator::setTerritoryMethod(const TTerritoryMethod territoryMethod) {
+	MutexLock lock(treeLock_);
+	territoryMethod_ = territoryMethod;
+
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		workers_[i]->getScoringContext()->territoryMethod_ = territoryMethod;
+	}
+}
+
+void StepEvaluator::enforceMemoryLimit() {
+	if (0 == maxSteps_) {
+		return;
+	}
+
+	const int numStepsInUse = stepPool_.getNumStepsInUse();
+
+	if (numStepsInUse < maxSteps_) {
+		evictionThreshold_ = maxSteps_;
+		return;
+	}
+
+	if (numStepsInUse < evictionThreshold_) {
+		return;
+	}
+
+	this->evictSteps();
+
+	//If not enough could be evicted, let the tree grow some more 
+	//before trying again.
+	const int lowWaterSteps = static_cast<int>(static_cast<double>(maxSteps_) * kLowWaterPercent / 100);
+	const int numStepsLeft = stepPool_.getNumStepsInUse();
+	
+	if (numStepsLeft > lowWaterSteps) {
+		evictionThreshold_ = numStepsLeft + (maxSteps_ - lowWaterSteps);
+	}
+}
+
+namespace {
+	//A step that can be evicted, and how urgent its subtree is.
+	struct EvictionCandidate {
+		EvictionCandidate(TStepHandle step, int priority)	: step(step), priority(priority) {}
+
+		//The least promising steps go first.
+		bool operator<(const EvictionCandidate& other) const	{ return (priority > other.priority);}
+
+		TStepHandle step;
+		int priority;
+	};
+
+	struct PendingStep {
+		PendingStep(Step* step, bool isOnPrincipalVariation, bool isParentOnPrincipalVariation) 
+			: step(step), isOnPrincipalVariation(isOnPrincipalVariation), 
+			isParentOnPrincipalVariation(isParentOnPrincipalVariation) {}
+
+		Step* step;
+		bool isOnPrincipalVariation;
+		bool isParentOnPrincipalVariation;
+	};
+}
+
+/**
+ * Walk the step tree, ranking the branched steps the way the
+ * evaluation que would rank them, and drop the children of the 
+ * least urgent ones.  The principal variation is never evicted.
+ */
+void StepEvaluator::evictSteps() {
+	if (NULL == rootStep_) {
+		return;
+	}
+
+	const int lowWaterSteps = static_cast<int>(static_cast<double>(maxSteps_) * kLowWaterPercent / 100);
+	std::vector<EvictionCandidate> candidates;
+	std::vector<bool> isVisited(stepPool_.getNumSteps(), false);
+	std::vector<PendingStep> pendingSteps;
+
+	pendingSteps.push_back(PendingStep(rootStep_, true, true));
+	isVisited[rootStep_->getHandle()] = true;
+
+	while (!pendingSteps.empty()) {
+		const PendingStep pending = pendingSteps.back();
+		pendingSteps.pop_back();
+
+		Step* step = pending.step;
+
+		if (!step->hasChildren()) {
+			continue;
+		}
+
+		if (!pending.isOnPrincipalVariation && step->hasScore()) {
+			candidates.push_back(EvictionCandidate(step->getHandle(), 
+				this->getPriority(step, pending.isParentOnPrincipalVariation)));
+		}
+
+		for (int childId = 0; childId < 16; ++childId) {
+			Step* childStep = step->getChild(childId);
+
+			if (NULL == childStep || isVisited[childStep->getHandle()]) {
+				continue;
+			}
+
+			isVisited[childStep->getHandle()] = true;
+			pendingSteps.push_back(PendingStep(childStep, 
+				pending.isOnPrincipalVariation && step->getBestChildId() == childId,
+				pending.isOnPrincipalVariation));
+		}
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end());
+
+	const int numCandidates = static_cast<int>(candidates.size());
+	const int numStepsBefore = stepPool_.getNumStepsInUse();
+
+	for (int i = 0; i < numCandidates && stepPool_.getNumStepsInUse() > lowWaterSteps; ++i) {
+		Step* step = stepPool_.get(candidates[i].step);
+
+		//May have gone with a subtree evicted earlier.
+		if (!step->isInStepTree()) {
+			continue;
+		}
+
+		step->removeChildren();
+	}
+
+	numEvictedSteps_ += numStepsBefore - stepPool_.getNumStepsInUse();
+}
+
+CellBalance StepEvaluator::getCachedCellBalance(EvaluationWorker* worker, 
+												 const THashKey wallHash, 
+												 TCell* cCells,
+												 const TCellIndex iMe, 
+												 const TCellIndex iOpponent, 
+												 const TCellIndex iPrevMe, 
+												 const TCellIndex iPrevOpponent) {
+	const THashKey key = CellBalanceCache::GetKey(wallHash, iMe, iOpponent, iPrevMe, iPrevOpponent);
+	CellBalance balance;
+
+	if (balanceCache_.find(key, &balance)) {
+		worker->numCacheHits_++;
+		return balance;
+	}
+
+	worker->numCacheMisses_++;
+	balance = GetCellBalance(worker->getScoringContext(), cCells, 
+		iMe, iOpponent, iPrevMe, iPrevOpponent, true /* use trees */);
+	balanceCache_.store(key, balance);
+
+	return balance;
+}
+
+void StepEvaluator::getCachedCellBalances(EvaluationWorker* worker, 
+										  const THashKey wallHash, 
+										  TCell* cCells,
+										  const TCellIndex iMe, 
+										  const TCellIndex iOpponent, 
+										  CellBalance* balances) {
+	THashKey keys[16];
+	bool isCacheable[16];
+	bool isPairNeeded[16];
+
+	for (int moveIndex = 0; moveIndex < 16; ++moveIndex) {
+		const TCellIndex iNewMe = GetNeighbour(iMe, moveIndex % 4 + 1);
+		const TCellIndex iNewOpponent = GetNeighbour(iOpponent, moveIndex / 4 + 1);
+
+		//The pairs that run into walls are not worth caching.
+		isCacheable[moveIndex] = (WALL != cCells[iNewMe] && WALL != cCells[iNewOpponent]);
+		isPairNeeded[moveIndex] = true;
+
+		if (!isCacheable[moveIndex]) {
+			continue;
+		}
+
+		keys[moveIndex] = CellBalanceCache::GetKey(wallHash, iNewMe, iNewOpponent, iMe, iOpponent);
+
+		if (balanceCache_.find(keys[moveIndex], &balances[moveIndex])) {
+			worker->numCacheHits_++;
+			isPairNeeded[moveIndex] = false;
+
+		} else {
+			worker->numCacheMisses_++;
+		}
+	}
+
+	GetCellBalances(worker->getScoringContext(), cCells, iMe, iOpponent, isPairNeeded, balances);
+
+	for (int moveIndex = 0; moveIndex < 16; ++moveIndex) {
+		if (isCacheable[moveIndex] && isPairNeeded[moveIndex]) {
+			balanceCache_.store(keys[moveIndex], balances[moveIndex]);
+		}
+	}
+}
+
+int StepEvaluator::getNumCacheHits() const {
+	int numHits = 0;
+
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		numHits += workers_[i]->numCacheHits_;
+	}
+
+	return numHits;
+}
+
+int StepEvaluator::getNumCacheMisses() const {
+	int numMisses = 0;
+
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		numMisses += workers_[i]->numCacheMisses_;
+	}
+
+	return numMisses;
+}
+
+void StepEvaluator::syncWorkerCells() {
+	const int numWorkers = static_cast<int>(workers_.size());
+
+	for (int i = 0; i < numWorkers; ++i) {
+		workers_[i]->copyCells(cCells_);
+	}
 }
 
 /**
@@ -285,31 +850,39 @@ bool StepEvaluator::performEvaluations() {
  * and see how the game will play out.  The score will depend
  * on the final outcome.
  */
-TMoveScore StepEvaluator::calculatePathScore(Step* step) {
+TMoveScore StepEvaluator::calculatePathScore(Step* step, EvaluationWorker* worker) {
 	//Assume that the step passed checks in evaluateStep().
+	TCell* cCells = worker->getCells();
+	BitBoard& board = worker->getBoard();
 	const TCellIndex iMe = step->getMyPosition();
 	const TCellIndex iOpponent = step->getOpponentPosition();
-	const TCellIndex iPrevMe = step->getPrevMyPosition();
-	const TCellIndex iPrevOpponent = step->getPrevOpponentPosition();
+	const TCellIndex iPrevMe = worker->iPrevMe_;
+	const TCellIndex iPrevOpponent = worker->iPrevOpponent_;
+
+	//Hash of the walls on the worker's map; kept up to date as the
+	//path is played out.
+	THashKey wallHash = worker->wallHash_;
 	
 	//ForceBreak();
 
 	//Find the move score for the current cells; 
 	//If they are separated already, return that move score.
-	TMoveScore basicMoveScore = GetCellBalance(cCells_, iMe, iOpponent, iPrevMe, iPrevOpponent, true /* use trees */);
-	bool areAlreadySeparated = WereBotsSeparated();
-	step->setSeparatedFromOpponent(areAlreadySeparated);
+	const CellBalance basicBalance = getCachedCellBalance(worker, wallHash, cCells, 
+		iMe, iOpponent, iPrevMe, iPrevOpponent);
+	TMoveScore basicMoveScore = basicBalance.score;
+	bool areAlreadySeparated = basicBalance.areSeparated;
+	worker->isSeparatedFromOpponent_ = areAlreadySeparated;
 
-	int distanceToOpponent = LastDistanceToOpponent();
-	bool isFar = ((distanceToOpponent > kMinFarDistance) && step->isFarFromOpponent());
-	step->setFarFromOpponent(isFar);
+	int distanceToOpponent = basicBalance.distanceToOpponent;
+	bool isFar = ((distanceToOpponent > kMinFarDistance) && worker->isFarFromOpponent_);
+	worker->isFarFromOpponent_ = isFar;
 
 	if (areAlreadySeparated || !isFar) {
 		return basicMoveScore;
 	}
 
-	TCell* cRemovedCells = removedPathCells_;
-	TCellIndex* iRemovedCellIndexes = removedPathCellIndexes_;
+	TCell* cRemovedCells = worker->removedPathCells_;
+	TCellIndex* iRemovedCellIndexes = worker->removedPathCellIndexes_;
 	int numCellsRemoved = 0;
 	
 	//ForceBreak();
@@ -321,6 +894,7 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 	
 	std::vector<bool> separated;		//Indicate which of the next moves will separate the bots.
 	std::vector<TMoveScore> moveScores; //Move scores for the next moves.
+	CellBalance balances[16];
 	
 	for (int i = 0; i < 16; ++i) {
 		separated.push_back(false);
@@ -345,33 +919,30 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 	do {
 		pathLength++;
 
-		const TCell cMyCell = cCells_[iMyPosition];
-		const TCell cOpponentCell = cCells_[iOpponentPosition];
+		const TCell cMyCell = cCells[iMyPosition];
+		const TCell cOpponentCell = cCells[iOpponentPosition];
+		const bool isMyCellOpen = board.isOpen(iMyPosition);
+		const bool isOpponentCellOpen = board.isOpen(iOpponentPosition);
 
-		if (iMyPosition == iOpponentPosition || (!cMyCell && !cOpponentCell)) {
+		if (iMyPosition == iOpponentPosition || (!isMyCellOpen && !isOpponentCellOpen)) {
 			pathEnded = true;
 			pathScore = 0;
 			wasDeadEnd = true;
 			break;
 		
-		} else if (!cMyCell) {
+		} else if (!isMyCellOpen) {
 			pathEnded = true;
 			pathScore = VERY_BAD;
 			wasDeadEnd = true;
 			break;
 
-		} else if (!cOpponentCell) {
+		} else if (!isOpponentCellOpen) {
 			pathEnded = true;
 			pathScore = VERY_GOOD;
 			wasDeadEnd = true;
 			break;
 		}
 		
-		//Reset the separation indicators.
-		for (int i = 0; i < 16; ++i) {
-			separated[i] = false;
-		}
-		
 		//Apply the current moves.
 		cRemovedCells[numCellsRemoved] = cMyCell;
 		iRemovedCellIndexes[numCellsRemoved] = iMyPosition;
@@ -380,49 +951,26 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 		iRemovedCellIndexes[numCellsRemoved] = iOpponentPosition;
 		numCellsRemoved++;
 
-		cCells_[iMyPosition] = WALL;
-		cCells_[iOpponentPosition] = WALL;
+		cCells[iMyPosition] = WALL;
+		cCells[iOpponentPosition] = WALL;
+		board.removeCell(iMyPosition);
+		board.removeCell(iOpponentPosition);
+		wallHash ^= GetWallKey(iMyPosition) ^ GetWallKey(iOpponentPosition);
 	
-		//Score the moves in each direction.
+		//Score the moves in each direction, all pairs at once.
 		//While we're doing that, figure out the scores in each direction
 		//for my bot.
+		getCachedCellBalances(worker, wallHash, cCells, iMyPosition, iOpponentPosition, balances);
 		TMoveScore myBestScore = VERY_BAD;
 
 		for (int myDirection = 0; myDirection < 4; ++myDirection) {
-			const TCellIndex iNewMe = GetNeighbour(iMyPosition, myDirection + 1);
-			const TCell myOpenSpace = cCells_[iNewMe];
 			TMoveScore myWorstScoreThisDirection = VERY_GOOD;
 
 			for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
 				const int moveIndex = myDirection + opponentDirection * 4;
-				TMoveScore thisMoveScore = 0;
-				
-				//Check simple cases.
-				const TCellIndex iNewOpponent = GetNeighbour(iOpponentPosition, opponentDirection + 1);
-				const TCell opponentOpenSpace = cCells_[iNewOpponent];
-
-				if (!opponentOpenSpace && !myOpenSpace) {
-					separated[moveIndex] = true;
-					thisMoveScore = 0;
-
-				} else if (!opponentOpenSpace) {
-					separated[moveIndex] = true;
-					thisMoveScore = VERY_GOOD;
-
-				} else if (!myOpenSpace) {
-					separated[moveIndex] = true;
-					thisMoveScore = VERY_BAD;
-				
-				} else {
-					//Do the full calculation.
-					
-					
-					thisMoveScore = GetCellBalance(cCells_, iNewMe, iNewOpponent, 
-						iMyPosition, iOpponentPosition, true /* use trees */);
-					separated[moveIndex] = WereBotsSeparated();
-				}
-
+				const TMoveScore thisMoveScore = balances[moveIndex].score;
 				moveScores[moveIndex] = thisMoveScore;
+				separated[moveIndex] = balances[moveIndex].areSeparated;
 
 				//Update my best mvoe score calculation.
 				if (myWorstScoreThisDirection > thisMoveScore) {
@@ -447,8 +995,8 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 				myBestDirection = myDirection;
 				numMyBestDirections++;
 
-				if (maxNeighbourEdges > GetEdgeCount(cCells_[GetNeighbour(iMyPosition, myDirection + 1)])) {
-					maxNeighbourEdges = GetEdgeCount(cCells_[GetNeighbour(iMyPosition, myDirection + 1)]);
+				if (maxNeighbourEdges > GetEdgeCount(cCells[GetNeighbour(iMyPosition, myDirection + 1)])) {
+					maxNeighbourEdges = GetEdgeCount(cCells[GetNeighbour(iMyPosition, myDirection + 1)]);
 				}
 			}
 		}
@@ -459,7 +1007,7 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 		if (numMyBestDirections > 1) {
 			for (int myDirection = 0; myDirection < 4; ++myDirection) {
 				if (myBestScore == myMoveScores[myDirection] 
-					&& maxNeighbourEdges == GetEdgeCount(cCells_[GetNeighbour(iMyPosition, myDirection + 1)])) {
+					&& maxNeighbourEdges == GetEdgeCount(cCells[GetNeighbour(iMyPosition, myDirection + 1)])) {
 					
 					myBestDirection = myDirection;
 					break;
@@ -499,8 +1047,8 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 				opponentBestDirection = direcion;
 				numOpponentBestDirections++;
 
-				if (maxNeighbourEdges > GetEdgeCount(cCells_[GetNeighbour(iOpponentPosition, direcion + 1)])) {
-					maxNeighbourEdges = GetEdgeCount(cCells_[GetNeighbour(iOpponentPosition, direcion + 1)]);
+				if (maxNeighbourEdges > GetEdgeCount(cCells[GetNeighbour(iOpponentPosition, direcion + 1)])) {
+					maxNeighbourEdges = GetEdgeCount(cCells[GetNeighbour(iOpponentPosition, direcion + 1)]);
 				}
 			}
 		}
@@ -511,7 +1059,7 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 		if (numOpponentBestDirections > 1) {
 			for (int direcion = 0; direcion < 4; ++direcion) {
 				if (opponentBestScore == opponentMoveScores[direcion] 
-					&& maxNeighbourEdges == GetEdgeCount(cCells_[GetNeighbour(iOpponentPosition, direcion + 1)])) {
+					&& maxNeighbourEdges == GetEdgeCount(cCells[GetNeighbour(iOpponentPosition, direcion + 1)])) {
 					
 					opponentBestDirection = direcion;
 					break;
@@ -536,14 +1084,15 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 	
 	//If a dead end was not reached, calculate the final path score.
 	//if (!wasDeadEnd) {
-	//	int pathScore = GetCellBalance(cCells_, iMyPosition, iOpponentPosition, 
+	//	int pathScore = GetCellBalance(cCells, iMyPosition, iOpponentPosition, 
 	//		iRemovedCellIndexes[numCellsRemoved - 1], iRemovedCellIndexes[numCellsRemoved - 2]);
 	//}
 	
 	//Put the removed cells back.
 	for (int i = (numCellsRemoved - 1); i >= 0; --i) {
 		TCell cRemovedCell = cRemovedCells[i];
-		cCells_[iRemovedCellIndexes[i]] = cRemovedCell;
+		cCells[iRemovedCellIndexes[i]] = cRemovedCell;
+		board.setCell(iRemovedCellIndexes[i], WALL != cRemovedCell);
 	}
 
 	return pathScore;
@@ -551,6 +1100,10 @@ TMoveScore StepEvaluator::calculatePathScore(Step* step) {
 
 
 int StepEvaluator::getBestMove() const {
+	if (endgameSolver_.isActive() && 0 != endgameSolver_.getBestMove()) {
+		return endgameSolver_.getBestMove();
+	}
+
 	if (NULL == rootStep_) {
 		return UP;
 	}
@@ -572,31 +1125,121 @@ int StepEvaluator::getBestMove() const {
 	return UP;
 }
 
+SearchProgress StepEvaluator::getSearchProgress() {
+	MutexLock lock(treeLock_);
+
+	SearchProgress progress;
+	progress.bestMove = getBestMove();
+	progress.numMoves = 0;
+	progress.rootScore = 0;
+	progress.margin = 0;
+	progress.numEvaluations = numEvaluations_;
+	progress.numCellsRemaining = numCellsRemaining_;
+
+	//The worst case of each of my moves that don't run into a wall.
+	TMoveScore bestScore = VERY_BAD - 1;
+	TMoveScore nextBestScore = VERY_BAD - 1;
+
+	for (int myDirection = 0; myDirection < 4; ++myDirection) {
+		if (!cCells_[GetNeighbour(iMe_, myDirection + 1)]) {
+			continue;
+		}
+
+		progress.numMoves++;
+
+		if (NULL == rootStep_ || !rootStep_->hasChildren()) {
+			continue;
+		}
+
+		TMoveScore worstScore = VERY_GOOD;
+
+		for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
+			const TMoveScore score = rootStep_->getChildScore(myDirection + opponentDirection * 4);
+
+			if (score < worstScore) {
+				worstScore = score;
+			}
+		}
+
+		if (worstScore > bestScore) {
+			nextBestScore = bestScore;
+			bestScore = worstScore;
+
+		} else if (worstScore > nextBestScore) {
+			nextBestScore = worstScore;
+		}
+	}
+
+	if (NULL != rootStep_ && rootStep_->hasScore()) {
+		progress.rootScore = rootStep_->getScore();
+	}
+
+	if (progress.numMoves > 1 && nextBestScore >= VERY_BAD) {
+		progress.margin = bestScore - nextBestScore;
+	}
+
+	return progress;
+}
+
 void StepEvaluator::addStepToQue(Step* step) {
-	//evaluationQue_.push_front(step);
-	evaluationQue_.push_back(step);
+	EvaluationQue* que = (NULL != activeQue_ ? activeQue_ : &evaluationQue_);
+	que->push(step, getPriority(step));
 	step->setPlacedInQue();
 }
 
+int StepEvaluator::getPriority(const Step* step) const {
+	const Step* parentStep = step->getParent();
+
+	//The root step is being replaced while updating the moves.
+	if (NULL == parentStep || NULL == rootStep_) {
+		return step->getDepth() - currentDepth_;
+	}
+
+	return this->getPriority(step, parentStep->isOnPrincipalVariation());
+}
+
+int StepEvaluator::getPriority(const Step* step, const bool isParentOnPrincipalVariation) const {
+	int priority = step->getDepth() - currentDepth_;
+	const Step* parentStep = step->getParent();
+
+	if (NULL == parentStep || NULL == rootStep_) {
+		return priority;
+	}
+
+	if (!isParentOnPrincipalVariation) {
+		priority += kOffPrincipalVariationPenalty;
+	}
+
+	int scoreMargin = parentStep->getScore() - rootStep_->getScore();
+
+	if (scoreMargin < 0) {
+		scoreMargin = -scoreMargin;
+	}
+
+	const int marginPenalty = scoreMargin / kScoreMarginPerPriority;
+	priority += (marginPenalty < kMaxScoreMarginPenalty ? marginPenalty : kMaxScoreMarginPenalty);
+
+	return priority;
+}
+
 void StepEvaluator::freeStep(Step* step) {
-	freeSteps_.push_back(step);
-//	delete step;
+	transpositionTable_.remove(step);
+	stepPool_.release(step);
 }
 
 Step* StepEvaluator::getStep() {
-	Step* step = NULL;
-	
-	if (freeSteps_.empty()) {
-		step = new Step(this);
-	
-	} else {
-		step = freeSteps_.front();
-		freeSteps_.pop_front();
-	}
+	return stepPool_.allocate();
+}
 
-//	Step* step = new Step(this);
+Step* StepEvaluator::findTransposition(const Step* step) {
+	Step* transposition = transpositionTable_.find(step->getHashKey(), 
+		step->getMyPosition(), step->getOpponentPosition(), step->getDepth());
 
-	return step;
+	if (NULL != transposition) {
+		numTranspositions_++;
+	}
+
+	return transposition;
 }
 
 bool StepEvaluator::preEvaluateStep(Step* step) {
@@ -626,16 +1269,55 @@ bool StepEvaluator::preEvaluateStep(Step* step) {
 	}
 }
 
+/*****************************
+    Class EvaluationWorker
+*****************************/
+EvaluationWorker::EvaluationWorker(StepEvaluator* stepEvaluator, int workerId)
+: iPrevMe_(0), iPrevOpponent_(0), wallHash_(0), isFarFromOpponent_(true), isSeparatedFromOpponent_(false),
+numCacheHits_(0), numCacheMisses_(0), 
+appliedSteps_(), numStepsToKeep_(0), stepsToApply_(),
+removedPathCells_(NULL), removedPathCellIndexes_(NULL), lastSessionNumber_(0),
+stepEvaluator_(stepEvaluator), workerId_(workerId), iSize_(0), cCells_(NULL), board_(), 
+scoringContext_(NULL), que_() {
+}
+
+EvaluationWorker::~EvaluationWorker() {
+	delete scoringContext_;
+	delete[] cCells_;
+	delete[] removedPathCells_;
+	delete[] removedPathCellIndexes_;
+}
+
+void EvaluationWorker::initialize(TCellIndex iSize, TCellIndex iWidth, ScoringContext* scoringContext) {
+	iSize_ = iSize;
+	scoringContext_ = scoringContext;
+	cCells_ = new TCell[iSize_];
+	board_.initialize(iSize, iWidth);
+	removedPathCells_ = new TCell[iSize_];
+	removedPathCellIndexes_ = new TCellIndex[iSize_];
+}
+
+void EvaluationWorker::copyCells(const TCell* cCells) {
+	for (TCellIndex cell = 0; cell < iSize_; ++cell) {
+		cCells_[cell] = cCells[cell];
+	}
+
+	board_.copyCells(cCells_);
+	appliedSteps_.clear();
+}
+
 /*****************************
     Class Step
 *****************************/
-Step::Step(StepEvaluator* stepEvaluator)
-:idInParent_(0), iMe_(0), iOpponent_(0), parent_(NULL),
-stepEvaluator_(stepEvaluator), score_(VERY_BAD), isDeadEnd_(false), 
+Step::Step(StepEvaluator* stepEvaluator, TStepHandle handle)
+:wallHash_(0), stepEvaluator_(stepEvaluator), otherParents_(NULL), 
+handle_(handle), serial_(0), parent_(NO_STEP), iMe_(0), iOpponent_(0), depth_(0), score_(VERY_BAD), 
+alpha_(NO_ALPHA), beta_(NO_BETA), evaluatedChildren_(0), cutChildren_(0), 
+childrenLeftToEvaluate_(0), idInParent_(0), bestChildId_(-1), myGoodMoves_(0), opponentGoodMoves_(0),
+hasScore_(false), isDeadEnd_(false), 
 isFarFromOpponent_(false), isSeparatedFromOpponent_(false),
 isInStepTree_(true), isInEvaluationQue_(false), hasChildren_(false), 
-children_(), childrenLeftToEvaluate_(0), childScores_(),
-hasBranchedChildren_(false), myGoodMoves_(), opponentGoodMoves_() {
+hasBranchedChildren_(false) {
 }
 
 void Step::initialize(TCellIndex iMe, 
@@ -645,31 +1327,41 @@ void Step::initialize(TCellIndex iMe,
 	idInParent_ = idInParent;
 	iMe_ = iMe;
 	iOpponent_ = iOpponent;
-	parent_ = parent;
+	parent_ = (NULL == parent ? NO_STEP : parent->handle_);
 	score_ = 0;
+
+	if (NULL != otherParents_) {
+		otherParents_->clear();
+	}
+
+	hasScore_ = false;
 	isDeadEnd_ = false;
 
+	//The parent's positions are walls by the time this step is made.
+	if (NULL != parent) {
+		wallHash_ = parent->wallHash_ ^ GetWallKey(parent->iMe_) ^ GetWallKey(parent->iOpponent_);
+	
+	} else {
+		wallHash_ = stepEvaluator_->getWallHash();
+	}
+
 	isInStepTree_ = true;
 	isInEvaluationQue_ = false;
 	
 	hasChildren_ = false;
-	
-	children_.clear();
-	if (children_.capacity() != 16) {
-		children_.reserve(16);
-	}
-	
-	childScores_.clear();
-	if (childScores_.capacity() != 16) {
-		children_.reserve(16);
-	}
 
 	childrenLeftToEvaluate_ = 0;
 	hasBranchedChildren_ = false;
+	bestChildId_ = -1;
+
+	alpha_ = NO_ALPHA;
+	beta_ = NO_BETA;
+	evaluatedChildren_ = 0;
+	cutChildren_ = 0;
 }
 
 Step::~Step() {
-	//Nothing left to clean up.
+	delete otherParents_;
 }
 
 /**
@@ -677,7 +1369,76 @@ Step::~Step() {
  */
 void Step::setScore(TMoveScore score) {
 	score_ = score;
-	parent_->updateChildStepScore(score, idInParent_);
+	hasScore_ = true;
+	this->notifyParents(score);
+}
+
+void Step::notifyParents(const TMoveScore score) {
+	if (NO_STEP == parent_) {
+		return;
+	}
+
+	if (!this->hasOtherParents()) {
+		this->getParent()->updateChildStepScore(score, idInParent_);
+		return;
+	}
+
+	//Notifying a parent can add or remove parents (e.g. the parent 
+	//prunes this step if it's a dead end), so work off a copy.
+	//The handles stay valid: the parents are freed only after 
+	//they've been unlinked from this step.
+	ParentList parents(*otherParents_);
+	parents.push_back(ParentLink(parent_, idInParent_));
+
+	const int numParents = static_cast<int>(parents.size());
+	StepPool& stepPool = stepEvaluator_->getStepPool();
+
+	for (int i = numParents - 1; i >= 0; --i) {
+		Step* parent = stepPool.get(parents[i].step);
+		const int idInParent = parents[i].idInParent;
+
+		if (parent->children_[idInParent] == handle_) {
+			parent->updateChildStepScore(score, idInParent);
+		}
+	}
+}
+
+void Step::addParent(Step* parent, const int idInParent) {
+	if (NULL == otherParents_) {
+		otherParents_ = new ParentList();
+	}
+
+	otherParents_->push_back(ParentLink(parent->handle_, idInParent));
+}
+
+void Step::removeParent(Step* parent, const int idInParent) {
+	if (parent_ == parent->handle_ && idInParent_ == idInParent) {
+		if (!this->hasOtherParents()) {
+			this->unlink();
+			return;
+		}
+
+		//Any of the other parents will do as the first one.
+		parent_ = otherParents_->back().step;
+		idInParent_ = otherParents_->back().idInParent;
+		otherParents_->pop_back();
+		return;
+	}
+
+	if (NULL == otherParents_) {
+		return;
+	}
+
+	const int numOtherParents = static_cast<int>(otherParents_->size());
+
+	for (int i = 0; i < numOtherParents; ++i) {
+		const ParentLink& link = (*otherParents_)[i];
+
+		if (link.step == parent->handle_ && link.idInParent == idInParent) {
+			otherParents_->erase(otherParents_->begin() + i);
+			return;
+		}
+	}
 }
 
 void Step::removeFromEvaluationQue() {
@@ -687,6 +1448,52 @@ void Step::removeFromEvaluationQue() {
 		stepEvaluator_->freeStep(this);
 	}
 }
+
+bool Step::isOnPrincipalVariation() const {
+	const Step* step = this;
+
+	while (NO_STEP != step->parent_) {
+		const Step* parent = step->getParent();
+
+		if (parent->bestChildId_ != step->idInParent_) {
+			return false;
+		}
+
+		step = parent;
+	}
+
+	return true;
+}
+
+bool Step::isCutOff() const {
+	if (NO_STEP == parent_ || !this->getParent()->isChildCutOff(idInParent_)) {
+		return false;
+	}
+
+	if (NULL == otherParents_) {
+		return true;
+	}
+
+	//A shared step is still needed while any of its parents needs it.
+	const int numOtherParents = static_cast<int>(otherParents_->size());
+	StepPool& stepPool = stepEvaluator_->getStepPool();
+
+	for (int i = 0; i < numOtherParents; ++i) {
+		const ParentLink& link = (*otherParents_)[i];
+
+		if (!stepPool.get(link.step)->isChildCutOff(link.idInParent)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Step::isChildCutOff(const int childId) const {
+	const unsigned short bit = static_cast<unsigned short>(1 << childId);
+	return ((cutChildren_ & bit) && !(evaluatedChildren_ & bit));
+}
+
 /** 
  * Me and opponent have made new moves.  Set the new
  * root of the tree of Step objects, and remove
@@ -697,8 +1504,8 @@ Step* Step::advance(const int myDirection, const int opponentDirection) {
 	
 	if (this != NULL && this->hasChildren_) {
 		const int newRootChildId = (myDirection + opponentDirection * 4);
-		newRootStep = children_[newRootChildId];
-		children_[newRootChildId] = NULL;
+		newRootStep = this->getChild(newRootChildId);
+		this->setChild(newRootChildId, NULL);
 		
 		this->unlink();
 	
@@ -707,18 +1514,27 @@ Step* Step::advance(const int myDirection, const int opponentDirection) {
 	}
 	
 	if (NULL != newRootStep) {
-		newRootStep->parent_ = NULL;
+		newRootStep->parent_ = NO_STEP;
+		
+		if (NULL != newRootStep->otherParents_) {
+			newRootStep->otherParents_->clear();
+		}
 		
 		//Make sure that the new root step has branched.
 		if (!newRootStep->hasChildren_) {
 			newRootStep->branch();
 		}
 
+		//The root step has no window; bring back everything 
+		//that the old window cut off.
+		newRootStep->resetWindow();
+
 	} else {
 		//Need to make a new root step.
 		newRootStep = stepEvaluator_->getStep();
 		newRootStep->initialize(stepEvaluator_->getMyPosition(), stepEvaluator_->getOpponentPosition(),
 			NULL /* parent */, 0 /* id in parent */);
+		newRootStep->setDepth(stepEvaluator_->getCurrentDepth());
 		newRootStep->branch();
 	}
 
@@ -860,6 +1676,31 @@ std::vector<bool> Step::getBestDirections() {
 	return availableDirections;
 }
 
+void Step::restrictToMyMove(const int myDirection) {
+	if (!hasChildren_) {
+		return;
+	}
+
+	for (int childId = 0; childId < 16; ++childId) {
+		if (childId % 4 == myDirection) {
+			continue;
+		}
+
+		//The other moves count as lost so that they never cut
+		//off anything in the remaining one.
+		Step* childStep = this->getChild(childId);
+		this->setChild(childId, NULL);
+		childScores_[childId] = VERY_BAD;
+		evaluatedChildren_ |= static_cast<unsigned short>(1 << childId);
+
+		if (NULL != childStep) {
+			childStep->removeParent(this, childId);
+		}
+	}
+
+	this->updateCutoffs();
+}
+
 /**
  * Make this Step object create child step objects, effectively
  * exploring this branch of Steps further.
@@ -869,73 +1710,122 @@ void Step::branch() {
 	//evaluation que.
 	hasChildren_ = true;
 
-	//children_.reserve(16);
-	//childScores_.reserve(16);
-
 	for (int childId = 0; childId < 16; ++childId) {
-		children_.push_back(NULL);
-		childScores_.push_back(VERY_BAD);
+		children_[childId] = NO_STEP;
+		childScores_[childId] = VERY_BAD;
 	}
 
 	childrenLeftToEvaluate_ = 0xffff;
+	evaluatedChildren_ = 0;
+	cutChildren_ = 0;
 
-	for (int myDirection = 0; myDirection < 4; ++myDirection) {
-		const int iNewMe = GetNeighbour(iMe_, myDirection + 1);
+	//Queue the most promising children first.
+	char childOrder[16];
+	stepEvaluator_->getMoveOrdering().getChildOrder(depth_, iMe_, iOpponent_, childOrder);
 
-		for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
-			//Create the step.
-			const int iNewOpponent = GetNeighbour(iOpponent_, opponentDirection + 1);
-			const int childId = myDirection + opponentDirection * 4;
-			
-			Step* childStep = stepEvaluator_->getStep();
-			childStep->initialize(iNewMe, iNewOpponent, this, childId);
-			childStep->setDepth(this->depth_ + 1);
-			childStep->setFarFromOpponent(isFarFromOpponent_);
-			childStep->setSeparatedFromOpponent(isSeparatedFromOpponent_);
-
-			if (iNewMe == 65 && iNewOpponent == 103) {
-				int x = 3;
-			}
+	for (int i = 0; i < 16; ++i) {
+		//Create the step.
+		const int childId = childOrder[i];
+		const int iNewMe = GetNeighbour(iMe_, childId % 4 + 1);
+		const int iNewOpponent = GetNeighbour(iOpponent_, childId / 4 + 1);
+		
+		Step* childStep = stepEvaluator_->getStep();
+		childStep->initialize(iNewMe, iNewOpponent, this, childId);
+		childStep->setDepth(this->depth_ + 1);
+		childStep->setFarFromOpponent(isFarFromOpponent_);
+		childStep->setSeparatedFromOpponent(isSeparatedFromOpponent_);
+
+		if (iNewMe == 65 && iNewOpponent == 103) {
+			int x = 3;
+		}
 
-			//See if the step can be easily scored; if not, 
-			//add it to the evaluation que.
-			const bool needsMoreWork = stepEvaluator_->preEvaluateStep(childStep);
+		//See if the step can be easily scored; if not, 
+		//add it to the evaluation que.
+		const bool needsMoreWork = stepEvaluator_->preEvaluateStep(childStep);
 
-			if (needsMoreWork) {
-				children_[childId] = childStep;
-				childScores_[childId] = VERY_BAD;
-				stepEvaluator_->addStepToQue(childStep);
+		//The same position may have been reached by a different
+		//order of moves; if so, share that step instead.
+		Step* transposition = (needsMoreWork ? stepEvaluator_->findTransposition(childStep) : NULL);
 
-			} else {
-				//Nothing else to evaluate, the child is a dead end.
-				children_[childId] = NULL;
-				childScores_[childId] = childStep->getScore();
-				stepEvaluator_->freeStep(childStep);
+		if (NULL != transposition) {
+			stepEvaluator_->freeStep(childStep);
+			
+			this->setChild(childId, transposition);
+			childScores_[childId] = VERY_BAD;
+			transposition->addParent(this, childId);
+
+			//The parents' windows can disagree.
+			transposition->resetWindow();
+
+			if (transposition->hasScore_) {
+				this->updateChildStepScore(transposition->score_, childId);
+			
+			} else if (!transposition->isInEvaluationQue()) {
+				//Was cut off by all of its other parents.
+				stepEvaluator_->addStepToQue(transposition);
 			}
+
+		} else if (needsMoreWork) {
+			this->setChild(childId, childStep);
+			childScores_[childId] = VERY_BAD;
+			stepEvaluator_->storeTransposition(childStep);
+			stepEvaluator_->addStepToQue(childStep);
+
+		} else {
+			//Nothing else to evaluate, the child is a dead end.
+			this->setChild(childId, NULL);
+			childScores_[childId] = childStep->getScore();
+			stepEvaluator_->freeStep(childStep);
 		}
 	}
+
+	//Cut off whatever the dead ends have already refuted,
+	//and pass the windows down to the new children.
+	this->updateCutoffs();
 }
 
 void Step::unlink() {
 	//Unlink all children.
 	if (hasChildren_) {
 		for (int childId = 0; childId < 16; ++childId) {
-			if (NULL != children_[childId]) {
-				children_[childId]->unlink();
+			if (NULL != this->getChild(childId)) {
+				this->getChild(childId)->removeParent(this, childId);
 			}
 		}
 	}
 	
-	//If the step is ready to be deleted, delete it;
-	//Otherwise, indicate that it's been unlinked.
-	if (isInEvaluationQue_) {
-		isInStepTree_ = false;
+	//Indicate that it's been unlinked; if the step 
+	//is ready to be deleted, delete it.
+	isInStepTree_ = false;
 
-	} else {
+	if (!isInEvaluationQue_) {
 		stepEvaluator_->freeStep(this);
 	}
 }
 
+void Step::removeChildren() {
+	if (!hasChildren_) {
+		return;
+	}
+
+	for (int childId = 0; childId < 16; ++childId) {
+		Step* childStep = this->getChild(childId);
+		children_[childId] = NO_STEP;
+
+		if (NULL != childStep) {
+			childStep->removeParent(this, childId);
+		}
+	}
+
+	//The score stays as it was backed up from the children.
+	hasChildren_ = false;
+	hasBranchedChildren_ = false;
+	childrenLeftToEvaluate_ = 0;
+	evaluatedChildren_ = 0;
+	cutChildren_ = 0;
+	bestChildId_ = -1;
+}
+
 /**
  * A way for child to notify the parent that it has a new move score.
  */
@@ -944,20 +1834,19 @@ void Step::updateChildStepScore(const TMoveScore score, const int childId) {
 	childScores_[childId] = score;
 	
 	//Update that this child no longer needs to be evaluated.
-	if (childrenLeftToEvaluate_) {
-		unsigned int bit = 1 << (childId);
-		unsigned int mask = ~bit;
-		childrenLeftToEvaluate_ &= mask;
-	}
+	evaluatedChildren_ |= static_cast<unsigned short>(1 << childId);
 
 	//Prune the dead ends to save space.
-	Step* reportingChild = children_[childId];
+	Step* reportingChild = this->getChild(childId);
 
 	if (NULL != reportingChild && reportingChild->isDeadEnd_) {
-		reportingChild->unlink();
-		children_[childId] = NULL;
+		this->setChild(childId, NULL);
+		reportingChild->removeParent(this, childId);
 	}
 
+	//See whether the new score refutes any of the siblings.
+	this->updateCutoffs();
+
 	//If all children have been scored, update the
 	//overall score for this step.
 	if (!childrenLeftToEvaluate_) {
@@ -971,27 +1860,39 @@ void Step::updateChildStepScore(const TMoveScore score, const int childId) {
 		//const TMoveScore bestScore = childScores_[interestingChildren_[0]];
 		
 		TMoveScore bestScore = VERY_BAD;
+		int bestChildId = 0;	//The opponent's best reply to my best move.
 		
 		for (int myDirection = 0; myDirection < 4; ++myDirection) {
 			TMoveScore worstScoreInThisDirection = VERY_GOOD;
+			int worstChildId = myDirection;
 
 			for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
 				const int childId = myDirection + opponentDirection * 4;
 
 				if (worstScoreInThisDirection > childScores_[childId]) {
 					worstScoreInThisDirection = childScores_[childId];
+					worstChildId = childId;
 				}
 			}
 
 			if (bestScore < worstScoreInThisDirection) {
 				bestScore = worstScoreInThisDirection;
+				bestChildId = worstChildId;
 			}
 		}
+
+		MoveOrdering& moveOrdering = stepEvaluator_->getMoveOrdering();
+
+		if (!hasBranchedChildren_ || bestScore != score_) {
+			moveOrdering.rewardBestMove(depth_, depth_ - stepEvaluator_->getCurrentDepth(), iMe_, bestChildId);
+		}
+
+		bestChildId_ = static_cast<char>(bestChildId);
 		
 		//If the new score is different from the old one,
 		//perform some updates.
 		if (bestScore != score_ && !isRootStep()) {
-			parent_->updateChildStepScore(bestScore, idInParent_);
+			this->notifyParents(bestScore);
 		}
 
 		//Pick children to branch.
@@ -1003,20 +1904,24 @@ void Step::updateChildStepScore(const TMoveScore score, const int childId) {
 			//Also, branch only the most interesting children - those that
 			//lead to the best moves.
 			//const int numInterestingChildren = static_cast<int>(interestingChildren_.size());
+			char childOrder[16];
+			moveOrdering.getChildOrder(depth_, iMe_, iOpponent_, childOrder);
 
-			for (int childId = 0; childId < 16; ++childId) {
+			for (int i = 0; i < 16; ++i) {
+				const int childId = childOrder[i];
 				const int myDirection = childId % 4;
 				const int opponentDirection = childId / 4;
 				
-				if (!myGoodMoves_[myDirection] || !opponentGoodMoves_[opponentDirection]) {
+				if (!this->isMyGoodMove(myDirection) || !this->isOpponentGoodMove(opponentDirection)) {
 					continue;
 				}
 
-				Step* childStep = children_[childId];
+				Step* childStep = this->getChild(childId);
 				
 				if (NULL != childStep 
 					&& !childStep->hasChildren_ 
 					&& !childStep->isDeadEnd_ 
+					&& !(cutChildren_ & (1 << childId))
 					/*&& (childScores_[childId] == bestScore)*/) {
 
 					childStep->branch();
@@ -1024,7 +1929,7 @@ void Step::updateChildStepScore(const TMoveScore score, const int childId) {
 			}
 			
 			//for (int childId = 0; childId < 16; ++childId) {
-			//	Step* childStep = children_[childId];
+			//	Step* childStep = this->getChild(childId);
 
 			//	if (NULL != childStep 
 			//		&& !childStep->hasChildren_ 
@@ -1037,9 +1942,225 @@ void Step::updateChildStepScore(const TMoveScore score, const int childId) {
 		}
 
 		score_ = bestScore;
+		hasScore_ = true;
+
+		//Let the watchdog know about the new decision.
+		if (isRootStep()) {
+			stepEvaluator_->publishBestMove();
+		}
+	}
+}
+
+/**
+ * Recalculate which children are cut off by the alpha-beta
+ * window, bring back the ones that no longer are, and pass
+ * the windows down to the children.
+ */
+void Step::updateCutoffs() {
+	if (!hasChildren_) {
+		return;
+	}
+
+	const bool isRoot = isRootStep();
+
+	//Find the worst score for each of my moves among the children 
+	//evaluated so far.  A move is complete if all of its
+	//children have been evaluated.
+	TMoveScore rowScores[4];
+	int rowRefutations[4];
+	bool isRowComplete[4];
+	int bestCompleteRow = -1;
+	TMoveScore bestCompleteRowScore = NO_ALPHA;
+
+	for (int myDirection = 0; myDirection < 4; ++myDirection) {
+		rowScores[myDirection] = NO_BETA;
+		rowRefutations[myDirection] = -1;
+		isRowComplete[myDirection] = true;
+
+		for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
+			const int childId = myDirection + opponentDirection * 4;
+
+			if (!(evaluatedChildren_ & (1 << childId))) {
+				isRowComplete[myDirection] = false;
+			
+			} else if (childScores_[childId] < rowScores[myDirection]) {
+				rowScores[myDirection] = childScores_[childId];
+				rowRefutations[myDirection] = childId;
+			}
+		}
+
+		if (isRowComplete[myDirection] && rowScores[myDirection] > bestCompleteRowScore) {
+			bestCompleteRow = myDirection;
+			bestCompleteRowScore = rowScores[myDirection];
+		}
+	}
+
+	//Figure out which children don't matter anymore.
+	unsigned short newCutChildren = 0;
+	const TMoveScore alpha = (alpha_ > bestCompleteRowScore ? alpha_ : bestCompleteRowScore);
+	const bool isBetaCutoff = (!isRoot && bestCompleteRow >= 0 && bestCompleteRowScore >= beta_);
+
+	if (isBetaCutoff) {
+		//One of my moves is good enough that the parent won't pick this
+		//step anyway; the rest of my moves don't matter.
+		for (int myDirection = 0; myDirection < 4; ++myDirection) {
+			if (myDirection != bestCompleteRow) {
+				newCutChildren |= (0x1111 << myDirection);
+			}
+		}
+
+	} else {
+		//My moves that are already known to be no better than alpha
+		//only need the refuting opponent's move explored.
+		//At the root, ties must be kept for getBestDirections().
+		for (int myDirection = 0; myDirection < 4; ++myDirection) {
+			if (myDirection == bestCompleteRow || rowRefutations[myDirection] < 0) {
+				continue;
+			}
+
+			const bool isRefuted = (isRoot ? (rowScores[myDirection] < alpha)
+				: (rowScores[myDirection] <= alpha));
+
+			if (isRefuted) {
+				newCutChildren |= (0x1111 << myDirection);
+				newCutChildren &= ~(1 << rowRefutations[myDirection]);
+			}
+		}
+	}
+
+	//Dead ends are gone already.
+	for (int childId = 0; childId < 16; ++childId) {
+		if (NULL == this->getChild(childId)) {
+			newCutChildren &= ~(1 << childId);
+		}
+	}
+
+	const unsigned short newlyCutChildren = newCutChildren & ~cutChildren_;
+	const unsigned short revivedChildren = cutChildren_ & ~newCutChildren;
+	cutChildren_ = newCutChildren;
+	childrenLeftToEvaluate_ = 0xffff & ~evaluatedChildren_ & ~cutChildren_;
+
+	//Remember the moves that caused the new cutoffs.
+	if (newlyCutChildren) {
+		MoveOrdering& moveOrdering = stepEvaluator_->getMoveOrdering();
+		const int relativeDepth = depth_ - stepEvaluator_->getCurrentDepth();
+
+		if (isBetaCutoff) {
+			moveOrdering.rewardBestMove(depth_, relativeDepth, iMe_, rowRefutations[bestCompleteRow]);
+		
+		} else {
+			for (int myDirection = 0; myDirection < 4; ++myDirection) {
+				if (newlyCutChildren & (0x1111 << myDirection)) {
+					moveOrdering.rewardRefutation(depth_, relativeDepth, iOpponent_, rowRefutations[myDirection]);
+				}
+			}
+		}
+	}
+
+	unsigned short childrenToBranch = 0;
+
+	for (int childId = 0; childId < 16; ++childId) {
+		const unsigned short bit = static_cast<unsigned short>(1 << childId);
+		const bool isEvaluated = ((evaluatedChildren_ & bit) != 0);
+
+		if ((newlyCutChildren & bit) && !isEvaluated) {
+			//Stands in for the missing score; doesn't lower the
+			//worst score of the refuted move.
+			childScores_[childId] = VERY_GOOD;
+		
+		} else if (revivedChildren & bit) {
+			Step* childStep = this->getChild(childId);
+
+			if (NULL == childStep) {
+				//Turned out to be a dead end while cut off.
+				continue;
+			
+			} else if (!isEvaluated) {
+				childScores_[childId] = VERY_BAD;
+
+				if (!childStep->isInEvaluationQue()) {
+					stepEvaluator_->addStepToQue(childStep);
+				}
+
+			} else if (hasBranchedChildren_ 
+				&& !childStep->hasChildren_ 
+				&& !childStep->isDeadEnd_
+				&& this->isMyGoodMove(childId % 4) 
+				&& this->isOpponentGoodMove(childId / 4)) {
+				
+				childrenToBranch |= bit;
+			}
+		}
+	}
+
+	//Pass the windows down.  Children whose windows widened may
+	//need to bring back their own children.
+	for (int childId = 0; childId < 16; ++childId) {
+		Step* childStep = this->getChild(childId);
+
+		if (NULL == childStep) {
+			continue;
+		}
+
+		//Shared children are searched with a full window.
+		if (childStep->hasOtherParents()) {
+			continue;
+		}
+
+		const int myDirection = childId % 4;
+		TMoveScore childAlpha = alpha_;
+		TMoveScore childBeta = beta_;
+
+		for (int otherDirection = 0; otherDirection < 4; ++otherDirection) {
+			if (otherDirection != myDirection 
+				&& isRowComplete[otherDirection] 
+				&& rowScores[otherDirection] > childAlpha) {
+				
+				childAlpha = rowScores[otherDirection];
+			}
+		}
+
+		for (int opponentDirection = 0; opponentDirection < 4; ++opponentDirection) {
+			const int siblingId = myDirection + opponentDirection * 4;
+
+			if (siblingId != childId 
+				&& (evaluatedChildren_ & (1 << siblingId)) 
+				&& childScores_[siblingId] < childBeta) {
+				
+				childBeta = childScores_[siblingId];
+			}
+		}
+
+		//Children of the root step must not fail low with a score 
+		//equal to alpha, otherwise it would look like a tie.
+		if (isRoot && childAlpha > NO_ALPHA) {
+			childAlpha--;
+		}
+
+		const bool hasWidened = (childAlpha < childStep->alpha_ || childBeta > childStep->beta_);
+		childStep->alpha_ = childAlpha;
+		childStep->beta_ = childBeta;
+
+		if (hasWidened && childStep->cutChildren_) {
+			childStep->updateCutoffs();
+		}
+	}
+
+	for (int childId = 0; childId < 16; ++childId) {
+		Step* childStep = this->getChild(childId);
+
+		if ((childrenToBranch & (1 << childId)) && NULL != childStep && !childStep->hasChildren_) {
+			childStep->branch();
+		}
 	}
 }
 
+void Step::resetWindow() {
+	alpha_ = NO_ALPHA;
+	beta_ = NO_BETA;
+	this->updateCutoffs();
+}
+
 /**
  * Order the moves from the most interesting to the
  * least interesting.
@@ -1053,7 +2174,7 @@ void Step::sortChildrenByInterest() {
 	//The most interesting children are the ones that
 	//contain the steps most likely to be made by me and
 	//opponent.
-	if (childScores_.empty()) {
+	if (!hasChildren_) {
 		return;
 	}
 	
@@ -1069,6 +2190,11 @@ void Step::sortChildrenByInterest() {
 			const int childId = myDirection + opponentDirection * 4;
 			const TMoveScore moveScore = childScores_[childId];
 
+			//Children that were cut off before being evaluated have no score.
+			if (!(evaluatedChildren_ & (1 << childId))) {
+				continue;
+			}
+
 			if (worstScoreThisDirection < moveScore) {
 				worstScoreThisDirection = moveScore;
 			}
@@ -1091,15 +2217,15 @@ void Step::sortChildrenByInterest() {
 				/ static_cast<float>(numCellsRemaining);
 			
 			if (scoreDifference < maxScoreDifference) {
-				opponentGoodMoves_[i] = true;
+				opponentGoodMoves_ |= static_cast<unsigned char>(1 << i);
 			} else {
-				opponentGoodMoves_[i] = false;
+				opponentGoodMoves_ &= static_cast<unsigned char>(~(1 << i));
 			}
 		} else {
 			if (opponentMoveScores[i] != VERY_BAD) {
-				opponentGoodMoves_[i] = true;
+				opponentGoodMoves_ |= static_cast<unsigned char>(1 << i);
 			} else {
-				opponentGoodMoves_[i] = false;
+				opponentGoodMoves_ &= static_cast<unsigned char>(~(1 << i));
 			}
 		}
 	}
@@ -1115,6 +2241,10 @@ void Step::sortChildrenByInterest() {
 			const int childId = myDirection + opponentDirection * 4;
 			const TMoveScore moveScore = childScores_[childId];
 
+			if (!(evaluatedChildren_ & (1 << childId))) {
+				continue;
+			}
+
 			if (worstScoreThisDirection < moveScore) {
 				worstScoreThisDirection = moveScore;
 			}
@@ -1135,17 +2265,69 @@ void Step::sortChildrenByInterest() {
 				/ static_cast<float>(numCellsRemaining);
 			
 			if (scoreDifference > minScoreDifference) {
-				myGoodMoves_[i] = true;
+				myGoodMoves_ |= static_cast<unsigned char>(1 << i);
 			} else {
-				myGoodMoves_[i] = false;
+				myGoodMoves_ &= static_cast<unsigned char>(~(1 << i));
 			}
 		} else {
 			if (myMoveScores[i] != VERY_BAD) {
-				myGoodMoves_[i] = true;
+				myGoodMoves_ |= static_cast<unsigned char>(1 << i);
 			} else {
-				myGoodMoves_[i] = false;
+				myGoodMoves_ &= static_cast<unsigned char>(~(1 << i));
 			}
 		}
 	}
 
-}
\ No newline at end of file
+}
+/*****************************
+    Class StepPool
+*****************************/
+StepPool::StepPool(StepEvaluator* stepEvaluator)
+: stepEvaluator_(stepEvaluator), slabs_(), freeSteps_(), nextSerial_(0) {
+}
+
+StepPool::~StepPool() {
+	const int numSlabs = static_cast<int>(slabs_.size());
+
+	for (int i = 0; i < numSlabs; ++i) {
+		for (TStepHandle iStep = 0; iStep < kSlabSize; ++iStep) {
+			slabs_[i][iStep].~Step();
+		}
+
+		operator delete(slabs_[i]);
+	}
+}
+
+Step* StepPool::allocate() {
+	if (freeSteps_.empty()) {
+		this->addSlab();
+	}
+
+	const TStepHandle handle = freeSteps_.back();
+	freeSteps_.pop_back();
+
+	Step* step = this->get(handle);
+	step->serial_ = ++nextSerial_;
+
+	return step;
+}
+
+void StepPool::release(Step* step) {
+	freeSteps_.push_back(step->getHandle());
+}
+
+void StepPool::addSlab() {
+	const TStepHandle firstHandle = static_cast<TStepHandle>(slabs_.size()) << kSlabBits;
+	Step* slab = static_cast<Step*>(operator new(kSlabSize * sizeof(Step)));
+
+	for (TStepHandle iStep = 0; iStep < kSlabSize; ++iStep) {
+		new (slab + iStep) Step(stepEvaluator_, firstHandle + iStep);
+	}
+
+	slabs_.push_back(slab);
+
+	//Hand out the lower handles first.
+	for (TStepHandle iStep = kSlabSize; iStep > 0; --iStep) {
+		freeSteps_.push_back(firstHandle + iStep - 1);
+	}
+}
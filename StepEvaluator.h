@@ -9,7 +9,10 @@
  * useful.
  *
  * Class StepEvaluator contains a queue of Step objects to be evaluated,
- * and a heap of recycled Step objects.  It also provides easier 
+ * and a heap of recycled Step objects.  The queue is ordered by
+ * priority (see EvaluationQue.h): steps that follow the principal
+ * variation, are close to the root, and whose parents' scores are close
+ * to the root's score are evaluated first.  It also provides easier 
  * outside access to the results computed by the tree of Steps.
  *
  * The tree of Steps is kept between MakeMove() invocations
@@ -31,33 +34,107 @@
  *		of the bots died; otherwise it was the territory score
  *		as mentioned above.  This method was named the 'Path'
  *		method of evaluation.
+ *
+ * The minimax over the 16 child steps (4 of my moves x 4 of the
+ * opponent's moves) is pruned alpha-beta style.  Every step carries
+ * a window (alpha, beta) derived from its parent: the parent only
+ * cares about the step's score if it falls inside the window.  Once
+ * one of my moves is refuted by some opponent's move (its score is
+ * at most alpha), the remaining children for that move are cut off:
+ * they are not evaluated and not branched.  The same happens to all
+ * other moves once one of my moves scores at least beta.  Since the
+ * scores keep changing as the tree gets deeper, cut off children are
+ * brought back when the window widens again.
+ *
+ * The same position can often be reached by several orders of moves.
+ * Steps are looked up in a transposition table when they are created
+ * (see TranspositionTable.h), so a step can have several parents, and
+ * the 'tree' is really a DAG.  A step with several parents reports its
+ * score to all of them, is only dropped once every parent has unlinked
+ * it, and is searched with a full window since its parents' windows
+ * can disagree.
+ *
+ * The children are queued for evaluation and branched in the order
+ * suggested by the killer and history heuristics (see MoveOrdering.h),
+ * which makes the cutoffs happen sooner.
+ *
+ * While the opponent is thinking about its move, the search goes on
+ * (pondering) under my move that's already been sent; see 
+ * StepEvaluator::restrictMyMove().  When the opponent's move arrives,
+ * updateMoves() advances the tree as usual and all of that work is kept.
+ *
+ * Steps live in slabs owned by the StepPool, and refer to their parents
+ * and children by 32-bit handles into the pool.  The children and their
+ * scores are stored inline in the step, so a step needs no other memory
+ * unless it has been shared by several parents.
+ *
+ * When the steps take up more memory than allowed, the subtrees
+ * that the evaluation que would get to last are evicted: their roots
+ * become leaves again, keeping the scores backed up from the children.
+ *
+ * Steps can be evaluated either one at a time on the main thread
+ * (StepEvaluator::performEvaluations()), or by several worker threads
+ * at once (StepEvaluator::performParallelEvaluations()).  Each
+ * EvaluationWorker keeps its own copy of the map and its own
+ * scratch arrays; only the manipulation of the Step tree and of the
+ * evaluation ques is serialized through StepEvaluator's tree lock.
+ * The worker's map keeps the walls of the last evaluated step's
+ * ancestors, and the next evaluation only places back and removes
+ * the cells where the two steps' ancestors differ.  Since the steps
+ * created by a worker go into its own que, consecutive steps mostly
+ * come from the same subtree.
  */
 
 #include "MoveScore.h"
+#include "Threads.h"
+#include "TranspositionTable.h"
+#include "CellBalanceCache.h"
+#include "MoveOrdering.h"
+#include "EvaluationQue.h"
+#include "BitBoard.h"
+#include "EndgameSolver.h"
+#include "TimeManager.h"
 #include <list>
 #include <deque>
-#include <bitset>
+#include <vector>
 
 #ifndef STEP_EVALUATOR_H_
 #define STEP_EVALUATOR_H_
 
 class Step;
 class StepEvaluator;
+class EvaluationWorker;
 class Map;
 
-//typedef std::list<Step*> EvaluationQue;
-typedef std::deque<Step*> EvaluationQue;
+//Steps refer to each other by their handles in the StepPool.
+typedef unsigned int TStepHandle;
+const TStepHandle NO_STEP = 0xffffffff;
+
+//Alpha-beta window bounds that don't cut anything off.
+const TMoveScore NO_ALPHA = VERY_BAD - 1;
+const TMoveScore NO_BETA = VERY_GOOD + 1;
 
 /**
  * A class that keeps track of the possible steps to be taken.
  */
 class Step {
 public:
-	Step(StepEvaluator* stepEvaluator);
+	Step(StepEvaluator* stepEvaluator, TStepHandle handle);
 	~Step();
 	void initialize(TCellIndex iMe, TCellIndex iOpponent, Step* parent, int idInParent);
 	
-	Step* getParent()				{ return parent_;}
+	Step* getParent() const;
+	TStepHandle getHandle() const		{ return handle_;}
+
+	//Tells apart the steps that have used the same handle.
+	unsigned int getSerial() const		{ return serial_;}
+
+	/**
+	 * Link another parent to the step; used when the parent reaches
+	 * this step's position through a different order of moves.
+	 */
+	void addParent(Step* parent, int idInParent);
+	bool hasOtherParents() const		{ return (NULL != otherParents_ && !otherParents_->empty());}
 	
 	bool isInStepTree() const			{ return isInStepTree_;}
 	bool isInEvaluationQue() const		{ return isInEvaluationQue_;}
@@ -68,15 +145,23 @@ public:
 	void setScore(TMoveScore score);
 	
 	TMoveScore getScore() const			{ return score_; }
+	bool hasScore() const				{ return hasScore_;}
 	
 	void setPlacedInQue()				{ isInEvaluationQue_ = true;}
 	void removeFromEvaluationQue();
+
+	/**
+	 * Indicates that the parent no longer needs this step to be
+	 * evaluated, because a sibling step has refuted it.
+	 */
+	bool isCutOff() const;
 	
 	/**
 	 * Indicates whether no further exploration of this branch of steps is
 	 * possible.  Occurs when one/both of the players run into a wall.
 	 */
 	void setDeadEnd(bool deadEnd)		{ isDeadEnd_ = deadEnd;}
+	bool isDeadEnd() const				{ return isDeadEnd_;}
 	
 	/** 
 	 * Me and opponent have made new moves.  Set the new
@@ -89,11 +174,30 @@ public:
 	 * Decides wich moves from the current position are acceptable.
 	 */
 	std::vector<bool> getBestDirections();
+
+	/**
+	 * Drop the children where I don't make the given move.
+	 * Used on the root step once the move has been made.
+	 */
+	void restrictToMyMove(int myDirection);
+
+	/**
+	 * Indicates that every step from the root to this one is
+	 * the best reply to the best move of its parent.
+	 */
+	bool isOnPrincipalVariation() const;
 	
 	TCellIndex getMyPosition() const			{return iMe_;}
 	TCellIndex getOpponentPosition() const		{return iOpponent_;}
-	TCellIndex getPrevMyPosition() const		{return parent_->iMe_;}
-	TCellIndex getPrevOpponentPosition() const	{return parent_->iOpponent_;}
+	TCellIndex getPrevMyPosition() const		{return getParent()->iMe_;}
+	TCellIndex getPrevOpponentPosition() const	{return getParent()->iOpponent_;}
+
+	/**
+	 * Zobrist hash of the position: the walls placed since the start 
+	 * of the game plus both positions.  See Zobrist.h.
+	 */
+	THashKey getHashKey() const					{return GetPositionKey(wallHash_, iMe_, iOpponent_);}
+	THashKey getWallHash() const				{return wallHash_;}
 	
 	//Switches for near/far/separated strategies.
 	bool isFarFromOpponent() const				{return isFarFromOpponent_;}
@@ -110,24 +214,82 @@ public:
 	/**
 	 * Indicates that this step is a root step.
 	 */
-	bool isRootStep() const						{return (parent_ == NULL);}
+	bool isRootStep() const						{return (parent_ == NO_STEP);}
+
+	bool hasChildren() const					{ return hasChildren_;}
+	Step* getChild(int childId) const;
 
-	bool hasChildren() const					{ return (children_.size() > 0);}
+	TMoveScore getChildScore(int childId) const	{ return childScores_[childId];}
+
+	//The opponent's best reply to my best move; -1 if not known.
+	int getBestChildId() const					{ return bestChildId_;}
+
+	/**
+	 * Drop all children, turning the step back into a leaf that
+	 * keeps its backed-up score.  Used to free memory.
+	 */
+	void removeChildren();
 
 	//Depth of this step, from the very first position (not from the current root step).
 	int getDepth() const						{ return depth_;}
 	void setDepth(int depth)					{ depth_ = depth;}
 private:
+	/**
+	 * Parent of a step other than the first one.
+	 */
+	struct ParentLink {
+		ParentLink(TStepHandle parent, int idInParent)	: step(parent), idInParent(static_cast<char>(idInParent)) {}
+
+		TStepHandle step;
+		char idInParent;
+	};
+
+	typedef std::vector<ParentLink> ParentList;
+
+	friend class StepPool;
+
+	void setChild(int childId, Step* childStep)		{ children_[childId] = (NULL == childStep ? NO_STEP : childStep->handle_);}
+
+	bool isMyGoodMove(int direction) const			{ return ((myGoodMoves_ & (1 << direction)) != 0);}
+	bool isOpponentGoodMove(int direction) const	{ return ((opponentGoodMoves_ & (1 << direction)) != 0);}
 	
 	/**
 	 * Unlink this step from the step tree.
 	 */
 	void unlink();
+
+	/**
+	 * The parent no longer links to this step.  Unlinks the step
+	 * if no parents are left.
+	 */
+	void removeParent(Step* parent, int idInParent);
+
+	/**
+	 * Report a new score to all parents.
+	 */
+	void notifyParents(TMoveScore score);
+
+	/**
+	 * Indicates that the child was cut off and hasn't been evaluated.
+	 */
+	bool isChildCutOff(int childId) const;
 	
 	/**
 	 * A way for child to notify the parent that it has a new move score.
 	 */
 	void updateChildStepScore(TMoveScore score, int childId);
+
+	/**
+	 * Recalculate which children are cut off by the alpha-beta
+	 * window, bring back the ones that no longer are, and pass
+	 * the windows down to the children.
+	 */
+	void updateCutoffs();
+
+	/**
+	 * Reset the alpha-beta window so that nothing is cut off.
+	 */
+	void resetWindow();
 	
 	/**
 	 * Order the moves from the most interesting to the
@@ -138,15 +300,35 @@ private:
 	 */
 	void sortChildrenByInterest();
 	
+	//The members are ordered by size to keep the step compact;
+	//there are millions of them.
+
 	//General info.
-	char idInParent_;
+	THashKey wallHash_;				//Walls placed before this step.
+	StepEvaluator* stepEvaluator_;
+	ParentList* otherParents_;		//NULL unless the step has been shared.
+	TStepHandle handle_;
+	unsigned int serial_;
+	TStepHandle parent_;
 	TCellIndex iMe_;
 	TCellIndex iOpponent_;
-	Step* parent_;
-	StepEvaluator* stepEvaluator_;
+	int depth_;						//Step number starting from the first step.
 	TMoveScore score_;
+
+	//Alpha-beta pruning.
+	TMoveScore alpha_;
+	TMoveScore beta_;
+	unsigned short evaluatedChildren_;	//Children that have reported a score.
+	unsigned short cutChildren_;		//Children cut off by the window.
+
+	unsigned short childrenLeftToEvaluate_;
+	char idInParent_;
+	char bestChildId_;				//The opponent's best reply to my best move; -1 if not known.
+	unsigned char myGoodMoves_;		//Bit per direction.
+	unsigned char opponentGoodMoves_;
+
+	bool hasScore_;
 	bool isDeadEnd_;
-	int depth_;			//Step number starting from the first step.
 	
 	//Position of me relative to the opponent.
 	bool isFarFromOpponent_;
@@ -155,15 +337,141 @@ private:
 	//Current state of the step.
 	bool isInStepTree_;
 	bool isInEvaluationQue_;
-	
-	//Step's child steps.
 	bool hasChildren_;
-	std::vector<Step*> children_;
-	std::vector<TMoveScore> childScores_;
-	unsigned short childrenLeftToEvaluate_;
 	bool hasBranchedChildren_;
-	std::bitset<4> myGoodMoves_;
-	std::bitset<4> opponentGoodMoves_;
+	
+	//Step's child steps.
+	TStepHandle children_[16];
+	TMoveScore childScores_[16];
+};
+
+/**
+ * Allocates the steps in large slabs, so that the steps of the tree
+ * sit close together in memory, and hands out 32-bit handles to them.
+ * Freed steps are reused, never returned to the system.
+ * Must hold the tree lock.
+ */
+class StepPool {
+public:
+	//Each slab holds 2^kSlabBits steps.
+	static const int kSlabBits = 12;
+	static const TStepHandle kSlabSize = 1 << kSlabBits;
+
+	StepPool(StepEvaluator* stepEvaluator);
+	~StepPool();
+
+	/**
+	 * Get a free step, making a new slab if there are none.
+	 */
+	Step* allocate();
+	void release(Step* step);
+
+	Step* get(TStepHandle handle) const {
+		return (NO_STEP == handle ? NULL : slabs_[handle >> kSlabBits] + (handle & (kSlabSize - 1)));
+	}
+
+	//Number of steps allocated, including the free ones.
+	int getNumSteps() const			{ return static_cast<int>(slabs_.size() * kSlabSize);}
+	int getNumFreeSteps() const		{ return static_cast<int>(freeSteps_.size());}
+	int getNumStepsInUse() const	{ return this->getNumSteps() - this->getNumFreeSteps();}
+
+private:
+	void addSlab();
+
+	StepEvaluator* stepEvaluator_;
+	std::vector<Step*> slabs_;
+	std::vector<TStepHandle> freeSteps_;
+	unsigned int nextSerial_;
+};
+
+/**
+ * Per-thread state for evaluating steps.  Every worker holds its
+ * own copy of the map and its own scratch arrays, and a que of
+ * steps created by the evaluations it has performed.  Idle workers
+ * steal steps from the other workers' ques.
+ */
+class EvaluationWorker {
+public:
+	EvaluationWorker(StepEvaluator* stepEvaluator, int workerId);
+	~EvaluationWorker();
+
+	/**
+	 * Allocate the map copy and scratch arrays.  The worker
+	 * takes ownership of the scoring context.
+	 */
+	void initialize(TCellIndex iSize, TCellIndex iWidth, ScoringContext* scoringContext);
+
+	/**
+	 * Overwrite the worker's map copy with the given map.
+	 */
+	void copyCells(const TCell* cCells);
+
+	StepEvaluator* getStepEvaluator()	{ return stepEvaluator_;}
+	int getWorkerId() const				{ return workerId_;}
+	TCell* getCells()					{ return cCells_;}
+	ScoringContext* getScoringContext()	{ return scoringContext_;}
+
+	//The open cells of the worker's map; kept in step with getCells().
+	BitBoard& getBoard()				{ return board_;}
+	EvaluationQue& getQue()				{ return que_;}
+
+	//Positions of the step being evaluated, copied while holding
+	//the tree lock.
+	TCellIndex iPrevMe_;
+	TCellIndex iPrevOpponent_;
+	THashKey wallHash_;
+
+	//The step's distance flags, copied while holding the tree lock.
+	//calculatePathScore() updates them on the worker, and
+	//finishEvaluation() stores them back on the step.
+	bool isFarFromOpponent_;
+	bool isSeparatedFromOpponent_;
+
+	//Cell balance cache statistics since the last move.
+	int numCacheHits_;
+	int numCacheMisses_;
+
+	//A step whose positions have been turned into walls on the 
+	//worker's map.
+	struct AppliedStep {
+		TStepHandle step;
+		unsigned int serial;
+		TCellIndex iMe;
+		TCellIndex iOpponent;
+		TCell cMe;			//The cells that were there before.
+		TCell cOpponent;
+	};
+
+	//Ancestors of the last evaluated step, starting from the root
+	//step, that are still applied to the worker's map.  Consecutive 
+	//steps from the same subtree only need the cells that differ
+	//to be removed and placed back.
+	std::vector<AppliedStep> appliedSteps_;
+
+	//Set up while holding the tree lock: how many of the applied
+	//steps the next evaluation keeps, and which ones it adds.
+	int numStepsToKeep_;
+	std::vector<AppliedStep> stepsToApply_;
+
+	//Temporary placeholders for path scoring
+	//calculations.  Created once to avoid reallocating large arrays.
+	TCell* removedPathCells_;
+	TCellIndex* removedPathCellIndexes_;
+
+	//Last parallel evaluation session this worker took part in.
+	//Guarded by the tree lock.
+	int lastSessionNumber_;
+
+private:
+	StepEvaluator* stepEvaluator_;
+	int workerId_;
+	TCellIndex iSize_;
+	TCell* cCells_;
+	BitBoard board_;
+	ScoringContext* scoringContext_;
+
+	//Steps created while this worker held the tree lock.
+	EvaluationQue que_;
 };
 
 /**
@@ -181,6 +489,10 @@ public:
 	//Maximum path length for the path evaluation method.
 	static const int kMaxPathCalculationDepth = 50;
 
+	//Evicting steps brings their number down to this 
+	//percentage of the memory limit.
+	static const int kLowWaterPercent = 75;
+
 	//Do not explore moves that cause this much drop/increace in
 	//relative move score.  We assume that neither me nor opponent
 	//will make moves that will cause sudden drop of the bot's fortune.
@@ -194,6 +506,17 @@ public:
 	//Switch to 'near' strategy when closer than this to opponent.
 	static const int kMinFarDistance = 6;
 
+	//Upper limit on the number of threads evaluating steps.
+	static const int kMaxThreads = 32;
+
+	//Priority of the steps in the evaluation que: one per step of depth
+	//from the root, plus a penalty for being off the principal 
+	//variation, plus one for every so many points of difference between
+	//the parent's score and the root's score, up to a limit.
+	static const int kOffPrincipalVariationPenalty = 2;
+	static const int kScoreMarginPerPriority = 8;
+	static const int kMaxScoreMarginPenalty = 8;
+
 	//Constructor/destructor.
 	StepEvaluator ();
 	~StepEvaluator();
@@ -215,11 +538,55 @@ public:
 	bool performEvaluations();
 
 	/**
-	 * Calculate the path score of a step.
+	 * Same as performEvaluations(), but evaluates steps on all worker
+	 * threads at once until the time runs out.
+	 *
+	 * @return indicator whether there's any more work to be done.
+	 */
+	bool performParallelEvaluations();
+
+	/**
+	 * Set the number of threads used by performParallelEvaluations(),
+	 * including the calling thread.  Starts the worker threads.
+	 * Must be called after initialize().
+	 */
+	void setNumThreads(int numThreads);
+	int getNumThreads() const		{ return static_cast<int>(workers_.size());}
+
+	/**
+	 * Make the evaluations also stop whenever the function returns
+	 * true, and not only when the time runs out.  NULL to clear.
 	 */
-	TMoveScore calculatePathScore(Step* step);
+	void setStopFunction(TStopFunction stopFunction)	{ stopFunction_ = stopFunction;}
+
+	/**
+	 * My move has been sent; only keep exploring the steps that follow
+	 * from it while waiting for the opponent's move.
+	 * @param move: the move made (UP, RIGHT, etc.).
+	 */
+	void restrictMyMove(int move);
+
+	/**
+	 * Calculate the path score of a step using the worker's copy of the map.
+	 */
+	TMoveScore calculatePathScore(Step* step, EvaluationWorker* worker);
 
 	int getBestMove() const;
+
+	/**
+	 * The best move as of the last change to the root's scores.
+	 * Takes no locks, so the watchdog can read it while the
+	 * evaluations are running (see Watchdog.h).
+	 */
+	int getPublishedMove() const	{ return static_cast<int>(LoadShared(&publishedMove_));}
+
+	//Called whenever the root's scores change.  Must hold the tree lock.
+	void publishBestMove()			{ StoreShared(&publishedMove_, static_cast<unsigned long long>(getBestMove()));}
+
+	/**
+	 * How settled the choice of my move is; see TimeManager.h.
+	 */
+	SearchProgress getSearchProgress();
 	
 	/**
 	 * Add step to the queue of steps to be evaluated.
@@ -230,6 +597,7 @@ public:
 
 	//Managing free step objects.
 	void freeStep(Step* step);
+	StepPool& getStepPool()			{ return stepPool_;}
 	
 	/**
 	 * Get a new step.  Returns NULL if there are no more steps
@@ -256,7 +624,154 @@ public:
 	TCellIndex getOpponentPosition() const	{return iOpponent_;}
 	short getNumCellsRemaining() const		{return numCellsRemaining_;}
 
+	//Hash of the walls placed by the bots before the current positions.
+	THashKey getWallHash() const			{return wallHash_;}
+
+	/**
+	 * Find an existing step for the same position as the given step.
+	 * @return the step, or NULL if there's none.
+	 */
+	Step* findTransposition(const Step* step);
+
+	/**
+	 * Make the step available to findTransposition().
+	 */
+	void storeTransposition(Step* step)		{ transpositionTable_.store(step);}
+
+	int getNumTranspositions() const		{ return numTranspositions_;}
+
+	/**
+	 * Limit the memory taken up by the steps.  Once the limit is
+	 * reached, the least promising subtrees are evicted until the
+	 * steps take up kLowWaterPercent of the limit.  0 means no limit.
+	 */
+	void setMemoryLimit(int megabytes);
+
+	//Steps evicted since the last move.
+	int getNumEvictedSteps() const			{ return numEvictedSteps_;}
+
+	/**
+	 * How the cell balances split the territories into chambers, on
+	 * all workers (BOTTLENECK_CHAMBERS by default).  The cached cell
+	 * balances are not cleared, so set it before the first evaluation.
+	 */
+	void setChamberMethod(TChamberMethod chamberMethod);
+
+	/**
+	 * How the cell balances split the cells between the bots, on all
+	 * workers (FRONTIER_TERRITORIES by default).  DISTANCE_TERRITORIES
+	 * lets the path method split the territories of all 16 pairs of
+	 * moves from the same 8 distance maps on every move.  Set it
+	 * before the first evaluation, as with setChamberMethod().
+	 */
+	void setTerritoryMethod(TTerritoryMethod territoryMethod);
+
+	/**
+	 * Order in which the children of the steps are evaluated
+	 * and branched.
+	 */
+	MoveOrdering& getMoveOrdering()			{ return moveOrdering_;}
+
+	//Depth of the root step.
+	int getCurrentDepth() const				{ return currentDepth_;}
+
+	//Cell balance cache statistics since the last move.  Must not be
+	//called while evaluations are running.
+	int getNumCacheHits() const;
+	int getNumCacheMisses() const;
+
+	/**
+	 * Takes over from the step tree once the bots are separated:
+	 * the evaluations run the solver instead, and getBestMove()
+	 * follows its best path.
+	 */
+	const EndgameSolver& getEndgameSolver() const	{ return endgameSolver_;}
+
 private:
+	/**
+	 * Take the next step to evaluate: first from the worker's own
+	 * que, then from the shared que, and then from the other workers.
+	 * Must hold the tree lock.
+	 */
+	Step* takeStep(EvaluationWorker* worker);
+
+	/**
+	 * Priority of the step in the evaluation que; lower is more urgent.
+	 * Must hold the tree lock.
+	 */
+	int getPriority(const Step* step) const;
+
+	/**
+	 * Same as getPriority(), for when it's already known whether 
+	 * the step's parent is on the principal variation.
+	 */
+	int getPriority(const Step* step, bool isParentOnPrincipalVariation) const;
+
+	/**
+	 * Evict the least promising subtrees if the steps take up more 
+	 * memory than allowed.  Must hold the tree lock.
+	 */
+	void enforceMemoryLimit();
+	void evictSteps();
+
+	/**
+	 * Copy everything the evaluation needs to know about the step's
+	 * ancestors into the worker.  Must hold the tree lock.
+	 */
+	void prepareEvaluation(Step* step, EvaluationWorker* worker);
+
+	/**
+	 * Evaluate the step on the worker's copy of the map.  Does not
+	 * touch the step tree, so it can be run without the tree lock.
+	 */
+	TMoveScore evaluateStep(Step* step, EvaluationWorker* worker, bool* isDeadEnd);
+
+	/**
+	 * Report the score to the step tree.  Must hold the tree lock.
+	 */
+	void finishEvaluation(Step* step, EvaluationWorker* worker, TMoveScore moveScore, bool isDeadEnd);
+
+	/**
+	 * Evaluate steps until the time runs out or there's no more work.
+	 */
+	void runWorker(EvaluationWorker* worker);
+
+	/**
+	 * Indicates that the evaluations should stop.
+	 */
+	bool shouldStop() const		{ return (HasTimedOut() || (NULL != stopFunction_ && stopFunction_()));}
+
+	/**
+	 * Entry point for the worker threads.
+	 */
+	static void* workerThreadMain(void* argument);
+
+	/**
+	 * GetCellBalance() through the cell balance cache.
+	 * @param wallHash: hash of the walls placed by the bots on cCells.
+	 */
+	CellBalance getCachedCellBalance(EvaluationWorker* worker, THashKey wallHash, TCell* cCells,
+		TCellIndex iMe, TCellIndex iOpponent, TCellIndex iPrevMe, TCellIndex iPrevOpponent);
+
+	/**
+	 * GetCellBalances() for all 16 pairs of moves through the cell 
+	 * balance cache; only the pairs that are not in the cache
+	 * are calculated.
+	 */
+	void getCachedCellBalances(EvaluationWorker* worker, THashKey wallHash, TCell* cCells,
+		TCellIndex iMe, TCellIndex iOpponent, CellBalance* balances);
+
+	/**
+	 * Copy the internal map into all workers.
+	 */
+	void syncWorkerCells();
+
+	/**
+	 * Start the endgame solver if the bots have become separated,
+	 * or move it along with me if it's already running.
+	 */
+	void updateEndgameSolver();
+
 	//Internal copy of the map
 	//TCellm TCellIndex, etc are defined in MoveScore.h
 	TCell* cCells_;
@@ -266,16 +781,46 @@ private:
 	TCellIndex iMe_;
 	TCellIndex iOpponent_;
 	short numCellsRemaining_;
+	THashKey wallHash_;
 	
 	//The root step in the step tree.
 	Step* rootStep_;
 
 	EvaluationQue evaluationQue_;
-	std::deque<Step*> freeSteps_;
+	StepPool stepPool_;
+	TranspositionTable transpositionTable_;
+	CellBalanceCache balanceCache_;
+	MoveOrdering moveOrdering_;
+	EndgameSolver endgameSolver_;
+
+	//Workers evaluating the steps.  The first one is used by the
+	//main thread; the rest have a thread each.
+	std::vector<EvaluationWorker*> workers_;
+	std::vector<Thread*> workerThreads_;
+
+	//Guards the step tree, the evaluation ques and the free steps
+	//during parallel evaluation.
+	Mutex treeLock_;
+	Condition workAvailable_;
+	Condition sessionChanged_;
 
-	//To be reused in calculations to avoid reallocating large arrays.
-	std::vector<TCellIndex> removedCellIndexes_;
-	std::vector<TCell> removedCells_;
+	//Que that steps created under the tree lock are added to.
+	EvaluationQue* activeQue_;
+
+	//Only changed between evaluation sessions.
+	TStopFunction stopFunction_;
+
+	//getBestMove() as of the last change to the root's scores; 
+	//read without locking.
+	unsigned long long publishedMove_;
+
+	//Parallel evaluation session state.  Guarded by the tree lock.
+	int sessionNumber_;
+	int numActiveWorkers_;
+	int numBusyWorkers_;
+	bool isSessionStopped_;
+	bool hasRunOutOfWork_;
+	bool isShuttingDown_;
 	
 	//Que of steps that haven't finished branching
 	//because there was not enough memory.
@@ -284,15 +829,32 @@ private:
 
 	//General interest.
 	int numEvaluations_;
+	int numTranspositions_;
+	int numEvictedSteps_;
 	int maxDepth_;
 
+	//Memory limit, in steps in use; 0 if there's no limit.
+	int maxSteps_;
+
+	//Number of steps in use that triggers the eviction.  Raised above
+	//maxSteps_ when the last eviction couldn't free enough, so that
+	//the tree isn't walked again after every evaluation.
+	int evictionThreshold_;
+
+	//Passed on to the workers' scoring contexts.
+	TChamberMethod chamberMethod_;
+	TTerritoryMethod territoryMethod_;
+
 	//Current depth
 	int currentDepth_;			//Step number starting from the first step.
-
-	//Temporary placeholders for path scoring
-	//calculations.  Created once to avoid reallocating large arrays.
-	TCell* removedPathCells_;
-	TCellIndex* removedPathCellIndexes_;
 };
 
+inline Step* Step::getParent() const {
+	return stepEvaluator_->getStepPool().get(parent_);
+}
+
+inline Step* Step::getChild(const int childId) const {
+	return stepEvaluator_->getStepPool().get(children_[childId]);
+}
+
 #endif /* STEP_EVALUATOR_H_ */
\ No newline at end of file
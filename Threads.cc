@@ -0,0 +1,93 @@
+#include "Threads.h"
+
+/*
+ * As with the timer, two separate implementations.  See Threads.h.
+ */
+
+#ifdef TEST_ENVIRONMENT
+	Mutex::Mutex() {}
+	Mutex::~Mutex() {}
+	void Mutex::lock() {}
+	void Mutex::unlock() {}
+
+	Condition::Condition() {}
+	Condition::~Condition() {}
+	void Condition::wait(Mutex& mutex) {}
+	void Condition::broadcast() {}
+
+	Thread::Thread()
+	: isRunning_(false) {
+	}
+
+	bool Thread::start(TThreadFunction function, void* argument) {
+		return false;
+	}
+
+	void Thread::join() {}
+
+	int GetNumProcessors() {
+		return 1;
+	}
+
+	void SleepMicroseconds(int microseconds) {}
+
+#else /* #ifdef TEST_ENVIRONMENT */
+	#include <unistd.h>
+
+	Mutex::Mutex() {
+		pthread_mutex_init(&mutex_, NULL);
+	}
+
+	Mutex::~Mutex() {
+		pthread_mutex_destroy(&mutex_);
+	}
+
+	void Mutex::lock() {
+		pthread_mutex_lock(&mutex_);
+	}
+
+	void Mutex::unlock() {
+		pthread_mutex_unlock(&mutex_);
+	}
+
+	Condition::Condition() {
+		pthread_cond_init(&condition_, NULL);
+	}
+
+	Condition::~Condition() {
+		pthread_cond_destroy(&condition_);
+	}
+
+	void Condition::wait(Mutex& mutex) {
+		pthread_cond_wait(&condition_, &mutex.mutex_);
+	}
+
+	void Condition::broadcast() {
+		pthread_cond_broadcast(&condition_);
+	}
+
+	Thread::Thread()
+	: isRunning_(false), thread_() {
+	}
+
+	bool Thread::start(TThreadFunction function, void* argument) {
+		isRunning_ = (0 == pthread_create(&thread_, NULL, function, argument));
+		return isRunning_;
+	}
+
+	void Thread::join() {
+		if (isRunning_) {
+			pthread_join(thread_, NULL);
+			isRunning_ = false;
+		}
+	}
+
+	int GetNumProcessors() {
+		const long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+		return (numProcessors > 0 ? static_cast<int>(numProcessors) : 1);
+	}
+
+	void SleepMicroseconds(const int microseconds) {
+		usleep(static_cast<useconds_t>(microseconds));
+	}
+#endif /* #ifdef TEST_ENVIRONMENT */
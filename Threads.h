@@ -0,0 +1,123 @@
+/* Threads. */
+
+/*
+ * Minimal wrappers around the threading primitives used by
+ * StepEvaluator::performParallelEvaluations().  On Linux these are
+ * implemented with pthreads.  In the TEST_ENVIRONMENT (my Windows
+ * machine) there are no threads: the mutexes do nothing, and
+ * GetNumProcessors() always reports a single processor so that
+ * no worker threads are ever started.
+ */
+
+#ifndef THREADS_H_
+#define THREADS_H_
+
+#include "Timer.h"
+
+#ifndef TEST_ENVIRONMENT
+#include <pthread.h>
+#endif
+
+class Condition;
+
+class Mutex {
+public:
+	Mutex();
+	~Mutex();
+
+	void lock();
+	void unlock();
+
+private:
+	friend class Condition;
+
+#ifndef TEST_ENVIRONMENT
+	pthread_mutex_t mutex_;
+#endif
+};
+
+/**
+ * Locks a mutex for the lifetime of the object.
+ */
+class MutexLock {
+public:
+	MutexLock(Mutex& mutex)		: mutex_(mutex) { mutex_.lock();}
+	~MutexLock()				{ mutex_.unlock();}
+
+private:
+	Mutex& mutex_;
+};
+
+class Condition {
+public:
+	Condition();
+	~Condition();
+
+	/**
+	 * Wait until the condition is signalled.  The mutex must
+	 * be locked by the caller; it is locked again on return.
+	 */
+	void wait(Mutex& mutex);
+	void broadcast();
+
+private:
+#ifndef TEST_ENVIRONMENT
+	pthread_cond_t condition_;
+#endif
+};
+
+typedef void* (*TThreadFunction)(void*);
+
+class Thread {
+public:
+	Thread();
+
+	/**
+	 * Start running the function in a new thread.
+	 * @return whether the thread was started.
+	 */
+	bool start(TThreadFunction function, void* argument);
+	void join();
+
+private:
+	bool isRunning_;
+
+#ifndef TEST_ENVIRONMENT
+	pthread_t thread_;
+#endif
+};
+
+/**
+ * Number of processors available for running worker threads.
+ */
+int GetNumProcessors();
+
+/**
+ * Put the calling thread to sleep.
+ */
+void SleepMicroseconds(int microseconds);
+
+/**
+ * Reading and writing a 64-bit word shared between threads without
+ * a lock.  The word is never torn, but there are no guarantees about
+ * the order in which other threads see the writes.
+ */
+#ifdef TEST_ENVIRONMENT
+	inline unsigned long long LoadShared(const unsigned long long* word) {
+		return *word;
+	}
+
+	inline void StoreShared(unsigned long long* word, const unsigned long long value) {
+		*word = value;
+	}
+#else
+	inline unsigned long long LoadShared(const unsigned long long* word) {
+		return __atomic_load_n(word, __ATOMIC_RELAXED);
+	}
+
+	inline void StoreShared(unsigned long long* word, const unsigned long long value) {
+		__atomic_store_n(word, value, __ATOMIC_RELAXED);
+	}
+#endif
+
+#endif /* THREADS_H_ */
@@ -0,0 +1,70 @@
+/*
+ * See TimeManager.h for explanations.
+ */
+
+#include "TimeManager.h"
+
+TimeManager::TimeManager()
+: budget_(0), nextCheck_(0), hardDeadline_(0), bestMove_(0), numBestMoveChanges_(0), stableSinceEvaluations_(0) {
+}
+
+void TimeManager::startMove(const double timeLimit) {
+	budget_ = timeLimit - static_cast<double>(kSafetyMarginMilliseconds) / 1000;
+	SetTimeOut(budget_);
+	hardDeadline_ = GetMonotonicTime() 
+		+ static_cast<TMicroseconds>(timeLimit * 1000000) - kWatchdogMarginMilliseconds * 1000;
+
+	nextCheck_ = static_cast<double>(kCheckIntervalMilliseconds) / 1000;
+	bestMove_ = 0;
+	numBestMoveChanges_ = 0;
+	stableSinceEvaluations_ = 0;
+}
+
+bool TimeManager::isCheckDue() const {
+	return (GetElapsedTime() >= nextCheck_);
+}
+
+bool TimeManager::shouldStop(const SearchProgress& progress) {
+	const double elapsed = GetElapsedTime();
+	nextCheck_ = elapsed + static_cast<double>(kCheckIntervalMilliseconds) / 1000;
+
+	//Nothing to think about.
+	if (progress.numMoves <= 1 || progress.rootScore >= VERY_GOOD || progress.rootScore <= VERY_BAD) {
+		return true;
+	}
+
+	if (progress.bestMove != bestMove_) {
+		//The first best move isn't a change.
+		if (0 != bestMove_) {
+			numBestMoveChanges_++;
+		}
+
+		bestMove_ = progress.bestMove;
+		stableSinceEvaluations_ = progress.numEvaluations;
+	}
+
+	//Work out the target share of the time.
+	int targetPercent = kBaseTargetPercent + kPercentPerChange * numBestMoveChanges_;
+
+	if (progress.margin >= kWideMargin) {
+		targetPercent /= 2;
+	}
+
+	if (progress.numCellsRemaining < kManyCells) {
+		targetPercent = targetPercent * progress.numCellsRemaining / kManyCells;
+	}
+
+	if (targetPercent < kMinPercent) {
+		targetPercent = kMinPercent;
+	}
+
+	if (elapsed < budget_ * targetPercent / 100) {
+		return false;
+	}
+
+	//Could the rest of the time still change the best move?
+	const double rate = (elapsed > 0 ? progress.numEvaluations / elapsed : 0);
+	const double evaluationsLeft = rate * (budget_ - elapsed);
+
+	return (progress.numEvaluations - stableSinceEvaluations_ >= evaluationsLeft);
+}
@@ -0,0 +1,107 @@
+/*
+ * Decides how much of the time allowed for a move to spend on it.
+ *
+ * The time limit, less a safety margin, is a hard limit set through
+ * SetTimeOut(); the search never goes past it.  Within it, MakeMove()
+ * asks shouldStop() every few milliseconds whether the rest of the time
+ * is worth spending:
+ * - Not at all if I have only one move, or if the root score says the
+ *	game is won or lost whatever I do.
+ * - Otherwise the search goes on until a target share of the time,
+ *	which is larger when the best move keeps changing and smaller when
+ *	the best move is well ahead of the next one, or when few cells
+ *	are left and the tree is small.
+ * - Past the target, the search stops once the best move has held for
+ *	at least as many evaluations as the measured evaluation rate says
+ *	are left until the hard limit.
+ */
+#ifndef TIME_MANAGER_H_
+#define TIME_MANAGER_H_
+
+#include <vector>
+#include "MoveScore.h"
+#include "Timer.h"
+
+/**
+ * What the search has found so far; see StepEvaluator::getSearchProgress().
+ */
+struct SearchProgress {
+	int bestMove;
+
+	//My moves that don't run into a wall.
+	int numMoves;
+
+	TMoveScore rootScore;
+
+	//Worst-case score of the best of my moves, less that of the next best one.
+	TMoveScore margin;
+
+	int numEvaluations;
+	short numCellsRemaining;
+};
+
+class TimeManager {
+public:
+	//Taken off the time limit to allow for reading and writing the moves.
+	static const int kSafetyMarginMilliseconds = 100;
+
+	//The watchdog sends the move this long before the time limit,
+	//if the search hasn't by then (see Watchdog.h).  The clock only
+	//starts once the map has been read, so this also has to cover the
+	//time the map spent in the pipe and being read.
+	static const int kWatchdogMarginMilliseconds = 60;
+
+	//Time between the checks of shouldStop().
+	static const int kCheckIntervalMilliseconds = 10;
+
+	//Never stop before this share of the time, unless there's nothing
+	//to think about.
+	static const int kMinPercent = 20;
+
+	//Target share of the time, plus more for each change of the best
+	//move, up to the whole time.
+	static const int kBaseTargetPercent = 50;
+	static const int kPercentPerChange = 15;
+
+	//The target is halved once the best move is this far ahead.
+	static const int kWideMargin = 10;
+
+	//Fewer cells left than this bring the target down in proportion.
+	static const int kManyCells = 200;
+
+	TimeManager();
+
+	/**
+	 * Start the clock for a move; sets the hard limit.
+	 * @param timeLimit: seconds allowed for the move.
+	 */
+	void startMove(double timeLimit);
+
+	/**
+	 * Indicates that shouldStop() is due to be asked again.
+	 * Can be used as a stop function for the search.
+	 */
+	bool isCheckDue() const;
+
+	/**
+	 * @return whether the search should give up the rest of the time.
+	 */
+	bool shouldStop(const SearchProgress& progress);
+
+	int getNumBestMoveChanges() const		{ return numBestMoveChanges_;}
+
+	//When the watchdog has to send the move, on the monotonic clock.
+	TMicroseconds getHardDeadline() const	{ return hardDeadline_;}
+
+private:
+	//Seconds to the hard limit, and to the next check.
+	double budget_;
+	double nextCheck_;
+	TMicroseconds hardDeadline_;
+
+	int bestMove_;
+	int numBestMoveChanges_;
+	int stableSinceEvaluations_;
+};
+
+#endif /* TIME_MANAGER_H_ */
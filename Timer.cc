@@ -1,49 +1,100 @@
 #include "Timer.h"
 
 /*
- * Two separate implementations.  A Linux implementation uses gettimeofday(),
- * which is the actual method of timing the contest entry.  Unfortunately, 
- * that is not available on Windows, so for testing on my computer I use clock().
+ * Two separate implementations of the clock.  A Linux implementation
+ * uses clock_gettime() on the monotonic clock, which keeps going
+ * through midnight and through changes to the system time.  That is
+ * not available on Windows, so for testing on my computer I use clock().
  */
 
 #ifdef TEST_ENVIRONMENT
-	#include <iostream>
-
 	#include <time.h>
-	clock_t gTimeOut = 0;
-	clock_t gStartTime = 0;
 
-	void SetTimeOut(double seconds) {
-		gTimeOut = static_cast<clock_t>(static_cast<double>(CLOCKS_PER_SEC) * seconds - 0.4);
-		gStartTime = clock();
+	TMicroseconds GetMonotonicTime() {
+		return static_cast<TMicroseconds>(clock()) * 1000000 / CLOCKS_PER_SEC;
 	}
 
-	bool HasTimedOut() {
-		return ((clock() - gStartTime) >= gTimeOut);
-	}
+	//There's only one thread.
+	static int gCallsToClockCheck = 0;
 
 #else /* #ifdef  TEST_ENVIRONMENT */
-	#include <sys/time.h>
+	#include <time.h>
 
-	//In microseconds
-	long int gTimeOut = 0;
-	long int gStartTime = 0;
-	const long int SECONDS_PER_DAY = 86400;
+	TMicroseconds GetMonotonicTime() {
+		timespec currentTime;
+		clock_gettime(CLOCK_MONOTONIC, &currentTime);
 
-	void SetTimeOut(double seconds) {
-		timeval startTime;
-		gettimeofday(&startTime, NULL);
+		return static_cast<TMicroseconds>(currentTime.tv_sec) * 1000000 + currentTime.tv_nsec / 1000;
+	}
+
+	//Counted separately by every thread.
+	static __thread int gCallsToClockCheck = 0;
+#endif /* #ifdef TEST_ENVIRONMENT */
 
-		gStartTime = (startTime.tv_sec % SECONDS_PER_DAY)* 1000 + startTime.tv_usec / 1000;
-		gTimeOut = static_cast<long int>(seconds * 1000.0);
+/*****************************
+    Class Deadline
+*****************************/
+Deadline::Deadline()
+: startTime_(0), endTime_(0), token_() {
+}
+
+void Deadline::start(const double seconds) {
+	startTime_ = GetMonotonicTime();
+	endTime_ = startTime_ + static_cast<TMicroseconds>(seconds * 1000000.0);
+	token_.reset();
+}
+
+bool Deadline::hasPassed() {
+	if (token_.isCancelled()) {
+		return true;
 	}
-	
-	bool HasTimedOut() {
-		timeval currentTime;
-		gettimeofday(&currentTime, NULL);
-		
-		long int currentMilliseconds = (currentTime.tv_sec % SECONDS_PER_DAY) * 1000 + currentTime.tv_usec / 1000;
-
-		return ((currentMilliseconds - gStartTime) > gTimeOut);
+
+	if (--gCallsToClockCheck > 0) {
+		return false;
 	}
-#endif /* #ifdef TEST_ENVIRONMENT */
+
+	gCallsToClockCheck = kCallsPerClockCheck;
+	return this->hasPassedNow();
+}
+
+bool Deadline::hasPassedNow() {
+	if (GetMonotonicTime() < endTime_) {
+		return token_.isCancelled();
+	}
+
+	token_.cancel();
+	return true;
+}
+
+double Deadline::getElapsed() const {
+	return static_cast<double>(GetMonotonicTime() - startTime_) / 1000000.0;
+}
+
+double Deadline::getRemaining() const {
+	return static_cast<double>(endTime_ - GetMonotonicTime()) / 1000000.0;
+}
+
+/*****************************
+    The program's deadline
+*****************************/
+static Deadline gDeadline;
+
+Deadline& GetDeadline() {
+	return gDeadline;
+}
+
+void SetTimeOut(const double seconds) {
+	gDeadline.start(seconds);
+}
+
+bool HasTimedOut() {
+	return gDeadline.hasPassed();
+}
+
+double GetElapsedTime() {
+	return gDeadline.getElapsed();
+}
+
+void CancelTimeOut() {
+	gDeadline.getToken().cancel();
+}
@@ -1,18 +1,105 @@
 /* Timer. */
 
+/*
+ * The time for a move is kept by a Deadline on a monotonic clock, in
+ * microseconds, so that changes to the wall-clock time can't move it.
+ * SetTimeOut() and friends work on the one Deadline for the whole
+ * program.
+ *
+ * HasTimedOut() is cheap enough for the inner loops of the scorers:
+ * most calls only look at the deadline's cancellation token, and the
+ * clock is read once every Deadline::kCallsPerClockCheck calls on
+ * each thread.  Once a thread sees that the time is up, it cancels
+ * the token, and all the others stop on their next call.  The token
+ * can also be cancelled directly, e.g. to give up on a move early.
+ */
+
 #ifndef TIMER_H_
 #define TIMER_H_
 
 //When uncommented, indicates whether the code is being compiled for
-//my own computer (a Windows machine).  
+//my own computer (a Windows machine).
 //#define TEST_ENVIRONMENT
 
 //Keeping track of time.
 void SetTimeOut(double seconds);
 bool HasTimedOut();
 
+//Seconds since the last SetTimeOut().
+double GetElapsedTime();
+
+//Make HasTimedOut() return true until the next SetTimeOut().
+void CancelTimeOut();
+
+//Indicates that the calculations should stop before the time runs out.
+typedef bool (*TStopFunction)();
+
 #ifndef NULL
 #define NULL 0
 #endif
 
-#endif /* TIMER_H_ */
\ No newline at end of file
+//Microseconds on the monotonic clock, from an arbitrary start.
+typedef long long TMicroseconds;
+
+TMicroseconds GetMonotonicTime();
+
+/**
+ * A flag that any thread can raise, and the others poll with a
+ * plain load.
+ */
+class CancellationToken {
+public:
+	CancellationToken()					: isCancelled_(0) {}
+
+#ifdef TEST_ENVIRONMENT
+	bool isCancelled() const			{ return (0 != isCancelled_);}
+	void cancel()						{ isCancelled_ = 1;}
+	void reset()						{ isCancelled_ = 0;}
+#else
+	bool isCancelled() const			{ return (0 != __atomic_load_n(&isCancelled_, __ATOMIC_RELAXED));}
+	void cancel()						{ __atomic_store_n(&isCancelled_, 1, __ATOMIC_RELAXED);}
+	void reset()						{ __atomic_store_n(&isCancelled_, 0, __ATOMIC_RELAXED);}
+#endif
+
+private:
+	int isCancelled_;
+};
+
+class Deadline {
+public:
+	//HasTimedOut() calls per reading of the clock, on each thread.
+	static const int kCallsPerClockCheck = 8;
+
+	Deadline();
+
+	/**
+	 * Start the clock; the deadline is this many seconds away.
+	 * Resets the token.  Must not be called while other threads
+	 * are checking the deadline.
+	 */
+	void start(double seconds);
+
+	/**
+	 * Whether the deadline has passed or the token has been cancelled.
+	 * Reads the clock only every kCallsPerClockCheck calls.
+	 */
+	bool hasPassed();
+
+	//Same, but always reads the clock.
+	bool hasPassedNow();
+
+	double getElapsed() const;
+	double getRemaining() const;
+
+	CancellationToken& getToken()		{ return token_;}
+
+private:
+	TMicroseconds startTime_;
+	TMicroseconds endTime_;
+	CancellationToken token_;
+};
+
+//The deadline behind SetTimeOut(), etc.
+Deadline& GetDeadline();
+
+#endif /* TIMER_H_ */
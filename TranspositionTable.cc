@@ -0,0 +1,48 @@
+#include "TranspositionTable.h"
+#include "StepEvaluator.h"
+
+TranspositionTable::TranspositionTable()
+: slots_(NULL) {
+	const unsigned int numSlots = 1u << kTableBits;
+	slots_ = new Step*[numSlots];
+
+	for (unsigned int i = 0; i < numSlots; ++i) {
+		slots_[i] = NULL;
+	}
+}
+
+TranspositionTable::~TranspositionTable() {
+	delete[] slots_;
+}
+
+Step* TranspositionTable::find(const THashKey key, 
+							   const TCellIndex iMe, 
+							   const TCellIndex iOpponent, 
+							   const int depth) const {
+	Step* step = slots_[getSlot(key)];
+
+	if (NULL == step 
+		|| step->getHashKey() != key
+		|| !step->isInStepTree() 
+		|| step->isDeadEnd()
+		|| step->getMyPosition() != iMe 
+		|| step->getOpponentPosition() != iOpponent
+		|| step->getDepth() != depth) {
+		
+		return NULL;
+	}
+
+	return step;
+}
+
+void TranspositionTable::store(Step* step) {
+	slots_[getSlot(step->getHashKey())] = step;
+}
+
+void TranspositionTable::remove(Step* step) {
+	const unsigned int slot = getSlot(step->getHashKey());
+
+	if (slots_[slot] == step) {
+		slots_[slot] = NULL;
+	}
+}
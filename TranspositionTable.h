@@ -0,0 +1,50 @@
+/*
+ * The same position (walls, my position, opponent's position) can
+ * often be reached through different orders of moves, e.g. when I go
+ * up and then right, or right and then up.  The transposition table
+ * lets Step::branch() find a step that already exists for the 
+ * position and link to it, instead of creating and evaluating
+ * a duplicate.  This turns the tree of steps into a DAG.
+ *
+ * The table is direct-mapped: every slot holds at most one step,
+ * and newer steps replace older ones.  Losing an entry only
+ * means a transposition goes unnoticed.
+ */
+#ifndef TRANSPOSITION_TABLE_H_
+#define TRANSPOSITION_TABLE_H_
+
+#include "Zobrist.h"
+
+class Step;
+
+class TranspositionTable {
+public:
+	//The table has 2^kTableBits slots.
+	static const int kTableBits = 20;
+
+	TranspositionTable();
+	~TranspositionTable();
+
+	/**
+	 * Find a step for the position.  
+	 * @return the step, or NULL if there's none.
+	 */
+	Step* find(THashKey key, TCellIndex iMe, TCellIndex iOpponent, int depth) const;
+
+	/**
+	 * Remember the step, replacing whatever was in its slot.
+	 */
+	void store(Step* step);
+
+	/**
+	 * Forget the step; called when the step is freed.
+	 */
+	void remove(Step* step);
+
+private:
+	unsigned int getSlot(THashKey key) const	{ return static_cast<unsigned int>(key >> (64 - kTableBits));}
+
+	Step** slots_;
+};
+
+#endif /* TRANSPOSITION_TABLE_H_ */
@@ -0,0 +1,440 @@
+#include "Voronoi.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+	typedef BitBoard::TWord TWord;
+
+	/*
+	 * Lane operations.  A lane is as many words as the widest
+	 * available registers hold; the shifts are within each word.
+	 */
+#if defined(__AVX2__)
+	typedef __m256i TLane;
+	const int kLaneWords = 4;
+
+	inline TLane LoadLane(const TWord* words)			{ return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words));}
+	inline void StoreLane(TWord* words, TLane lane)		{ _mm256_storeu_si256(reinterpret_cast<__m256i*>(words), lane);}
+	inline TLane ZeroLane()								{ return _mm256_setzero_si256();}
+	inline TLane Or(TLane a, TLane b)					{ return _mm256_or_si256(a, b);}
+	inline TLane And(TLane a, TLane b)					{ return _mm256_and_si256(a, b);}
+	inline TLane AndNot(TLane a, TLane b)				{ return _mm256_andnot_si256(b, a);}
+	inline TLane ShiftUp(TLane lane, int numBits)		{ return _mm256_sll_epi64(lane, _mm_cvtsi32_si128(numBits));}
+	inline TLane ShiftDown(TLane lane, int numBits)		{ return _mm256_srl_epi64(lane, _mm_cvtsi32_si128(numBits));}
+	inline bool IsZero(TLane lane)						{ return (0 != _mm256_testz_si256(lane, lane));}
+
+#elif defined(__SSE2__)
+	typedef __m128i TLane;
+	const int kLaneWords = 2;
+
+	inline TLane LoadLane(const TWord* words)			{ return _mm_loadu_si128(reinterpret_cast<const __m128i*>(words));}
+	inline void StoreLane(TWord* words, TLane lane)		{ _mm_storeu_si128(reinterpret_cast<__m128i*>(words), lane);}
+	inline TLane ZeroLane()								{ return _mm_setzero_si128();}
+	inline TLane Or(TLane a, TLane b)					{ return _mm_or_si128(a, b);}
+	inline TLane And(TLane a, TLane b)					{ return _mm_and_si128(a, b);}
+	inline TLane AndNot(TLane a, TLane b)				{ return _mm_andnot_si128(b, a);}
+	inline TLane ShiftUp(TLane lane, int numBits)		{ return _mm_sll_epi64(lane, _mm_cvtsi32_si128(numBits));}
+	inline TLane ShiftDown(TLane lane, int numBits)		{ return _mm_srl_epi64(lane, _mm_cvtsi32_si128(numBits));}
+	inline bool IsZero(TLane lane)						{ return (0xffff == _mm_movemask_epi8(_mm_cmpeq_epi8(lane, _mm_setzero_si128())));}
+
+#else
+	typedef TWord TLane;
+	const int kLaneWords = 1;
+
+	inline TLane LoadLane(const TWord* words)			{ return *words;}
+	inline void StoreLane(TWord* words, TLane lane)		{ *words = lane;}
+	inline TLane ZeroLane()								{ return 0;}
+	inline TLane Or(TLane a, TLane b)					{ return (a | b);}
+	inline TLane And(TLane a, TLane b)					{ return (a & b);}
+	inline TLane AndNot(TLane a, TLane b)				{ return (a & ~b);}
+	inline TLane ShiftUp(TLane lane, int numBits)		{ return (numBits < 64 ? lane << numBits : 0);}
+	inline TLane ShiftDown(TLane lane, int numBits)		{ return (numBits < 64 ? lane >> numBits : 0);}
+	inline bool IsZero(TLane lane)						{ return (0 == lane);}
+#endif
+
+	/**
+	 * The cells next to the cells of the board, for the lane starting
+	 * at words[0].  The board must have enough zero words around it.
+	 * @param rowWords, rowBits: the map width in whole words and the
+	 *	remaining bits.
+	 */
+	inline TLane GetNeighbours(const TWord* words, const int rowWords, const int rowBits) {
+		const TLane lane = LoadLane(words);
+
+		//Left and right.
+		TLane neighbours = Or(ShiftUp(lane, 1), ShiftDown(LoadLane(words - 1), 63));
+		neighbours = Or(neighbours, Or(ShiftDown(lane, 1), ShiftUp(LoadLane(words + 1), 63)));
+
+		//Up and down.
+		neighbours = Or(neighbours, Or(ShiftUp(LoadLane(words - rowWords), rowBits),
+			ShiftDown(LoadLane(words - rowWords - 1), 64 - rowBits)));
+		neighbours = Or(neighbours, Or(ShiftDown(LoadLane(words + rowWords), rowBits),
+			ShiftUp(LoadLane(words + rowWords + 1), 64 - rowBits)));
+
+		return neighbours;
+	}
+}
+
+Voronoi::Voronoi()
+: iSize_(0), iWidth_(0), numWords_(0), numPaddingWords_(0), bufferStride_(0), buffers_(), pairBuffers_(),
+myTerritory_(), opponentTerritory_(), neutralCells_(), myPairTerritories_(), opponentPairTerritories_() {
+}
+
+void Voronoi::initialize(const TCellIndex iSize, const TCellIndex iWidth) {
+	iSize_ = iSize;
+	iWidth_ = iWidth;
+
+	const int numBoardWords = (iSize + BitBoard::kWordBits - 1) / BitBoard::kWordBits;
+	numWords_ = (numBoardWords + kLaneWords - 1) / kLaneWords * kLaneWords;
+
+	//A lane reads up to a row and a word past its ends.
+	numPaddingWords_ = iWidth / BitBoard::kWordBits + 2;
+	bufferStride_ = numWords_ + 2 * numPaddingWords_;
+	buffers_.assign(NUM_BUFFERS * bufferStride_, 0);
+	pairBuffers_.assign(NUM_PAIR_BUFFERS * bufferStride_, 0);
+
+	myTerritory_.initialize(iSize, iWidth);
+	opponentTerritory_.initialize(iSize, iWidth);
+	neutralCells_.initialize(iSize, iWidth);
+
+	BitBoard emptyBoard;
+	emptyBoard.initialize(iSize, iWidth);
+	myPairTerritories_.assign(kNumPairs, emptyBoard);
+	opponentPairTerritories_.assign(kNumPairs, emptyBoard);
+}
+
+CellBalance Voronoi::compute(const BitBoard& open, const TCellIndex iMe, const TCellIndex iOpponent) {
+	const int numBoardWords = open.getNumWords();
+	const TWord* openWords = open.getWords();
+
+	for (int iBuffer = 0; iBuffer < NUM_BUFFERS; ++iBuffer) {
+		TWord* words = getBuffer(iBuffer);
+
+		for (int i = 0; i < numWords_; ++i) {
+			words[i] = 0;
+		}
+	}
+
+	TWord* freeCells = getBuffer(FREE_CELLS);
+
+	for (int i = 0; i < numBoardWords; ++i) {
+		freeCells[i] = openWords[i];
+	}
+
+	//The bots start out on their own positions.
+	const TWord myBit = static_cast<TWord>(1) << (iMe % BitBoard::kWordBits);
+	const TWord opponentBit = static_cast<TWord>(1) << (iOpponent % BitBoard::kWordBits);
+	const int iMyWord = iMe / BitBoard::kWordBits;
+	const int iOpponentWord = iOpponent / BitBoard::kWordBits;
+
+	freeCells[iMyWord] &= ~myBit;
+	freeCells[iOpponentWord] &= ~opponentBit;
+	getBuffer(MY_FRONTIER)[iMyWord] |= myBit;
+	getBuffer(MY_TERRITORY)[iMyWord] |= myBit;
+	getBuffer(OPPONENT_FRONTIER)[iOpponentWord] |= opponentBit;
+	getBuffer(OPPONENT_TERRITORY)[iOpponentWord] |= opponentBit;
+
+	int myFrontier = MY_FRONTIER;
+	int opponentFrontier = OPPONENT_FRONTIER;
+	int myNextFrontier = MY_NEXT_FRONTIER;
+	int opponentNextFrontier = OPPONENT_NEXT_FRONTIER;
+
+	bool haveMet = false;
+	int numSteps = 0;
+	int numStepsToMeet = 0;
+
+	while (true) {
+		numSteps++;
+		const bool hasGrown = growFrontiers(myFrontier, opponentFrontier,
+			myNextFrontier, opponentNextFrontier, &haveMet);
+
+		if (haveMet && 0 == numStepsToMeet) {
+			numStepsToMeet = numSteps;
+		}
+
+		if (!hasGrown) {
+			break;
+		}
+
+		//The next frontiers become current.
+		int temp = myFrontier;
+		myFrontier = myNextFrontier;
+		myNextFrontier = temp;
+
+		temp = opponentFrontier;
+		opponentFrontier = opponentNextFrontier;
+		opponentNextFrontier = temp;
+	}
+
+	copyResult(MY_TERRITORY, &myTerritory_);
+	copyResult(OPPONENT_TERRITORY, &opponentTerritory_);
+	copyResult(NEUTRAL_CELLS, &neutralCells_);
+
+	CellBalance cellBalance;
+	cellBalance.score = static_cast<TMoveScore>(myTerritory_.count() - opponentTerritory_.count());
+	cellBalance.areSeparated = !haveMet;
+	cellBalance.distanceToOpponent = 2 * numStepsToMeet;
+	return cellBalance;
+}
+
+bool Voronoi::growFrontiers(const int myFrontier,
+							const int opponentFrontier,
+							const int myNextFrontier,
+							const int opponentNextFrontier,
+							bool* haveMet) {
+	TWord* freeCells = getBuffer(FREE_CELLS);
+	const TWord* myCells = getBuffer(myFrontier);
+	const TWord* opponentCells = getBuffer(opponentFrontier);
+	TWord* myNewCells = getBuffer(myNextFrontier);
+	TWord* opponentNewCells = getBuffer(opponentNextFrontier);
+	TWord* myTerritory = getBuffer(MY_TERRITORY);
+	TWord* opponentTerritory = getBuffer(OPPONENT_TERRITORY);
+	TWord* neutralCells = getBuffer(NEUTRAL_CELLS);
+
+	const int rowWords = iWidth_ / BitBoard::kWordBits;
+	const int rowBits = iWidth_ % BitBoard::kWordBits;
+
+	TLane grown = ZeroLane();
+	TLane met = ZeroLane();
+
+	for (int i = 0; i < numWords_; i += kLaneWords) {
+		const TLane free = LoadLane(freeCells + i);
+		const TLane myNeighbours = GetNeighbours(myCells + i, rowWords, rowBits);
+		const TLane opponentNeighbours = GetNeighbours(opponentCells + i, rowWords, rowBits);
+		const TLane myTerritoryLane = LoadLane(myTerritory + i);
+		const TLane opponentTerritoryLane = LoadLane(opponentTerritory + i);
+
+		//Cells that both bots reach at the same time are nobody's.
+		TLane myNew = And(myNeighbours, free);
+		TLane opponentNew = And(opponentNeighbours, free);
+		const TLane neutralNew = And(myNew, opponentNew);
+		myNew = AndNot(myNew, neutralNew);
+		opponentNew = AndNot(opponentNew, neutralNew);
+
+		StoreLane(freeCells + i, AndNot(free, Or(myNeighbours, opponentNeighbours)));
+		StoreLane(myNewCells + i, myNew);
+		StoreLane(opponentNewCells + i, opponentNew);
+		StoreLane(myTerritory + i, Or(myTerritoryLane, myNew));
+		StoreLane(opponentTerritory + i, Or(opponentTerritoryLane, opponentNew));
+		StoreLane(neutralCells + i, Or(LoadLane(neutralCells + i), neutralNew));
+
+		grown = Or(grown, Or(myNew, opponentNew));
+		met = Or(met, neutralNew);
+		met = Or(met, And(myNeighbours, opponentTerritoryLane));
+		met = Or(met, And(opponentNeighbours, myTerritoryLane));
+	}
+
+	if (!IsZero(met)) {
+		*haveMet = true;
+	}
+
+	return !IsZero(grown);
+}
+
+void Voronoi::computePairs(const BitBoard& open, 
+						   const TCellIndex* iMyPositions, 
+						   const TCellIndex* iOpponentPositions, 
+						   const bool* isPairNeeded, 
+						   CellBalance* balances) {
+	const int numBoardWords = open.getNumWords();
+	const TWord* openWords = open.getWords();
+	TWord* openCells = getBuffer(FREE_CELLS);
+
+	for (int i = 0; i < numWords_; ++i) {
+		openCells[i] = (i < numBoardWords ? openWords[i] : 0);
+	}
+
+	//Only grow the areas of the positions that some pair needs.
+	TCellIndex iPositions[2 * kNumPairPositions];
+	bool isPositionNeeded[2 * kNumPairPositions];
+
+	for (int i = 0; i < kNumPairPositions; ++i) {
+		iPositions[i] = iMyPositions[i];
+		iPositions[kNumPairPositions + i] = iOpponentPositions[i];
+	}
+
+	for (int i = 0; i < 2 * kNumPairPositions; ++i) {
+		isPositionNeeded[i] = false;
+	}
+
+	for (int pair = 0; pair < kNumPairs; ++pair) {
+		if (isPairNeeded[pair]) {
+			isPositionNeeded[pair % kNumPairPositions] = true;
+			isPositionNeeded[kNumPairPositions + pair / kNumPairPositions] = true;
+		}
+	}
+
+	//Each position starts out as its own area and frontier.
+	int frontiers[2 * kNumPairPositions];
+	int nextFrontiers[2 * kNumPairPositions];
+
+	for (int i = 0; i < 2 * kNumPairPositions; ++i) {
+		frontiers[i] = POSITION_FRONTIERS + i;
+		nextFrontiers[i] = POSITION_NEXT_FRONTIERS + i;
+
+		if (!isPositionNeeded[i]) {
+			continue;
+		}
+
+		TWord* area = getPairBuffer(POSITION_AREAS + i);
+		TWord* frontier = getPairBuffer(frontiers[i]);
+
+		for (int iWord = 0; iWord < numWords_; ++iWord) {
+			area[iWord] = 0;
+			frontier[iWord] = 0;
+		}
+
+		const TWord bit = static_cast<TWord>(1) << (iPositions[i] % BitBoard::kWordBits);
+		area[iPositions[i] / BitBoard::kWordBits] |= bit;
+		frontier[iPositions[i] / BitBoard::kWordBits] |= bit;
+	}
+
+	//Each bot's territory starts out as its own position.
+	int numStepsToMeet[kNumPairs];
+
+	for (int pair = 0; pair < kNumPairs; ++pair) {
+		if (!isPairNeeded[pair]) {
+			continue;
+		}
+
+		numStepsToMeet[pair] = 0;
+		TWord* myTerritory = getPairBuffer(MY_PAIR_TERRITORIES + pair);
+		TWord* opponentTerritory = getPairBuffer(OPPONENT_PAIR_TERRITORIES + pair);
+		const TWord* myArea = getPairBuffer(POSITION_AREAS + pair % kNumPairPositions);
+		const TWord* opponentArea = getPairBuffer(POSITION_AREAS + kNumPairPositions + pair / kNumPairPositions);
+
+		for (int i = 0; i < numWords_; ++i) {
+			myTerritory[i] = myArea[i];
+			opponentTerritory[i] = opponentArea[i];
+		}
+	}
+
+	const int rowWords = iWidth_ / BitBoard::kWordBits;
+	const int rowBits = iWidth_ % BitBoard::kWordBits;
+	int numSteps = 0;
+	bool hasGrown = true;
+
+	while (hasGrown) {
+		numSteps++;
+		hasGrown = false;
+
+		//Grow every area by a step, ignoring the other positions.
+		for (int iPosition = 0; iPosition < 2 * kNumPairPositions; ++iPosition) {
+			if (!isPositionNeeded[iPosition]) {
+				continue;
+			}
+
+			TWord* area = getPairBuffer(POSITION_AREAS + iPosition);
+			const TWord* frontier = getPairBuffer(frontiers[iPosition]);
+			TWord* nextFrontier = getPairBuffer(nextFrontiers[iPosition]);
+			TLane grown = ZeroLane();
+
+			for (int i = 0; i < numWords_; i += kLaneWords) {
+				const TLane areaLane = LoadLane(area + i);
+				const TLane newCells = AndNot(And(GetNeighbours(frontier + i, rowWords, rowBits), 
+					LoadLane(openCells + i)), areaLane);
+
+				StoreLane(nextFrontier + i, newCells);
+				StoreLane(area + i, Or(areaLane, newCells));
+				grown = Or(grown, newCells);
+			}
+
+			if (!IsZero(grown)) {
+				hasGrown = true;
+			}
+
+			const int temp = frontiers[iPosition];
+			frontiers[iPosition] = nextFrontiers[iPosition];
+			nextFrontiers[iPosition] = temp;
+		}
+
+		//A bot's new cells are its own unless the other bot 
+		//has reached them by now as well.
+		for (int pair = 0; pair < kNumPairs; ++pair) {
+			if (!isPairNeeded[pair]) {
+				continue;
+			}
+
+			const int iMyPosition = pair % kNumPairPositions;
+			const int iOpponentPosition = kNumPairPositions + pair / kNumPairPositions;
+			const TWord* myNewCells = getPairBuffer(frontiers[iMyPosition]);
+			const TWord* opponentNewCells = getPairBuffer(frontiers[iOpponentPosition]);
+			const TWord* myArea = getPairBuffer(POSITION_AREAS + iMyPosition);
+			const TWord* opponentArea = getPairBuffer(POSITION_AREAS + iOpponentPosition);
+			TWord* myTerritory = getPairBuffer(MY_PAIR_TERRITORIES + pair);
+			TWord* opponentTerritory = getPairBuffer(OPPONENT_PAIR_TERRITORIES + pair);
+
+			for (int i = 0; i < numWords_; i += kLaneWords) {
+				StoreLane(myTerritory + i, Or(LoadLane(myTerritory + i), 
+					AndNot(LoadLane(myNewCells + i), LoadLane(opponentArea + i))));
+				StoreLane(opponentTerritory + i, Or(LoadLane(opponentTerritory + i), 
+					AndNot(LoadLane(opponentNewCells + i), LoadLane(myArea + i))));
+			}
+
+			//The frontiers of compute() meet halfway between the bots.
+			const TCellIndex iMe = iPositions[iMyPosition];
+
+			if (0 == numStepsToMeet[pair] 
+				&& ((opponentArea[iMe / BitBoard::kWordBits] >> (iMe % BitBoard::kWordBits)) & 1) != 0) {
+				
+				numStepsToMeet[pair] = (numSteps + 1) / 2;
+			}
+		}
+	}
+
+	for (int pair = 0; pair < kNumPairs; ++pair) {
+		if (!isPairNeeded[pair]) {
+			continue;
+		}
+
+		copyWords(getPairBuffer(MY_PAIR_TERRITORIES + pair), &myPairTerritories_[pair]);
+		copyWords(getPairBuffer(OPPONENT_PAIR_TERRITORIES + pair), &opponentPairTerritories_[pair]);
+
+		balances[pair].score = static_cast<TMoveScore>(myPairTerritories_[pair].count() 
+			- opponentPairTerritories_[pair].count());
+		balances[pair].areSeparated = (0 == numStepsToMeet[pair]);
+		balances[pair].distanceToOpponent = 2 * numStepsToMeet[pair];
+	}
+}
+
+CellBalance Voronoi::computeByDistance(const BitBoard& open, 
+									  const TCellIndex iMe, 
+									  const TCellIndex iOpponent) {
+	TCellIndex iMyPositions[kNumPairPositions];
+	TCellIndex iOpponentPositions[kNumPairPositions];
+	bool isPairNeeded[kNumPairs];
+	CellBalance balances[kNumPairs];
+
+	for (int i = 0; i < kNumPairPositions; ++i) {
+		iMyPositions[i] = iMe;
+		iOpponentPositions[i] = iOpponent;
+	}
+
+	for (int pair = 0; pair < kNumPairs; ++pair) {
+		isPairNeeded[pair] = (0 == pair);
+	}
+
+	this->computePairs(open, iMyPositions, iOpponentPositions, isPairNeeded, balances);
+
+	myTerritory_ = myPairTerritories_[0];
+	opponentTerritory_ = opponentPairTerritories_[0];
+	neutralCells_.clear();
+	return balances[0];
+}
+
+void Voronoi::copyResult(const int iBuffer, BitBoard* board) {
+	copyWords(getBuffer(iBuffer), board);
+}
+
+void Voronoi::copyWords(const TWord* words, BitBoard* board) {
+	TWord* boardWords = board->getWords();
+	const int numBoardWords = board->getNumWords();
+
+	for (int i = 0; i < numBoardWords; ++i) {
+		boardWords[i] = words[i];
+	}
+}
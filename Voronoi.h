@@ -0,0 +1,140 @@
+/*
+ * Bit-parallel version of part 1 of the tree-of-chambers calculation
+ * (see README.txt, section [3]): splitting the open cells into the
+ * ones that I reach first, the ones that the opponent reaches first,
+ * and the neutral ones that we both reach at the same time.
+ *
+ * Instead of labelling one cell at a time through a que, both bots'
+ * frontiers grow by one step per pass over a BitBoard: the cells next
+ * to a frontier are a few shifts of the board words, masked by the
+ * cells nobody has claimed yet.  The passes are written once against
+ * a small set of lane operations, which use AVX2 or SSE2 when the
+ * compiler targets them (e.g. -mavx2), and plain 64-bit words
+ * otherwise.
+ *
+ * computePairs() splits the cells by distance instead: a cell is mine
+ * if it's closer to me than to the opponent, however the cells on the
+ * way there are split.  Each position's distance map is grown once, as
+ * one area per step, and the territories of all 16 pairs of my and the
+ * opponent's moves take a couple of lane operations per step each.
+ * When the bots are on cells of different colours, no cell is as far
+ * from one bot as from the other, so there are no neutral cells to get
+ * in the way of compute()'s frontiers, and the two splits are the same.
+ *
+ * Knows nothing about chambers; the scores it gives are the plain
+ * difference of the territories.
+ */
+#ifndef VORONOI_H_
+#define VORONOI_H_
+
+#include <vector>
+#include "BitBoard.h"
+
+class Voronoi {
+public:
+	//Positions per bot in computePairs().
+	static const int kNumPairPositions = 4;
+
+	Voronoi();
+
+	void initialize(TCellIndex iSize, TCellIndex iWidth);
+
+	/**
+	 * Split the open cells between me and the opponent.  Both
+	 * positions must be open on the board, and must differ.  The
+	 * territories are left in getMyTerritory(), etc.
+	 * @return score: (# cells I reach first) - (# cells the opponent
+	 *	reaches first); distanceToOpponent: twice the number of steps
+	 *	it took the frontiers to meet.
+	 */
+	CellBalance compute(const BitBoard& open, TCellIndex iMe, TCellIndex iOpponent);
+
+	//Results of the last compute(); both territories include
+	//the bot's own position.
+	const BitBoard& getMyTerritory() const			{ return myTerritory_;}
+	const BitBoard& getOpponentTerritory() const	{ return opponentTerritory_;}
+	const BitBoard& getNeutralCells() const			{ return neutralCells_;}
+
+	/**
+	 * Split the open cells by distance for every pair of my and the
+	 * opponent's positions.  A pair is numbered (index of my position)
+	 * + (index of the opponent's position) * kNumPairPositions, the same
+	 * way as the child steps.  Both positions of a needed pair must be
+	 * open on the board, and must differ; the other pairs are left
+	 * alone.  The territories are left in getMyPairTerritory(), etc.
+	 * @return the same as compute(), per pair.
+	 */
+	void computePairs(const BitBoard& open, const TCellIndex* iMyPositions, 
+		const TCellIndex* iOpponentPositions, const bool* isPairNeeded, CellBalance* balances);
+
+	/**
+	 * computePairs() for a single pair.  The territories are left in
+	 * getMyTerritory(), etc.; the neutral cells are not kept.
+	 */
+	CellBalance computeByDistance(const BitBoard& open, TCellIndex iMe, TCellIndex iOpponent);
+
+	//Results of the last computePairs(), for the needed pairs.
+	const BitBoard& getMyPairTerritory(int pair) const			{ return myPairTerritories_[pair];}
+	const BitBoard& getOpponentPairTerritory(int pair) const	{ return opponentPairTerritories_[pair];}
+
+private:
+	typedef BitBoard::TWord TWord;
+
+	//The buffers.
+	enum {
+		FREE_CELLS,			//Open, and not claimed by anyone yet.
+		MY_FRONTIER,
+		OPPONENT_FRONTIER,
+		MY_NEXT_FRONTIER,
+		OPPONENT_NEXT_FRONTIER,
+		MY_TERRITORY,
+		OPPONENT_TERRITORY,
+		NEUTRAL_CELLS,
+		NUM_BUFFERS
+	};
+
+	/**
+	 * Grow both frontiers by one step into the next frontier buffers.
+	 * @param haveMet: set if the territories touch.
+	 * @return whether either frontier has grown.
+	 */
+	bool growFrontiers(int myFrontier, int opponentFrontier, 
+		int myNextFrontier, int opponentNextFrontier, bool* haveMet);
+
+	static const int kNumPairs = kNumPairPositions * kNumPairPositions;
+
+	//The buffers for computePairs(); the positions are numbered
+	//mine first, then the opponent's.
+	enum {
+		POSITION_AREAS = 0,		//Cells within the current distance of a position.
+		POSITION_FRONTIERS = POSITION_AREAS + 2 * kNumPairPositions,
+		POSITION_NEXT_FRONTIERS = POSITION_FRONTIERS + 2 * kNumPairPositions,
+		MY_PAIR_TERRITORIES = POSITION_NEXT_FRONTIERS + 2 * kNumPairPositions,
+		OPPONENT_PAIR_TERRITORIES = MY_PAIR_TERRITORIES + kNumPairs,
+		NUM_PAIR_BUFFERS = OPPONENT_PAIR_TERRITORIES + kNumPairs
+	};
+
+	void copyResult(int iBuffer, BitBoard* board);
+	void copyWords(const TWord* words, BitBoard* board);
+
+	TWord* getBuffer(int iBuffer)		{ return &buffers_[iBuffer * bufferStride_ + numPaddingWords_];}
+	TWord* getPairBuffer(int iBuffer)	{ return &pairBuffers_[iBuffer * bufferStride_ + numPaddingWords_];}
+
+	TCellIndex iSize_;
+	TCellIndex iWidth_;
+	int numWords_;			//Words in a board, rounded up to whole lanes.
+	int numPaddingWords_;	//Zero words around each buffer for the shifts.
+	int bufferStride_;
+
+	//Padded copies of the boards, one after another.
+	std::vector<TWord> buffers_;
+	std::vector<TWord> pairBuffers_;
+
+	BitBoard myTerritory_;
+	BitBoard opponentTerritory_;
+	BitBoard neutralCells_;
+	std::vector<BitBoard> myPairTerritories_;
+	std::vector<BitBoard> opponentPairTerritories_;
+};
+
+#endif /* VORONOI_H_ */
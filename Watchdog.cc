@@ -0,0 +1,111 @@
+/*
+ * See Watchdog.h for explanations.
+ */
+
+#include "Map.h"
+#include "Watchdog.h"
+
+Watchdog::Watchdog()
+: lock_(), stateChanged_(), thread_(), isShuttingDown_(false), getMove_(NULL),
+deadline_(0), state_(IDLE), fallbackMove_(0), isSearchReady_(false), sentMove_(0), numMovesSent_(0) {
+}
+
+Watchdog::~Watchdog() {
+	lock_.lock();
+	isShuttingDown_ = true;
+	stateChanged_.broadcast();
+	lock_.unlock();
+
+	thread_.join();
+}
+
+bool Watchdog::start(const TMoveFunction getMove) {
+	getMove_ = getMove;
+	return thread_.start(&Watchdog::threadMain, this);
+}
+
+void Watchdog::arm(const TMicroseconds deadline, const int fallbackMove) {
+	MutexLock lock(lock_);
+
+	deadline_ = deadline;
+	state_ = ARMED;
+	fallbackMove_ = fallbackMove;
+	isSearchReady_ = false;
+	sentMove_ = 0;
+	stateChanged_.broadcast();
+}
+
+void Watchdog::watchInput() {
+	MutexLock lock(lock_);
+
+	state_ = WATCHING_INPUT;
+	sentMove_ = 0;
+	stateChanged_.broadcast();
+}
+
+void Watchdog::setSearchReady() {
+	MutexLock lock(lock_);
+	isSearchReady_ = true;
+}
+
+int Watchdog::disarm() {
+	MutexLock lock(lock_);
+
+	const int sentMove = (FIRED == state_ ? sentMove_ : 0);
+	state_ = IDLE;
+	return sentMove;
+}
+
+void* Watchdog::threadMain(void* argument) {
+	static_cast<Watchdog*>(argument)->run();
+	return NULL;
+}
+
+void Watchdog::run() {
+	lock_.lock();
+
+	while (!isShuttingDown_) {
+		if (WATCHING_INPUT == state_) {
+			//Cancelled while still watching, so that it can't be
+			//the next move's time out.
+			if (Map::IsInputPending()) {
+				CancelTimeOut();
+				state_ = IDLE;
+				continue;
+			}
+
+			lock_.unlock();
+			SleepMicroseconds(kPollMicroseconds);
+			lock_.lock();
+			continue;
+		}
+
+		if (ARMED != state_) {
+			stateChanged_.wait(lock_);
+			continue;
+		}
+
+		if (GetMonotonicTime() < deadline_) {
+			lock_.unlock();
+			SleepMicroseconds(kPollMicroseconds);
+			lock_.lock();
+			continue;
+		}
+
+		//Out of time; MakeMove() won't send anything once it
+		//sees that the state has changed.  The search is stopped
+		//first, so that it can't be told to go on afterwards.
+		state_ = FIRED;
+		sentMove_ = (isSearchReady_ ? getMove_() : fallbackMove_);
+		numMovesSent_++;
+		CancelTimeOut();
+
+		const int move = sentMove_;
+		lock_.unlock();
+
+		Map::MakeMove(move);
+		lock_.lock();
+	}
+
+	lock_.unlock();
+}
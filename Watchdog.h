@@ -0,0 +1,108 @@
+/*
+ * Sends my move at the hard deadline if MakeMove() hasn't sent it by
+ * then, e.g. because a long calculatePathScore() or GetCellBalance()
+ * call overran the time.  A late move loses the game; an early one
+ * that's not quite the best rarely does.
+ *
+ * The watchdog runs on its own thread.  While a move is being searched
+ * (between arm() and disarm()), it looks at the monotonic clock every
+ * kPollMicroseconds.  Once the deadline has passed, it sends the move
+ * that the search has published last (see
+ * StepEvaluator::getPublishedMove(), which takes no locks) through
+ * Map::MakeMove(), and cancels the time out so that the search gives
+ * up on the move at its next check.  disarm() then tells MakeMove()'s
+ * caller that the move has already been sent, and which one it was.
+ *
+ * The watchdog is armed as soon as the clock for the move starts,
+ * before the search has caught up with the new map; until
+ * setSearchReady(), it would send a fallback move instead.
+ *
+ * While the bot ponders, the watchdog also looks for the next map on
+ * stdin (see watchInput()), and cancels the time out as soon as it can
+ * be read.  The search only checks its stop function between
+ * evaluations, but playouts check the time out all along, so this gets
+ * the map read sooner; the move's clock only starts once it's read.
+ *
+ * In TEST_ENVIRONMENT there are no threads, and the watchdog never
+ * sends anything.
+ */
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include "Threads.h"
+#include "Timer.h"
+
+//Reads the move the search would make now.  Must not take any locks
+//held by the search.
+typedef int (*TMoveFunction)();
+
+class Watchdog {
+public:
+	//Time between the looks at the clock while armed.
+	static const int kPollMicroseconds = 1000;
+
+	Watchdog();
+	~Watchdog();
+
+	/**
+	 * Start the watchdog thread.
+	 * @param getMove: called on the watchdog thread to find the move to send.
+	 * @return whether the thread was started.
+	 */
+	bool start(TMoveFunction getMove);
+
+	/**
+	 * A move is being searched; send it once the monotonic clock
+	 * (see GetMonotonicTime()) passes the deadline.
+	 * @param fallbackMove: the move to send until setSearchReady().
+	 */
+	void arm(TMicroseconds deadline, int fallbackMove);
+
+	/**
+	 * The search is set up for the move, and publishes its own moves
+	 * from now on.
+	 */
+	void setSearchReady();
+
+	/**
+	 * The bot is pondering; cancel the time out once the next map
+	 * can be read (see Map::IsInputPending()).  Stopped by disarm().
+	 */
+	void watchInput();
+
+	/**
+	 * MakeMove() is done with the move, or Ponder() with pondering.
+	 * @return the move the watchdog has sent, or 0 if it hasn't
+	 *	and the caller should send its own.
+	 */
+	int disarm();
+
+	//Moves sent by the watchdog since the start.
+	int getNumMovesSent() const			{ return numMovesSent_;}
+
+private:
+	enum TState {
+		IDLE,
+		ARMED,
+		FIRED,
+		WATCHING_INPUT
+	};
+
+	static void* threadMain(void* argument);
+	void run();
+
+	Mutex lock_;
+	Condition stateChanged_;
+	Thread thread_;
+	bool isShuttingDown_;
+
+	TMoveFunction getMove_;
+	TMicroseconds deadline_;
+	TState state_;
+	int fallbackMove_;
+	bool isSearchReady_;
+	int sentMove_;
+	int numMovesSent_;
+};
+
+#endif /* WATCHDOG_H_ */
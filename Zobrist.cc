@@ -0,0 +1,34 @@
+#include "Zobrist.h"
+
+THashKey* g_wallKeys = NULL;
+THashKey* g_myKeys = NULL;
+THashKey* g_opponentKeys = NULL;
+
+/**
+ * xorshift64* generator.  Fixed seed, so that the keys (and 
+ * therefore the search) are the same from run to run.
+ */
+static THashKey NextRandomKey(THashKey& state) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+void InitZobristKeys(const TCellIndex size) {
+	delete[] g_wallKeys;
+	delete[] g_myKeys;
+	delete[] g_opponentKeys;
+
+	g_wallKeys = new THashKey[size];
+	g_myKeys = new THashKey[size];
+	g_opponentKeys = new THashKey[size];
+
+	THashKey state = 88172645463325252ULL;
+
+	for (TCellIndex iCell = 0; iCell < size; ++iCell) {
+		g_wallKeys[iCell] = NextRandomKey(state);
+		g_myKeys[iCell] = NextRandomKey(state);
+		g_opponentKeys[iCell] = NextRandomKey(state);
+	}
+}
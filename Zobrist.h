@@ -0,0 +1,50 @@
+/*
+ * Zobrist hashing of game positions.
+ *
+ * Every cell gets three random keys: one for a wall (a cell that
+ * either of the bots has already visited), one for my position
+ * and one for the opponent's position.  The hash of a position is
+ * the XOR of the keys of all walls placed during the game plus
+ * the keys of my and opponent's positions, so it can be updated 
+ * incrementally as the bots move.
+ *
+ * The walls that were on the map from the start are not part of
+ * the hash; positions are only compared within one game.
+ */
+#ifndef ZOBRIST_H_
+#define ZOBRIST_H_
+
+#include <vector>
+#include "MoveScore.h"
+
+typedef unsigned long long THashKey;
+
+extern THashKey* g_wallKeys;
+extern THashKey* g_myKeys;
+extern THashKey* g_opponentKeys;
+
+/**
+ * Generate the keys for a map of the given size.
+ */
+void InitZobristKeys(TCellIndex size);
+
+inline THashKey GetWallKey(const TCellIndex iCell) {
+	return g_wallKeys[iCell];
+}
+
+inline THashKey GetMyKey(const TCellIndex iCell) {
+	return g_myKeys[iCell];
+}
+
+inline THashKey GetOpponentKey(const TCellIndex iCell) {
+	return g_opponentKeys[iCell];
+}
+
+/**
+ * Hash of a position: the walls plus both bots' positions.
+ */
+inline THashKey GetPositionKey(const THashKey wallHash, const TCellIndex iMe, const TCellIndex iOpponent) {
+	return wallHash ^ g_myKeys[iMe] ^ g_opponentKeys[iOpponent];
+}
+
+#endif /* ZOBRIST_H_ */
@@ -0,0 +1,281 @@
+/*
+ * Offline benchmark: runs the step tree on a corpus of maps and
+ * reports how fast it searches, so that every change to the
+ * performance can be measured the same way.
+ *
+ * Build from the top directory (everything but MyTronBot.cc):
+ *	g++ -O2 -pthread -I. -o bench tools/Bench.cc $(ls *.cc | grep -v MyTronBot.cc)
+ *
+ * Usage:
+ *	bench [-t seconds] [-n evaluations] [-j threads] [-s samples]
+ *		[-c bottleneck|articulation] [-m frontier|distance] map...
+ *
+ * Each map is in the same format as the maps sent by the contest engine
+ * (see Map.h).  The search on each map runs from the starting position
+ * until the time (-t, 1 second by default) or the number of evaluations
+ * (-n, no limit by default) runs out.  Before the search, the bench
+ * times GetCellBalance() on every pair of my and the opponent's first
+ * moves, -s times over (100 by default).
+ *
+ * -c and -m pick how the cell balances split the map into chambers and
+ * territories (see TChamberMethod and TTerritoryMethod in MoveScore.h),
+ * both for the timed GetCellBalance() calls and for the search; the
+ * defaults are those of StepEvaluator.
+ *
+ * Prints one line per map, as a JSON object:
+ *	map, width, height, threads, chambers, territories,
+ *	seconds: time spent searching,
+ *	evaluations, evaluations_per_second, max_depth,
+ *	endgame_nodes: positions searched by the endgame solver, which
+ *		takes over from the step tree if the bots start out separated,
+ *	steps: steps in use at the end, and steps allocated in the pool,
+ *	cell_balance_us: percentiles of a GetCellBalance() call, in microseconds,
+ *	peak_rss_kb: peak resident memory of the process so far.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "Map.h"
+#include "StepEvaluator.h"
+#include "Timer.h"
+
+//The search stops once this many evaluations have been made; 0 for no limit.
+static int gMaxEvaluations = 0;
+static StepEvaluator* gStepEvaluator = NULL;
+
+/**
+ * Stop function for the search; called with the tree lock held.
+ */
+static bool HasUsedEvaluations() {
+	return (gMaxEvaluations > 0 && gStepEvaluator->getNumEvaluations() >= gMaxEvaluations);
+}
+
+struct BenchOptions {
+	double seconds;
+	int maxEvaluations;
+	int numThreads;
+	int numSamples;
+	TChamberMethod chamberMethod;
+	TTerritoryMethod territoryMethod;
+};
+
+static const char* const kChamberMethodNames[] = { "bottleneck", "articulation" };
+static const char* const kTerritoryMethodNames[] = { "frontier", "distance" };
+
+/**
+ * Look up a method by its name.
+ * @return the method's index, or -1 if there's no such name.
+ */
+static int FindMethod(const char* const names[], const int numNames, const char* name) {
+	for (int i = 0; i < numNames; ++i) {
+		if (0 == strcmp(names[i], name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Nanoseconds on the monotonic clock; GetMonotonicTime() is too
+ * coarse for a single GetCellBalance() call.
+ */
+static long long GetNanoseconds() {
+	timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	return static_cast<long long>(currentTime.tv_sec) * 1000000000LL + currentTime.tv_nsec;
+}
+
+static double GetPercentile(const std::vector<long long>& sortedValues, const int percent) {
+	if (sortedValues.empty()) {
+		return 0;
+	}
+
+	const size_t index = (sortedValues.size() - 1) * percent / 100;
+	return static_cast<double>(sortedValues[index]) / 1000.0;
+}
+
+/**
+ * Time GetCellBalance() on every pair of first moves, on a copy of
+ * the evaluator's map.
+ * @return the latencies in nanoseconds, sorted.
+ */
+static std::vector<long long> TimeCellBalances(StepEvaluator* stepEvaluator,
+											   const TCellIndex iSize,
+											   const BenchOptions& options) {
+	std::vector<long long> latencies;
+	std::vector<TCell> cCells(stepEvaluator->getCells(), stepEvaluator->getCells() + iSize);
+	ScoringContext* context = new ScoringContext(iSize);
+	context->chamberMethod_ = options.chamberMethod;
+	context->territoryMethod_ = options.territoryMethod;
+
+	const TCellIndex iMe = stepEvaluator->getMyPosition();
+	const TCellIndex iOpponent = stepEvaluator->getOpponentPosition();
+
+	for (int sample = 0; sample < options.numSamples; ++sample) {
+		for (int myDirection = UP; myDirection <= LEFT; ++myDirection) {
+			const TCellIndex iNewMe = GetNeighbour(iMe, myDirection);
+
+			for (int opponentDirection = UP; opponentDirection <= LEFT; ++opponentDirection) {
+				const TCellIndex iNewOpponent = GetNeighbour(iOpponent, opponentDirection);
+
+				if (!cCells[iNewMe] || !cCells[iNewOpponent] || iNewMe == iNewOpponent) {
+					continue;
+				}
+
+				const long long startTime = GetNanoseconds();
+				GetCellBalance(context, &cCells[0], iNewMe, iNewOpponent, iMe, iOpponent, true);
+				latencies.push_back(GetNanoseconds() - startTime);
+			}
+		}
+	}
+
+	delete context;
+	std::sort(latencies.begin(), latencies.end());
+	return latencies;
+}
+
+static bool RunMap(const char* mapFile, const BenchOptions& options) {
+	FILE* file = fopen(mapFile, "r");
+
+	if (NULL == file) {
+		fprintf(stderr, "Can't open %s\n", mapFile);
+		return false;
+	}
+
+	const Map map(file);
+	fclose(file);
+
+	if (!map.IsValid()) {
+		fprintf(stderr, "%s is not a valid map\n", mapFile);
+		return false;
+	}
+
+	StepEvaluator* stepEvaluator = new StepEvaluator();
+	stepEvaluator->initialize(map);
+	const TCellIndex iSize = static_cast<TCellIndex>(map.Width() * map.Height());
+	const std::vector<long long> latencies = TimeCellBalances(stepEvaluator, iSize, options);
+
+	stepEvaluator->setChamberMethod(options.chamberMethod);
+	stepEvaluator->setTerritoryMethod(options.territoryMethod);
+	stepEvaluator->setNumThreads(options.numThreads);
+	gStepEvaluator = stepEvaluator;
+	gMaxEvaluations = options.maxEvaluations;
+	stepEvaluator->setStopFunction(&HasUsedEvaluations);
+
+	//The first move's search, as in MakeMove().
+	SetTimeOut(options.seconds);
+	const TMicroseconds startTime = GetMonotonicTime();
+
+	while (!HasTimedOut() && !HasUsedEvaluations()) {
+		if (!stepEvaluator->performParallelEvaluations()) {
+			break;
+		}
+	}
+
+	const double seconds = static_cast<double>(GetMonotonicTime() - startTime) / 1000000.0;
+	const int numEvaluations = stepEvaluator->getNumEvaluations();
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("{\"map\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d, "
+		"\"chambers\": \"%s\", \"territories\": \"%s\", "
+		"\"seconds\": %.3f, \"evaluations\": %d, \"evaluations_per_second\": %.0f, \"max_depth\": %d, "
+		"\"endgame_nodes\": %d, "
+		"\"steps\": {\"in_use\": %d, \"allocated\": %d}, "
+		"\"cell_balance_us\": {\"samples\": %d, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, "
+		"\"peak_rss_kb\": %ld}\n",
+		mapFile, map.Width(), map.Height(), stepEvaluator->getNumThreads(),
+		kChamberMethodNames[options.chamberMethod], kTerritoryMethodNames[options.territoryMethod],
+		seconds, numEvaluations, (seconds > 0 ? numEvaluations / seconds : 0), stepEvaluator->getMaxDepth(),
+		stepEvaluator->getEndgameSolver().getNumNodes(),
+		stepEvaluator->getStepPool().getNumStepsInUse(), stepEvaluator->getStepPool().getNumSteps(),
+		static_cast<int>(latencies.size()), GetPercentile(latencies, 50), GetPercentile(latencies, 90),
+		GetPercentile(latencies, 99), GetPercentile(latencies, 100),
+		static_cast<long>(usage.ru_maxrss));
+	fflush(stdout);
+
+	delete stepEvaluator;
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	options.seconds = 0;
+	options.maxEvaluations = 0;
+	options.numThreads = 1;
+	options.numSamples = 100;
+	options.chamberMethod = BOTTLENECK_CHAMBERS;
+	options.territoryMethod = FRONTIER_TERRITORIES;
+
+	std::vector<const char*> mapFiles;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = (i + 1 < argc);
+
+		if (0 == strcmp(argv[i], "-t") && hasValue) {
+			options.seconds = atof(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-n") && hasValue) {
+			options.maxEvaluations = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-j") && hasValue) {
+			options.numThreads = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-s") && hasValue) {
+			options.numSamples = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-c") && hasValue) {
+			const int method = FindMethod(kChamberMethodNames, 2, argv[++i]);
+
+			if (method < 0) {
+				fprintf(stderr, "Unknown chamber method %s\n", argv[i]);
+				return 1;
+			}
+
+			options.chamberMethod = static_cast<TChamberMethod>(method);
+
+		} else if (0 == strcmp(argv[i], "-m") && hasValue) {
+			const int method = FindMethod(kTerritoryMethodNames, 2, argv[++i]);
+
+			if (method < 0) {
+				fprintf(stderr, "Unknown territory method %s\n", argv[i]);
+				return 1;
+			}
+
+			options.territoryMethod = static_cast<TTerritoryMethod>(method);
+
+		} else {
+			mapFiles.push_back(argv[i]);
+		}
+	}
+
+	if (mapFiles.empty()) {
+		fprintf(stderr, "Usage: bench [-t seconds] [-n evaluations] [-j threads] [-s samples]"
+			" [-c bottleneck|articulation] [-m frontier|distance] map...\n");
+		return 1;
+	}
+
+	//With a budget of evaluations and no time given, the time is
+	//only a safety net.
+	if (options.seconds <= 0) {
+		options.seconds = (options.maxEvaluations > 0 ? 3600 : 1.0);
+	}
+
+	int numFailures = 0;
+
+	for (size_t i = 0; i < mapFiles.size(); ++i) {
+		if (!RunMap(mapFiles[i], options)) {
+			numFailures++;
+		}
+	}
+
+	return (0 == numFailures ? 0 : 1);
+}
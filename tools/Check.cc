@@ -0,0 +1,822 @@
+/*
+ * Offline check of the bit-parallel and graph code against plain
+ * references on random boards: the Voronoi kernel (both splits), the
+ * articulation chambers and the endgame solver.  The references are
+ * written the slow and obvious way, one cell at a time, so that any
+ * change to the lane code or the chamber fill can be checked the
+ * same way.
+ *
+ * Build from the top directory, like the bench:
+ *	g++ -O2 -pthread -I. -o check tools/Check.cc $(ls *.cc | grep -v MyTronBot.cc)
+ * The Voronoi lanes are picked when compiling (see Voronoi.cc), so
+ * build it again with -mavx2 for the AVX2 lanes, and with -U__SSE2__
+ * for the plain 64-bit words.
+ *
+ * Usage:
+ *	check [-n boards] [-s seed]
+ *
+ * Each check runs on -n random boards (2000 by default), made from
+ * the random seed -s (1 by default):
+ *	voronoi: Voronoi::compute() against a scalar search from both
+ *		bots at once, at widths 7, 20, 64 and 130;
+ *	voronoi_pairs: Voronoi::computePairs() and computeByDistance()
+ *		against a scalar distance map from each position; where the
+ *		positions are on cells of different colours, also against
+ *		compute();
+ *	chambers: ArticulationChambers::build() on a bot's territory:
+ *		the chamber sizes add up to the territory, the fill is the
+ *		best path down the tree of chambers, and every chamber is
+ *		cut off without its entrance;
+ *	chamber_bound: the fill is an upper bound on the longest path,
+ *		found by brute force on small areas;
+ *	endgame: EndgameSolver finds the longest path, also when it's
+ *		interrupted and resumed, and after a move.
+ *
+ * Prints one line per check, as a JSON object:
+ *	check, lanes, boards, mismatches, and for chamber_bound the number
+ *	of boards where the bound is exact.
+ * The first few mismatches are described on stderr.  Exits with 1 if
+ * any check has a mismatch.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "MoveScore.h"
+#include "BitBoard.h"
+#include "Voronoi.h"
+#include "Chambers.h"
+#include "EndgameSolver.h"
+#include "Zobrist.h"
+#include "Timer.h"
+
+#if defined(__AVX2__)
+static const char* const kLanes = "avx2";
+#elif defined(__SSE2__)
+static const char* const kLanes = "sse2";
+#else
+static const char* const kLanes = "words";
+#endif
+
+//Mismatches described on stderr per check.
+static const int kMaxReportedMismatches = 5;
+
+//Owners of a cell in the reference split.
+enum {
+	NOBODY = 0,
+	ME = 1,
+	OPPONENT = 2,
+	NEUTRAL = ME | OPPONENT
+};
+
+static const int kUnreachable = -1;
+
+/**
+ * xorshift64* generator, as in Zobrist.cc.
+ */
+static unsigned long long gRandomState = 1;
+
+static int GetRandom(const int limit) {
+	gRandomState ^= gRandomState >> 12;
+	gRandomState ^= gRandomState << 25;
+	gRandomState ^= gRandomState >> 27;
+	return static_cast<int>(((gRandomState * 2685821657736338717ULL) >> 33) % limit);
+}
+
+/**
+ * A random board: walls all around, and wallPercent of the cells
+ * inside are walls.  Sets up the map dimensions for GetNeighbour(),
+ * GetCellColor() and the Zobrist keys.
+ */
+struct Board {
+	int width;
+	int height;
+	std::vector<TCell> cCells;
+
+	Board(const int width, const int height, const int wallPercent)
+	: width(width), height(height), cCells(width * height, WALL) {
+		for (int y = 1; y < height - 1; ++y) {
+			for (int x = 1; x < width - 1; ++x) {
+				cCells[y * width + x] = (GetRandom(100) < wallPercent ? WALL : 1);
+			}
+		}
+
+		delete InitMoveScoreCalculator(width * height, width);
+		InitZobristKeys(width * height);
+	}
+
+	TCellIndex getSize() const	{ return static_cast<TCellIndex>(cCells.size());}
+
+	TCellIndex getNeighbour(const TCellIndex iCell, const int direction) const {
+		static const int kDx[] = { 0, 0, 1, 0, -1 };
+		static const int kDy[] = { 0, -1, 0, 1, 0 };
+		return iCell + kDy[direction] * width + kDx[direction];
+	}
+
+	bool isBlack(const TCellIndex iCell) const	{ return ((iCell % width + iCell / width) % 2 == 0);}
+
+	/**
+	 * A random open cell, or NO_INDEX if there are none.
+	 */
+	TCellIndex getRandomOpenCell() const {
+		std::vector<TCellIndex> iOpenCells;
+
+		for (TCellIndex iCell = 0; iCell < this->getSize(); ++iCell) {
+			if (WALL != cCells[iCell]) {
+				iOpenCells.push_back(iCell);
+			}
+		}
+
+		return (iOpenCells.empty() ? NO_INDEX : iOpenCells[GetRandom(static_cast<int>(iOpenCells.size()))]);
+	}
+
+	BitBoard getBitBoard() const {
+		BitBoard board;
+		board.initialize(this->getSize(), width);
+		board.copyCells(&cCells[0]);
+		return board;
+	}
+};
+
+struct CheckResult {
+	const char* name;
+	int numBoards;
+	int numMismatches;
+	int numExact;
+
+	explicit CheckResult(const char* name)
+	: name(name), numBoards(0), numMismatches(0), numExact(-1) {
+	}
+
+	void addMismatch(const int board, const char* what) {
+		if (numMismatches < kMaxReportedMismatches) {
+			fprintf(stderr, "%s: board %d: %s\n", name, board, what);
+		}
+
+		numMismatches++;
+	}
+
+	void print() const {
+		printf("{\"check\": \"%s\", \"lanes\": \"%s\", \"boards\": %d, \"mismatches\": %d",
+			name, kLanes, numBoards, numMismatches);
+
+		if (numExact >= 0) {
+			printf(", \"exact\": %d", numExact);
+		}
+
+		printf("}\n");
+		fflush(stdout);
+	}
+};
+
+/**
+ * Cells reachable from iStart over the open cells, by the number of
+ * steps it takes; iStart itself is 0 whether it's open or not.
+ */
+static std::vector<int> GetDistances(const Board& board, const std::vector<bool>& isOpen, const TCellIndex iStart) {
+	std::vector<int> distances(board.getSize(), kUnreachable);
+	std::vector<TCellIndex> que(1, iStart);
+	distances[iStart] = 0;
+
+	for (size_t i = 0; i < que.size(); ++i) {
+		for (int direction = UP; direction <= LEFT; ++direction) {
+			const TCellIndex iNeighbour = board.getNeighbour(que[i], direction);
+
+			if (isOpen[iNeighbour] && kUnreachable == distances[iNeighbour]) {
+				distances[iNeighbour] = distances[que[i]] + 1;
+				que.push_back(iNeighbour);
+			}
+		}
+	}
+
+	return distances;
+}
+
+static std::vector<bool> GetOpenCells(const Board& board) {
+	std::vector<bool> isOpen(board.getSize());
+
+	for (TCellIndex iCell = 0; iCell < board.getSize(); ++iCell) {
+		isOpen[iCell] = (WALL != board.cCells[iCell]);
+	}
+
+	return isOpen;
+}
+
+/**
+ * Whether the cells owned by owner are exactly the ones on the BitBoard.
+ */
+static bool IsSameArea(const std::vector<char>& owners, const char owner, const BitBoard& area) {
+	for (TCellIndex iCell = 0; iCell < static_cast<TCellIndex>(owners.size()); ++iCell) {
+		if ((owners[iCell] == owner) != area.isOpen(iCell)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int CountOwned(const std::vector<char>& owners, const char owner) {
+	int numCells = 0;
+
+	for (size_t i = 0; i < owners.size(); ++i) {
+		numCells += (owners[i] == owner ? 1 : 0);
+	}
+
+	return numCells;
+}
+
+/**
+ * Reference for Voronoi::compute(): both bots take one step at a time
+ * into the cells nobody has claimed; the cells they reach on the same
+ * step are neutral, and nobody goes on from them.
+ */
+static CellBalance SplitByFrontiers(const Board& board, const TCellIndex iMe, const TCellIndex iOpponent,
+									std::vector<char>* owners) {
+	std::vector<bool> isFree = GetOpenCells(board);
+	owners->assign(board.getSize(), NOBODY);
+	isFree[iMe] = false;
+	isFree[iOpponent] = false;
+	(*owners)[iMe] = ME;
+	(*owners)[iOpponent] = OPPONENT;
+
+	std::vector<TCellIndex> frontiers[3];
+	frontiers[ME].push_back(iMe);
+	frontiers[OPPONENT].push_back(iOpponent);
+
+	int numSteps = 0;
+	int numStepsToMeet = 0;
+	bool haveMet = false;
+
+	while (true) {
+		numSteps++;
+
+		//Who reaches which free cell on this step.
+		std::vector<char> reachedBy(board.getSize(), NOBODY);
+		std::vector<TCellIndex> iReachedCells;
+
+		for (int bot = ME; bot <= OPPONENT; ++bot) {
+			const int otherBot = (ME == bot ? OPPONENT : ME);
+
+			for (size_t i = 0; i < frontiers[bot].size(); ++i) {
+				for (int direction = UP; direction <= LEFT; ++direction) {
+					const TCellIndex iNeighbour = board.getNeighbour(frontiers[bot][i], direction);
+
+					if (isFree[iNeighbour]) {
+						if (NOBODY == reachedBy[iNeighbour]) {
+							iReachedCells.push_back(iNeighbour);
+						}
+
+						reachedBy[iNeighbour] |= bot;
+
+					} else if (otherBot == (*owners)[iNeighbour]) {
+						haveMet = true;
+					}
+				}
+			}
+		}
+
+		frontiers[ME].clear();
+		frontiers[OPPONENT].clear();
+
+		for (size_t i = 0; i < iReachedCells.size(); ++i) {
+			const TCellIndex iCell = iReachedCells[i];
+			isFree[iCell] = false;
+			(*owners)[iCell] = reachedBy[iCell];
+
+			if (NEUTRAL == reachedBy[iCell]) {
+				haveMet = true;
+			} else {
+				frontiers[static_cast<int>(reachedBy[iCell])].push_back(iCell);
+			}
+		}
+
+		if (haveMet && 0 == numStepsToMeet) {
+			numStepsToMeet = numSteps;
+		}
+
+		if (frontiers[ME].empty() && frontiers[OPPONENT].empty()) {
+			break;
+		}
+	}
+
+	CellBalance balance;
+	balance.score = static_cast<TMoveScore>(CountOwned(*owners, ME) - CountOwned(*owners, OPPONENT));
+	balance.areSeparated = !haveMet;
+	balance.distanceToOpponent = 2 * numStepsToMeet;
+	return balance;
+}
+
+/**
+ * Reference for Voronoi::computePairs(): a cell is mine if it's
+ * closer to me than to the opponent, and the other way around.
+ */
+static CellBalance SplitByDistance(const Board& board, const std::vector<bool>& isOpen,
+								   const TCellIndex iMe, const TCellIndex iOpponent,
+								   std::vector<char>* owners) {
+	const std::vector<int> myDistances = GetDistances(board, isOpen, iMe);
+	const std::vector<int> opponentDistances = GetDistances(board, isOpen, iOpponent);
+	owners->assign(board.getSize(), NOBODY);
+
+	for (TCellIndex iCell = 0; iCell < board.getSize(); ++iCell) {
+		const int myDistance = myDistances[iCell];
+		const int opponentDistance = opponentDistances[iCell];
+
+		if (kUnreachable != myDistance && (kUnreachable == opponentDistance || myDistance < opponentDistance)) {
+			(*owners)[iCell] = ME;
+		} else if (kUnreachable != opponentDistance && (kUnreachable == myDistance || opponentDistance < myDistance)) {
+			(*owners)[iCell] = OPPONENT;
+		}
+	}
+
+	//The frontiers of compute() meet halfway between the bots.
+	const int distance = opponentDistances[iMe];
+
+	CellBalance balance;
+	balance.score = static_cast<TMoveScore>(CountOwned(*owners, ME) - CountOwned(*owners, OPPONENT));
+	balance.areSeparated = (kUnreachable == distance);
+	balance.distanceToOpponent = (kUnreachable == distance ? 0 : 2 * ((distance + 1) / 2));
+	return balance;
+}
+
+static bool IsSameBalance(const CellBalance& balance, const CellBalance& expectedBalance) {
+	return (balance.score == expectedBalance.score
+		&& balance.areSeparated == expectedBalance.areSeparated
+		&& balance.distanceToOpponent == expectedBalance.distanceToOpponent);
+}
+
+static void CheckVoronoi(const int numBoards, CheckResult* result) {
+	static const int kWidths[] = { 7, 20, 64, 130 };
+
+	for (int i = 0; i < numBoards; ++i) {
+		const int width = kWidths[i % 4];
+		Board board(width, 5 + GetRandom(width < 40 ? width : 40), GetRandom(50));
+		const TCellIndex iMe = board.getRandomOpenCell();
+		const TCellIndex iOpponent = board.getRandomOpenCell();
+
+		if (NO_INDEX == iMe || iMe == iOpponent) {
+			continue;
+		}
+
+		Voronoi voronoi;
+		voronoi.initialize(board.getSize(), width);
+		const CellBalance balance = voronoi.compute(board.getBitBoard(), iMe, iOpponent);
+
+		std::vector<char> owners;
+		const CellBalance expectedBalance = SplitByFrontiers(board, iMe, iOpponent, &owners);
+		result->numBoards++;
+
+		if (!IsSameArea(owners, ME, voronoi.getMyTerritory())
+			|| !IsSameArea(owners, OPPONENT, voronoi.getOpponentTerritory())
+			|| !IsSameArea(owners, NEUTRAL, voronoi.getNeutralCells())) {
+
+			result->addMismatch(i, "territories differ");
+
+		} else if (!IsSameBalance(balance, expectedBalance)) {
+			result->addMismatch(i, "balances differ");
+		}
+	}
+}
+
+static void CheckVoronoiPairs(const int numBoards, CheckResult* result) {
+	static const int kWidths[] = { 7, 20, 64, 130 };
+
+	for (int i = 0; i < numBoards; ++i) {
+		const int width = kWidths[i % 4];
+		Board board(width, 5 + GetRandom(width < 40 ? width : 40), GetRandom(50));
+		const TCellIndex iMe = board.getRandomOpenCell();
+		const TCellIndex iOpponent = board.getRandomOpenCell();
+
+		if (NO_INDEX == iMe || iMe == iOpponent) {
+			continue;
+		}
+
+		//As in the search: the bots have left walls on their positions,
+		//and the pairs are their next moves.
+		board.cCells[iMe] = WALL;
+		board.cCells[iOpponent] = WALL;
+		const BitBoard open = board.getBitBoard();
+		const std::vector<bool> isOpen = GetOpenCells(board);
+
+		TCellIndex iMyPositions[Voronoi::kNumPairPositions];
+		TCellIndex iOpponentPositions[Voronoi::kNumPairPositions];
+		bool isPairNeeded[Voronoi::kNumPairPositions * Voronoi::kNumPairPositions];
+		CellBalance balances[Voronoi::kNumPairPositions * Voronoi::kNumPairPositions];
+		int numPairs = 0;
+
+		for (int direction = UP; direction <= LEFT; ++direction) {
+			iMyPositions[direction - 1] = board.getNeighbour(iMe, direction);
+			iOpponentPositions[direction - 1] = board.getNeighbour(iOpponent, direction);
+		}
+
+		for (int pair = 0; pair < Voronoi::kNumPairPositions * Voronoi::kNumPairPositions; ++pair) {
+			const TCellIndex iMyPosition = iMyPositions[pair % Voronoi::kNumPairPositions];
+			const TCellIndex iOpponentPosition = iOpponentPositions[pair / Voronoi::kNumPairPositions];
+
+			isPairNeeded[pair] = (isOpen[iMyPosition] && isOpen[iOpponentPosition]
+				&& iMyPosition != iOpponentPosition && GetRandom(4) > 0);
+			numPairs += (isPairNeeded[pair] ? 1 : 0);
+		}
+
+		if (0 == numPairs) {
+			continue;
+		}
+
+		Voronoi voronoi;
+		voronoi.initialize(board.getSize(), width);
+		voronoi.computePairs(open, iMyPositions, iOpponentPositions, isPairNeeded, balances);
+		result->numBoards++;
+
+		for (int pair = 0; pair < Voronoi::kNumPairPositions * Voronoi::kNumPairPositions; ++pair) {
+			if (!isPairNeeded[pair]) {
+				continue;
+			}
+
+			const TCellIndex iMyPosition = iMyPositions[pair % Voronoi::kNumPairPositions];
+			const TCellIndex iOpponentPosition = iOpponentPositions[pair / Voronoi::kNumPairPositions];
+			std::vector<char> owners;
+			const CellBalance expectedBalance = SplitByDistance(board, isOpen, iMyPosition, iOpponentPosition, &owners);
+
+			if (!IsSameArea(owners, ME, voronoi.getMyPairTerritory(pair))
+				|| !IsSameArea(owners, OPPONENT, voronoi.getOpponentPairTerritory(pair))) {
+
+				result->addMismatch(i, "pair territories differ");
+				break;
+			}
+
+			if (!IsSameBalance(balances[pair], expectedBalance)) {
+				result->addMismatch(i, "pair balances differ");
+				break;
+			}
+
+			//No cell is as far from one bot as from the other.
+			if (board.isBlack(iMyPosition) != board.isBlack(iOpponentPosition)) {
+				std::vector<char> frontierOwners;
+				SplitByFrontiers(board, iMyPosition, iOpponentPosition, &frontierOwners);
+
+				if (frontierOwners != owners) {
+					result->addMismatch(i, "pair territories differ from compute() on different colours");
+					break;
+				}
+			}
+		}
+
+		//A single pair, on a fresh kernel.
+		const int pair = GetRandom(Voronoi::kNumPairPositions * Voronoi::kNumPairPositions);
+
+		if (isPairNeeded[pair]) {
+			const TCellIndex iMyPosition = iMyPositions[pair % Voronoi::kNumPairPositions];
+			const TCellIndex iOpponentPosition = iOpponentPositions[pair / Voronoi::kNumPairPositions];
+			Voronoi singleVoronoi;
+			singleVoronoi.initialize(board.getSize(), width);
+
+			const CellBalance balance = singleVoronoi.computeByDistance(open, iMyPosition, iOpponentPosition);
+
+			if (!IsSameBalance(balance, balances[pair])
+				|| 0 != memcmp(singleVoronoi.getMyTerritory().getWords(), voronoi.getMyPairTerritory(pair).getWords(),
+					open.getNumWords() * sizeof(BitBoard::TWord))
+				|| 0 != memcmp(singleVoronoi.getOpponentTerritory().getWords(), voronoi.getOpponentPairTerritory(pair).getWords(),
+					open.getNumWords() * sizeof(BitBoard::TWord))) {
+
+				result->addMismatch(i, "computeByDistance() differs from computePairs()");
+			}
+		}
+	}
+}
+
+/**
+ * Most cells a path can visit among numCells cells, numBlackCells of
+ * them black, if it starts on a black cell or not.
+ */
+static int GetReferenceParityBound(const int numCells, const int numBlackCells, const bool startsOnBlack) {
+	const int numStartCells = (startsOnBlack ? numBlackCells : numCells - numBlackCells);
+	const int numOtherCells = numCells - numStartCells;
+	return (numStartCells > numOtherCells ? 2 * numOtherCells + 1 : 2 * numStartCells);
+}
+
+/**
+ * Most moves a path from iCell can make over the open cells that can
+ * be reached from it: no more than there are cells, and no more than
+ * their colours allow.
+ */
+static int GetReachableBound(const Board& board, const std::vector<bool>& isOpen, const TCellIndex iCell) {
+	const std::vector<int> distances = GetDistances(board, isOpen, iCell);
+	int numCells = 0;
+	int numBlackCells = 0;
+
+	for (TCellIndex iReached = 0; iReached < board.getSize(); ++iReached) {
+		if (kUnreachable != distances[iReached] && iReached != iCell) {
+			numCells++;
+			numBlackCells += (board.isBlack(iReached) ? 1 : 0);
+		}
+	}
+
+	return GetReferenceParityBound(numCells, numBlackCells, !board.isBlack(iCell));
+}
+
+/**
+ * Longest path from iCell over the open cells, in moves; iCell itself
+ * must not be open.  Cut off only where even all the cells that can
+ * still be reached can't make the path longer; the chambers are left
+ * out on purpose.
+ */
+static void FindLongestPath(const Board& board, std::vector<bool>& isOpen, const TCellIndex iCell,
+							const int depth, int* longestPath) {
+	if (depth > *longestPath) {
+		*longestPath = depth;
+	}
+
+	if (depth + GetReachableBound(board, isOpen, iCell) <= *longestPath) {
+		return;
+	}
+
+	for (int direction = UP; direction <= LEFT; ++direction) {
+		const TCellIndex iNeighbour = board.getNeighbour(iCell, direction);
+
+		if (isOpen[iNeighbour]) {
+			isOpen[iNeighbour] = false;
+			FindLongestPath(board, isOpen, iNeighbour, depth + 1, longestPath);
+			isOpen[iNeighbour] = true;
+		}
+	}
+}
+
+static int GetLongestPath(const Board& board, const TCellIndex iStart) {
+	std::vector<bool> isOpen = GetOpenCells(board);
+	isOpen[iStart] = false;
+	int longestPath = 0;
+	FindLongestPath(board, isOpen, iStart, 0, &longestPath);
+	return longestPath;
+}
+
+/**
+ * Check the tree of chambers from the last build().
+ * @return what's wrong, or NULL.
+ */
+static const char* CheckChamberTree(const Board& board, const BitBoard& territory, const TCellIndex iStart,
+									const ArticulationChambers& chambers, const int fill) {
+	std::vector<bool> isOpen(board.getSize());
+
+	for (TCellIndex iCell = 0; iCell < board.getSize(); ++iCell) {
+		isOpen[iCell] = territory.isOpen(iCell);
+	}
+
+	isOpen[iStart] = true;
+	const std::vector<int> distances = GetDistances(board, isOpen, iStart);
+	const int numChambers = chambers.getNumChambers();
+	std::vector<int> numCells(numChambers, 0);
+	std::vector<int> numBlackCells(numChambers, 0);
+
+	for (TCellIndex iCell = 0; iCell < board.getSize(); ++iCell) {
+		const int chamber = chambers.getChamber(iCell);
+
+		if ((kUnreachable != distances[iCell]) != (chamber >= 0)) {
+			return "chambers don't cover the reachable cells";
+		}
+
+		if (chamber >= 0) {
+			numCells[chamber]++;
+			numBlackCells[chamber] += (board.isBlack(iCell) ? 1 : 0);
+		}
+	}
+
+	//Children come after their parents.
+	std::vector<int> bestChildFills(numChambers, 0);
+	int expectedFill = 0;
+
+	for (int chamber = numChambers - 1; chamber >= 0; --chamber) {
+		if (numCells[chamber] != chambers.getChamberSize(chamber)) {
+			return "chamber sizes don't add up to the territory";
+		}
+
+		//A chamber is entered on the colour opposite its entrance.
+		const TCellIndex iEntrance = chambers.getChamberEntrance(chamber);
+		const bool startsOnBlack = (0 == chamber ? board.isBlack(iStart) : !board.isBlack(iEntrance));
+		const int chamberFill = GetReferenceParityBound(numCells[chamber], numBlackCells[chamber], startsOnBlack)
+			+ bestChildFills[chamber];
+
+		if (0 == chamber) {
+			expectedFill = chamberFill;
+			continue;
+		}
+
+		const int parent = chambers.getParentChamber(chamber);
+
+		if (parent < 0 || parent >= chamber || chambers.getChamber(iEntrance) != parent) {
+			return "chamber's parent is wrong";
+		}
+
+		if (chamberFill > bestChildFills[parent]) {
+			bestChildFills[parent] = chamberFill;
+		}
+
+		//Without the entrance, there's no way in.
+		if (iEntrance != iStart) {
+			isOpen[iEntrance] = false;
+			const std::vector<int> cutDistances = GetDistances(board, isOpen, iStart);
+			isOpen[iEntrance] = true;
+
+			for (TCellIndex iCell = 0; iCell < board.getSize(); ++iCell) {
+				if (chambers.getChamber(iCell) == chamber && kUnreachable != cutDistances[iCell]) {
+					return "chamber is reachable without its entrance";
+				}
+			}
+		}
+	}
+
+	return (fill == expectedFill ? NULL : "fill isn't the best path down the tree of chambers");
+}
+
+static void CheckChambers(const int numBoards, CheckResult* result) {
+	for (int i = 0; i < numBoards; ++i) {
+		const int width = 7 + GetRandom(30);
+		Board board(width, 5 + GetRandom(30), GetRandom(50));
+		const TCellIndex iMe = board.getRandomOpenCell();
+		const TCellIndex iOpponent = board.getRandomOpenCell();
+
+		if (NO_INDEX == iMe || iMe == iOpponent) {
+			continue;
+		}
+
+		//My territory as GetCellBalance() builds it; half the time
+		//without my own position.
+		Voronoi voronoi;
+		voronoi.initialize(board.getSize(), width);
+		voronoi.compute(board.getBitBoard(), iMe, iOpponent);
+		BitBoard territory = voronoi.getMyTerritory();
+
+		if (GetRandom(2) > 0) {
+			territory.removeCell(iMe);
+		}
+
+		ArticulationChambers chambers;
+		chambers.initialize(board.getSize());
+		const int fill = chambers.build(territory, iMe);
+		result->numBoards++;
+
+		const char* error = CheckChamberTree(board, territory, iMe, chambers, fill);
+
+		if (NULL != error) {
+			result->addMismatch(i, error);
+		}
+	}
+}
+
+static void CheckChamberBound(const int numBoards, CheckResult* result) {
+	result->numExact = 0;
+
+	for (int i = 0; i < numBoards; ++i) {
+		Board board(5 + GetRandom(6), 5 + GetRandom(6), 15 + GetRandom(30));
+		const TCellIndex iMe = board.getRandomOpenCell();
+
+		if (NO_INDEX == iMe) {
+			continue;
+		}
+
+		//As in the endgame solver: my position is a wall.
+		board.cCells[iMe] = WALL;
+		ArticulationChambers chambers;
+		chambers.initialize(board.getSize());
+		const int fill = chambers.build(board.getBitBoard(), iMe);
+		const int longestPath = GetLongestPath(board, iMe);
+		result->numBoards++;
+
+		if (fill < longestPath + 1) {
+			result->addMismatch(i, "fill is shorter than the longest path");
+		} else if (fill == longestPath + 1) {
+			result->numExact++;
+		}
+	}
+}
+
+//Stop checks left before an interrupted solve stops.
+static int gNumStopChecksLeft = 0;
+
+static bool IsInterrupted() {
+	return (--gNumStopChecksLeft <= 0);
+}
+
+/**
+ * Whether the solver's best path goes over open cells only, and is as
+ * long as the longest path.
+ */
+static bool IsLongestPath(const Board& board, const EndgameSolver& solver, const TCellIndex iStart) {
+	const std::vector<char>& path = solver.getBestPath();
+	std::vector<bool> isOpen = GetOpenCells(board);
+	TCellIndex iCell = iStart;
+
+	for (size_t i = 0; i < path.size(); ++i) {
+		iCell = GetNeighbour(iCell, path[i]);
+
+		if (!isOpen[iCell]) {
+			return false;
+		}
+
+		isOpen[iCell] = false;
+	}
+
+	return (static_cast<int>(path.size()) == GetLongestPath(board, iStart));
+}
+
+static void CheckEndgame(const int numBoards, CheckResult* result) {
+	//Every solve here is meant to finish.
+	SetTimeOut(3600);
+
+	for (int i = 0; i < numBoards; ++i) {
+		Board board(7 + GetRandom(4), 7 + GetRandom(4), 15 + GetRandom(30));
+		TCellIndex iMe = board.getRandomOpenCell();
+
+		if (NO_INDEX == iMe) {
+			continue;
+		}
+
+		board.cCells[iMe] = WALL;
+		EndgameSolver solver;
+		solver.initialize(board.getSize(), board.width);
+		solver.start(&board.cCells[0], iMe);
+		result->numBoards++;
+
+		//Half the solves are interrupted every few nodes.
+		const bool isInterrupted = (GetRandom(2) > 0);
+		int numSolves = 0;
+
+		do {
+			gNumStopChecksLeft = 1 + GetRandom(20);
+			numSolves++;
+		} while (!solver.solve(isInterrupted ? &IsInterrupted : NULL) && numSolves < 100000);
+
+		if (!solver.isSolved() || !IsLongestPath(board, solver, iMe)) {
+			result->addMismatch(i, (isInterrupted ? "interrupted solve isn't the longest path"
+				: "solve isn't the longest path"));
+			continue;
+		}
+
+		//Move along the best path or elsewhere, and solve again.
+		std::vector<int> directions;
+
+		for (int direction = UP; direction <= LEFT; ++direction) {
+			if (WALL != board.cCells[GetNeighbour(iMe, direction)]) {
+				directions.push_back(direction);
+			}
+		}
+
+		if (directions.empty()) {
+			continue;
+		}
+
+		iMe = GetNeighbour(iMe, directions[GetRandom(static_cast<int>(directions.size()))]);
+		board.cCells[iMe] = WALL;
+		solver.advance(iMe);
+
+		if (!solver.solve(NULL) || !IsLongestPath(board, solver, iMe)) {
+			result->addMismatch(i, "solve after a move isn't the longest path");
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	int numBoards = 2000;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = (i + 1 < argc);
+
+		if (0 == strcmp(argv[i], "-n") && hasValue) {
+			numBoards = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-s") && hasValue) {
+			gRandomState = strtoull(argv[++i], NULL, 10);
+
+		} else {
+			fprintf(stderr, "Usage: check [-n boards] [-s seed]\n");
+			return 1;
+		}
+	}
+
+	//xorshift never leaves zero.
+	if (0 == gRandomState) {
+		gRandomState = 1;
+	}
+
+	CheckResult results[] = { CheckResult("voronoi"), CheckResult("voronoi_pairs"),
+		CheckResult("chambers"), CheckResult("chamber_bound"), CheckResult("endgame") };
+
+	CheckVoronoi(numBoards, &results[0]);
+	results[0].print();
+	CheckVoronoiPairs(numBoards, &results[1]);
+	results[1].print();
+	CheckChambers(numBoards, &results[2]);
+	results[2].print();
+	CheckChamberBound(numBoards, &results[3]);
+	results[3].print();
+	CheckEndgame(numBoards, &results[4]);
+	results[4].print();
+
+	int numMismatches = 0;
+
+	for (int i = 0; i < 5; ++i) {
+		numMismatches += results[i].numMismatches;
+	}
+
+	return (0 == numMismatches ? 0 : 1);
+}
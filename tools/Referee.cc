@@ -0,0 +1,726 @@
+/*
+ * Local referee: plays two bots against each other the way the contest
+ * engine does, on a corpus of maps, many games at a time.
+ *
+ * Build from the top directory:
+ *	g++ -O2 -o referee tools/Referee.cc
+ *
+ * Usage:
+ *	referee [-g games] [-j jobs] [-T seconds] [-t seconds] bot1 bot2 map...
+ *
+ * bot1 and bot2 are shell commands, e.g. "./MyTronBot -x", run through
+ * "exec", so that the referee can time and stop the bot itself; wrap
+ * anything but a single command in "sh -c '...'".  Each map is in
+ * the format that Map.h reads, with '1' and '2' at the starting
+ * positions.  Every map is played -g times (2 by default), with the bots
+ * swapping the starting positions from one game to the next.  Up to -j
+ * games (1 by default) are played at the same time, each in its own
+ * process.
+ *
+ * MyTronBot runs a search thread per core, and keeps searching while
+ * the opponent thinks, so a single game already keeps every core busy;
+ * more games at a time would only starve the bots, and inflate the
+ * deadline misses and the CPU time per move.  To play several games at
+ * a time, cap the bots' threads with the TRONBOT_THREADS environment
+ * variable, which the bots inherit, and keep -j at most the number of
+ * cores divided by twice that:
+ *	TRONBOT_THREADS=1 referee -j 4 ./MyTronBot ./MyTronBot map1.txt map2.txt
+ * on 8 cores.
+ *
+ * The rules are those of the contest:
+ * - Each turn, both bots get the map with themselves as '1' and the
+ *	opponent as '2', and answer with a move (1 to 4 for north, east,
+ *	south and west).  The moves are then made at the same time, and
+ *	the cells the bots left become walls.
+ * - A bot that moves into a wall, or into the same cell as the other
+ *	bot, crashes.  If both bots crash on the same turn, it's a draw;
+ *	otherwise the one that didn't crash wins.
+ * - A bot that doesn't answer within the time limit (-T, 3 seconds, for
+ *	the first move, -t, 1 second, for the rest), or exits, or answers
+ *	with anything but a move, crashes too.
+ *
+ * Prints one line per game, as it ends, and a summary at the end, all
+ * as JSON objects.  The results are from bot1's side; per bot, the
+ * summary has:
+ *	moves, deadline_misses, invalid_moves,
+ *	cpu_ms_per_move: mean and max CPU time (user and system, all threads)
+ *		the bot used between getting a map and answering,
+ *	response_ms: mean and max time to answer.
+ * The bots keep thinking while the other one's move is awaited, so the
+ * CPU time of a move can be more than the time taken to answer it.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static const int kNumBots = 2;
+
+enum TOutcome {
+	WIN,
+	DRAW,
+	LOSS,
+	NUM_OUTCOMES
+};
+
+static const char* const kOutcomeNames[NUM_OUTCOMES] = { "win", "draw", "loss" };
+
+struct RefereeOptions {
+	int numGamesPerMap;
+	int numJobs;
+	double firstMoveTimeLimit;
+	double moveTimeLimit;
+	const char* botCommands[kNumBots];
+};
+
+struct GameMap {
+	std::string name;
+	int width;
+	int height;
+
+	//'#' or ' ', row by row.
+	std::vector<char> cells;
+
+	//Starting positions of '1' and '2'.
+	int iStarts[kNumBots];
+};
+
+/**
+ * How one bot did in one game.
+ */
+struct BotStats {
+	int numMoves;
+	int numDeadlineMisses;
+	int numInvalidMoves;
+	double cpuSeconds;
+	double maxCpuSeconds;
+	double responseSeconds;
+	double maxResponseSeconds;
+};
+
+/**
+ * Sent from a game's process to the referee's.  Must fit in PIPE_BUF
+ * so that the writes from several games don't mix.
+ */
+struct GameResult {
+	int gameIndex;
+	int mapIndex;
+
+	//Whether bot1 started from '2'.
+	bool isSwapped;
+
+	//From bot1's side.
+	TOutcome outcome;
+	int numTurns;
+	BotStats bots[kNumBots];
+};
+
+/**
+ * A bot's process and the pipes to and from it.
+ */
+struct BotProcess {
+	pid_t pid;
+	int toBot;
+	int fromBot;
+
+	//What the bot has sent but hasn't been read as a move yet.
+	std::string pending;
+
+	bool hasAnswered;
+	int move;
+	bool isTimedOut;
+	double cpuAtStart;
+};
+
+static double GetSeconds() {
+	timespec currentTime;
+	clock_gettime(CLOCK_MONOTONIC, &currentTime);
+	return static_cast<double>(currentTime.tv_sec) + currentTime.tv_nsec / 1000000000.0;
+}
+
+/**
+ * CPU time used so far by all the threads of a process, from
+ * /proc/<pid>/stat; 0 if it can't be read.
+ */
+static double GetCpuSeconds(const pid_t pid) {
+	char path[64];
+	sprintf(path, "/proc/%d/stat", static_cast<int>(pid));
+
+	FILE* file = fopen(path, "r");
+
+	if (NULL == file) {
+		return 0;
+	}
+
+	char stat[1024];
+	const size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+	fclose(file);
+	stat[length] = '\0';
+
+	//The command name can have spaces in it; the fields after it are
+	//state, ppid, pgrp, session, tty_nr, tpgid, flags, minflt, cminflt,
+	//majflt, cmajflt, utime, stime.
+	const char* fields = strrchr(stat, ')');
+	unsigned long userTicks = 0;
+	unsigned long systemTicks = 0;
+
+	if (NULL == fields
+		|| sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+				  &userTicks, &systemTicks) < 2) {
+		return 0;
+	}
+
+	return static_cast<double>(userTicks + systemTicks) / sysconf(_SC_CLK_TCK);
+}
+
+static bool LoadMap(const char* mapFile, GameMap* map) {
+	FILE* file = fopen(mapFile, "r");
+
+	if (NULL == file) {
+		fprintf(stderr, "Can't open %s\n", mapFile);
+		return false;
+	}
+
+	map->name = mapFile;
+	map->iStarts[0] = -1;
+	map->iStarts[1] = -1;
+
+	char line[1024];
+	bool isValid = (NULL != fgets(line, sizeof(line), file)
+					&& 2 == sscanf(line, "%d %d", &map->width, &map->height)
+					&& map->width > 0 && map->height > 0 && map->width < static_cast<int>(sizeof(line)) - 2);
+
+	if (isValid) {
+		map->cells.assign(map->width * map->height, '#');
+	}
+
+	for (int y = 0; isValid && y < map->height; ++y) {
+		if (NULL == fgets(line, sizeof(line), file)) {
+			isValid = false;
+			break;
+		}
+
+		for (int x = 0; x < map->width && '\n' != line[x] && '\r' != line[x] && '\0' != line[x]; ++x) {
+			const int iCell = y * map->width + x;
+
+			if ('1' == line[x] || '2' == line[x]) {
+				map->iStarts[line[x] - '1'] = iCell;
+			}
+
+			map->cells[iCell] = ('#' == line[x] ? '#' : ' ');
+		}
+	}
+
+	fclose(file);
+
+	if (!isValid || map->iStarts[0] < 0 || map->iStarts[1] < 0) {
+		fprintf(stderr, "%s is not a valid map\n", mapFile);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * The map as bot number iBot sees it, in the contest engine's format.
+ */
+static std::string GetFrame(const GameMap& map, const std::vector<char>& cells,
+							const int iPositions[kNumBots], const int iBot) {
+	char header[32];
+	sprintf(header, "%d %d\n", map.width, map.height);
+
+	std::string frame(header);
+	frame.reserve(frame.size() + (map.width + 1) * map.height);
+
+	for (int y = 0; y < map.height; ++y) {
+		frame.append(&cells[y * map.width], map.width);
+		frame += '\n';
+	}
+
+	const size_t headerLength = strlen(header);
+	const int iOpponent = 1 - iBot;
+	frame[headerLength + (iPositions[iBot] / map.width) * (map.width + 1) + iPositions[iBot] % map.width] = '1';
+	frame[headerLength + (iPositions[iOpponent] / map.width) * (map.width + 1) + iPositions[iOpponent] % map.width] = '2';
+
+	return frame;
+}
+
+/**
+ * Keep a pipe from leaking into the bots, which would then never see
+ * the end of their input.
+ */
+static void SetCloseOnExec(const int fds[2]) {
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+}
+
+static bool StartBot(const char* command, BotProcess* bot) {
+	int toBot[2];
+	int fromBot[2];
+
+	if (0 != pipe(toBot)) {
+		return false;
+	}
+
+	if (0 != pipe(fromBot)) {
+		close(toBot[0]);
+		close(toBot[1]);
+		return false;
+	}
+
+	SetCloseOnExec(toBot);
+	SetCloseOnExec(fromBot);
+	bot->pid = fork();
+
+	if (0 == bot->pid) {
+		dup2(toBot[0], STDIN_FILENO);
+		dup2(fromBot[1], STDOUT_FILENO);
+
+		const std::string shellCommand = std::string("exec ") + command;
+		execl("/bin/sh", "sh", "-c", shellCommand.c_str(), static_cast<char*>(NULL));
+		_exit(127);
+	}
+
+	close(toBot[0]);
+	close(fromBot[1]);
+	bot->toBot = toBot[1];
+	bot->fromBot = fromBot[0];
+	bot->pending.clear();
+
+	if (bot->pid < 0) {
+		close(bot->toBot);
+		close(bot->fromBot);
+		return false;
+	}
+
+	return true;
+}
+
+static void StopBot(BotProcess* bot) {
+	//The bots exit at the end of their input, but may be busy thinking.
+	close(bot->toBot);
+	close(bot->fromBot);
+	kill(bot->pid, SIGKILL);
+	waitpid(bot->pid, NULL, 0);
+}
+
+static bool WriteAll(const int fd, const std::string& data) {
+	size_t written = 0;
+
+	while (written < data.size()) {
+		const ssize_t result = write(fd, data.data() + written, data.size() - written);
+
+		if (result < 0 && EINTR == errno) {
+			continue;
+		}
+
+		if (result <= 0) {
+			return false;
+		}
+
+		written += result;
+	}
+
+	return true;
+}
+
+/**
+ * Take a whole line the bot has sent, if there is one, as its move;
+ * anything but a number from 1 to 4 is move 0.
+ */
+static bool TakeMove(BotProcess* bot) {
+	const size_t lineEnd = bot->pending.find('\n');
+
+	if (std::string::npos == lineEnd) {
+		return false;
+	}
+
+	const int move = atoi(bot->pending.substr(0, lineEnd).c_str());
+	bot->pending.erase(0, lineEnd + 1);
+	bot->move = (move >= 1 && move <= 4 ? move : 0);
+	bot->hasAnswered = true;
+	return true;
+}
+
+/**
+ * Send each bot its map, then wait for both moves until the time limit.
+ */
+static void GetMoves(const std::vector<std::string>& frames, const double timeLimit, BotProcess bots[kNumBots],
+					 BotStats stats[kNumBots]) {
+	const double startTime = GetSeconds();
+	const double deadline = startTime + timeLimit;
+
+	for (int iBot = 0; iBot < kNumBots; ++iBot) {
+		bots[iBot].hasAnswered = false;
+		bots[iBot].move = 0;
+		bots[iBot].isTimedOut = false;
+		bots[iBot].cpuAtStart = GetCpuSeconds(bots[iBot].pid);
+
+		//A bot that has died can't answer; it's taken as timed out.
+		if (!WriteAll(bots[iBot].toBot, frames[iBot])) {
+			bots[iBot].hasAnswered = true;
+			bots[iBot].isTimedOut = true;
+		}
+	}
+
+	for (;;) {
+		pollfd fds[kNumBots];
+		int botIndices[kNumBots];
+		int numWaiting = 0;
+
+		for (int iBot = 0; iBot < kNumBots; ++iBot) {
+			//A move may have come with an earlier one.
+			if (!bots[iBot].hasAnswered && !TakeMove(&bots[iBot])) {
+				fds[numWaiting].fd = bots[iBot].fromBot;
+				fds[numWaiting].events = POLLIN;
+				fds[numWaiting].revents = 0;
+				botIndices[numWaiting] = iBot;
+				numWaiting++;
+			}
+
+			if (bots[iBot].hasAnswered && bots[iBot].cpuAtStart >= 0) {
+				const double cpuSeconds = GetCpuSeconds(bots[iBot].pid) - bots[iBot].cpuAtStart;
+				const double responseSeconds = GetSeconds() - startTime;
+				bots[iBot].cpuAtStart = -1;
+
+				stats[iBot].numMoves++;
+				stats[iBot].cpuSeconds += cpuSeconds;
+				stats[iBot].responseSeconds += responseSeconds;
+
+				if (cpuSeconds > stats[iBot].maxCpuSeconds) {
+					stats[iBot].maxCpuSeconds = cpuSeconds;
+				}
+
+				if (responseSeconds > stats[iBot].maxResponseSeconds) {
+					stats[iBot].maxResponseSeconds = responseSeconds;
+				}
+			}
+		}
+
+		if (0 == numWaiting) {
+			return;
+		}
+
+		const int timeLeft = static_cast<int>((deadline - GetSeconds()) * 1000);
+
+		if (timeLeft <= 0) {
+			for (int i = 0; i < numWaiting; ++i) {
+				bots[botIndices[i]].isTimedOut = true;
+				bots[botIndices[i]].hasAnswered = true;
+			}
+
+			continue;
+		}
+
+		if (poll(fds, numWaiting, timeLeft) < 0 && EINTR != errno) {
+			return;
+		}
+
+		for (int i = 0; i < numWaiting; ++i) {
+			if (0 == fds[i].revents) {
+				continue;
+			}
+
+			BotProcess& bot = bots[botIndices[i]];
+			char buffer[256];
+			const ssize_t length = read(bot.fromBot, buffer, sizeof(buffer));
+
+			if (length > 0) {
+				bot.pending.append(buffer, length);
+
+			} else if (0 == length || EINTR != errno) {
+				//The bot has closed its output.
+				bot.isTimedOut = true;
+				bot.hasAnswered = true;
+			}
+		}
+	}
+}
+
+static void PlayGame(const RefereeOptions& options, const GameMap& map, GameResult* result) {
+	static const int kDx[5] = { 0, 0, 1, 0, -1 };
+	static const int kDy[5] = { 0, -1, 0, 1, 0 };
+
+	memset(result->bots, 0, sizeof(result->bots));
+
+	//Bot number iBot is the one that runs options.botCommands[iBot],
+	//and starts from '1' unless the game is swapped.
+	BotProcess bots[kNumBots];
+	int iPositions[kNumBots];
+	int numStarted = 0;
+
+	for (int iBot = 0; iBot < kNumBots; ++iBot) {
+		iPositions[iBot] = map.iStarts[result->isSwapped ? 1 - iBot : iBot];
+
+		if (StartBot(options.botCommands[iBot], &bots[iBot])) {
+			numStarted++;
+		} else {
+			fprintf(stderr, "Can't start %s\n", options.botCommands[iBot]);
+		}
+	}
+
+	if (numStarted < kNumBots) {
+		_exit(1);
+	}
+
+	std::vector<char> cells(map.cells);
+	std::vector<std::string> frames(kNumBots);
+	result->numTurns = 0;
+
+	for (;;) {
+		for (int iBot = 0; iBot < kNumBots; ++iBot) {
+			frames[iBot] = GetFrame(map, cells, iPositions, iBot);
+		}
+
+		const double timeLimit = (0 == result->numTurns ? options.firstMoveTimeLimit : options.moveTimeLimit);
+		GetMoves(frames, timeLimit, bots, result->bots);
+		result->numTurns++;
+
+		bool hasCrashed[kNumBots];
+
+		for (int iBot = 0; iBot < kNumBots; ++iBot) {
+			cells[iPositions[iBot]] = '#';
+		}
+
+		for (int iBot = 0; iBot < kNumBots; ++iBot) {
+			const int move = bots[iBot].move;
+			hasCrashed[iBot] = bots[iBot].isTimedOut || 0 == move;
+
+			if (bots[iBot].isTimedOut) {
+				result->bots[iBot].numDeadlineMisses++;
+
+			} else if (0 == move) {
+				result->bots[iBot].numInvalidMoves++;
+
+			} else {
+				const int x = iPositions[iBot] % map.width + kDx[move];
+				const int y = iPositions[iBot] / map.width + kDy[move];
+
+				if (x < 0 || y < 0 || x >= map.width || y >= map.height) {
+					hasCrashed[iBot] = true;
+				} else {
+					iPositions[iBot] = y * map.width + x;
+					hasCrashed[iBot] = ('#' == cells[iPositions[iBot]]);
+				}
+			}
+		}
+
+		if (iPositions[0] == iPositions[1]) {
+			hasCrashed[0] = true;
+			hasCrashed[1] = true;
+		}
+
+		if (hasCrashed[0] || hasCrashed[1]) {
+			result->outcome = (hasCrashed[0] ? (hasCrashed[1] ? DRAW : LOSS) : WIN);
+			break;
+		}
+	}
+
+	for (int iBot = 0; iBot < kNumBots; ++iBot) {
+		StopBot(&bots[iBot]);
+	}
+}
+
+static void PrintBotStats(const BotStats& stats) {
+	const int numMoves = (stats.numMoves > 0 ? stats.numMoves : 1);
+
+	printf("{\"moves\": %d, \"deadline_misses\": %d, \"invalid_moves\": %d, "
+		"\"cpu_ms_per_move\": {\"mean\": %.1f, \"max\": %.1f}, \"response_ms\": {\"mean\": %.1f, \"max\": %.1f}}",
+		stats.numMoves, stats.numDeadlineMisses, stats.numInvalidMoves,
+		stats.cpuSeconds * 1000 / numMoves, stats.maxCpuSeconds * 1000,
+		stats.responseSeconds * 1000 / numMoves, stats.maxResponseSeconds * 1000);
+}
+
+static void AddBotStats(const BotStats& stats, BotStats* total) {
+	total->numMoves += stats.numMoves;
+	total->numDeadlineMisses += stats.numDeadlineMisses;
+	total->numInvalidMoves += stats.numInvalidMoves;
+	total->cpuSeconds += stats.cpuSeconds;
+	total->responseSeconds += stats.responseSeconds;
+
+	if (stats.maxCpuSeconds > total->maxCpuSeconds) {
+		total->maxCpuSeconds = stats.maxCpuSeconds;
+	}
+
+	if (stats.maxResponseSeconds > total->maxResponseSeconds) {
+		total->maxResponseSeconds = stats.maxResponseSeconds;
+	}
+}
+
+/**
+ * Play every game, up to options.numJobs at a time; each game runs in
+ * a process of its own and writes its GameResult to a shared pipe.
+ * @return the number of games that failed to finish.
+ */
+static int PlayGames(const RefereeOptions& options, const std::vector<GameMap>& maps) {
+	int results[2];
+
+	if (0 != pipe(results)) {
+		perror("pipe");
+		return -1;
+	}
+
+	SetCloseOnExec(results);
+
+	const int numGames = static_cast<int>(maps.size()) * options.numGamesPerMap;
+	int numOutcomes[NUM_OUTCOMES] = { 0, 0, 0 };
+	BotStats totals[kNumBots];
+	memset(totals, 0, sizeof(totals));
+
+	int numStarted = 0;
+	int numRunning = 0;
+	int numFailures = 0;
+	const double startTime = GetSeconds();
+
+	while (numStarted < numGames || numRunning > 0) {
+		if (numStarted < numGames && numRunning < options.numJobs) {
+			GameResult result;
+			memset(&result, 0, sizeof(result));
+			result.gameIndex = numStarted;
+			result.mapIndex = numStarted / options.numGamesPerMap;
+			result.isSwapped = (1 == numStarted % options.numGamesPerMap % 2);
+
+			const pid_t pid = fork();
+
+			if (0 == pid) {
+				close(results[0]);
+				PlayGame(options, maps[result.mapIndex], &result);
+
+				const ssize_t written = write(results[1], &result, sizeof(result));
+				_exit(sizeof(result) == written ? 0 : 1);
+			}
+
+			if (pid < 0) {
+				perror("fork");
+				numFailures += numGames - numStarted;
+				numStarted = numGames;
+				continue;
+			}
+
+			numStarted++;
+			numRunning++;
+			continue;
+		}
+
+		//A game has written its result before exiting, so there's a
+		//result to read for each game that exited normally, though
+		//not necessarily the one from that game.
+		int status = 0;
+
+		if (waitpid(-1, &status, 0) < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+
+			break;
+		}
+
+		numRunning--;
+
+		if (!WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
+			numFailures++;
+			continue;
+		}
+
+		GameResult result;
+
+		if (sizeof(result) != read(results[0], &result, sizeof(result))) {
+			numFailures++;
+			continue;
+		}
+
+		numOutcomes[result.outcome]++;
+
+		for (int iBot = 0; iBot < kNumBots; ++iBot) {
+			AddBotStats(result.bots[iBot], &totals[iBot]);
+		}
+
+		printf("{\"game\": %d, \"map\": \"%s\", \"bot1_starts_as\": %d, \"result\": \"%s\", \"turns\": %d, ",
+			result.gameIndex, maps[result.mapIndex].name.c_str(), (result.isSwapped ? 2 : 1),
+			kOutcomeNames[result.outcome], result.numTurns);
+		printf("\"bot1\": ");
+		PrintBotStats(result.bots[0]);
+		printf(", \"bot2\": ");
+		PrintBotStats(result.bots[1]);
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	printf("{\"summary\": {\"games\": %d, \"failed\": %d, \"seconds\": %.1f, \"wins\": %d, \"draws\": %d, \"losses\": %d, ",
+		numGames, numFailures, GetSeconds() - startTime, numOutcomes[WIN], numOutcomes[DRAW], numOutcomes[LOSS]);
+	printf("\"bot1\": ");
+	PrintBotStats(totals[0]);
+	printf(", \"bot2\": ");
+	PrintBotStats(totals[1]);
+	printf("}}\n");
+	fflush(stdout);
+
+	close(results[0]);
+	close(results[1]);
+	return numFailures;
+}
+
+int main(int argc, char** argv) {
+	RefereeOptions options;
+	options.numGamesPerMap = 2;
+	options.numJobs = 1;
+	options.firstMoveTimeLimit = 3.0;
+	options.moveTimeLimit = 1.0;
+
+	std::vector<const char*> arguments;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasValue = (i + 1 < argc);
+
+		if (0 == strcmp(argv[i], "-g") && hasValue) {
+			options.numGamesPerMap = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-j") && hasValue) {
+			options.numJobs = atoi(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-T") && hasValue) {
+			options.firstMoveTimeLimit = atof(argv[++i]);
+
+		} else if (0 == strcmp(argv[i], "-t") && hasValue) {
+			options.moveTimeLimit = atof(argv[++i]);
+
+		} else {
+			arguments.push_back(argv[i]);
+		}
+	}
+
+	if (arguments.size() < 3 || options.numGamesPerMap < 1 || options.numJobs < 1) {
+		fprintf(stderr, "Usage: referee [-g games] [-j jobs] [-T seconds] [-t seconds] bot1 bot2 map...\n");
+		return 1;
+	}
+
+	options.botCommands[0] = arguments[0];
+	options.botCommands[1] = arguments[1];
+
+	std::vector<GameMap> maps;
+
+	for (size_t i = 2; i < arguments.size(); ++i) {
+		GameMap map;
+
+		if (!LoadMap(arguments[i], &map)) {
+			return 1;
+		}
+
+		maps.push_back(map);
+	}
+
+	//A bot that has died mustn't take the referee with it.
+	signal(SIGPIPE, SIG_IGN);
+
+	return (0 == PlayGames(options, maps) ? 0 : 1);
+}